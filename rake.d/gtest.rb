@@ -25,7 +25,16 @@ $build_system_modules[:gtest] = {
     gtest_libs = {
       'common'   => [],
       'propedit' => [ :mtxpropedit ],
-      'merge'    => [ :mtxmerge ],
+      'merge'    => [ :mtxmerge, :mtxinput, :mtxoutput, :mtxmerge ],
+    }
+
+    # The merge tests mux with the mux benchmark's synthetic reader.
+    gtest_sources = {
+      'merge'    => [ 'tests/benchmark/mux/synthetic_reader.cpp' ],
+    }
+
+    gtest_other_libs = {
+      'merge'    => [ :avi, :rmff, :mpegparser, :flac, :vorbis, :ogg ],
     }
 
     #
@@ -49,7 +58,8 @@ $build_system_modules[:gtest] = {
         description("Build the unit tests executable for '#{app}'").
         aliases("unit_tests_#{app}").
         sources([ "tests/unit/#{app}" ], :type => :dir).
-        libraries(gtest_libs[app], :mtxunittest, $common_libs, :gtest, :pthread).
+        sources(gtest_sources[app] || []).
+        libraries(gtest_libs[app], :mtxunittest, $common_libs, gtest_other_libs[app] || [], :gtest, :pthread, $custom_libs).
         create
     end
   end,
@@ -17,14 +17,19 @@
 
 #include "common/common_pch.h"
 
+#include "common/bswap.h"
 #include "common/mm_io_x.h"
 
+// Reads bits from a buffer through a 64-bit cache. The cache holds
+// the next unread bits left-aligned (the next bit is the most
+// significant one) and is refilled with up to eight bytes at once.
 class bit_reader_c {
 private:
   const unsigned char *m_end_of_data;
-  const unsigned char *m_byte_position;
+  const unsigned char *m_byte_position; // the next byte to load into the cache
   const unsigned char *m_start_of_data;
-  std::size_t m_bits_valid;
+  uint64_t m_cache;
+  std::size_t m_cache_bits;             // the number of valid bits in m_cache
   bool m_out_of_data;
 
 public:
@@ -36,7 +41,8 @@ public:
     m_end_of_data   = data + len;
     m_byte_position = data;
     m_start_of_data = data;
-    m_bits_valid    = len ? 8 : 0;
+    m_cache         = 0;
+    m_cache_bits    = 0;
     m_out_of_data   = m_byte_position >= m_end_of_data;
   }
 
@@ -45,39 +51,41 @@ public:
   }
 
   uint64_t get_bits(std::size_t n) {
-    uint64_t r = 0;
-
-    while (n > 0) {
-      if (m_byte_position >= m_end_of_data) {
-        m_out_of_data = true;
-        throw mtx::mm_io::end_of_file_x();
-      }
+    // Values wider than the cache is guaranteed to hold after a
+    // refill are read in two parts.
+    if (n > 56) {
+      auto high = get_bits(n - 32);
+      return (high << 32) | get_bits(32);
+    }
 
-      std::size_t b = 8; // number of bits to extract from the current byte
-      if (b > n)
-        b = n;
-      if (b > m_bits_valid)
-        b = m_bits_valid;
+    if (!n)
+      return 0;
 
-      std::size_t rshift = m_bits_valid - b;
+    if (m_cache_bits < n) {
+      refill();
+      if (m_cache_bits < n)
+        throw_out_of_data();
+    }
 
-      r <<= b;
-      r  |= ((*m_byte_position) >> rshift) & (0xff >> (8 - b));
+    auto value     = m_cache >> (64 - n);
+    m_cache      <<= n;
+    m_cache_bits  -= n;
 
-      m_bits_valid -= b;
-      if (0 == m_bits_valid) {
-        m_bits_valid     = 8;
-        m_byte_position += 1;
-      }
+    return value;
+  }
 
-      n -= b;
+  inline int get_bit() {
+    if (!m_cache_bits) {
+      refill();
+      if (!m_cache_bits)
+        throw_out_of_data();
     }
 
-    return r;
-  }
+    auto value     = static_cast<int>(m_cache >> 63);
+    m_cache      <<= 1;
+    m_cache_bits  -= 1;
 
-  inline int get_bit() {
-    return get_bits(1);
+    return value;
   }
 
   inline int get_unary(bool stop,
@@ -97,6 +105,23 @@ public:
   }
 
   inline int get_unsigned_golomb() {
+    if (m_cache_bits < 56)
+      refill();
+
+    // The common case: the leading zeros, the 1 and the value bits are
+    // all in the cache. The number of leading zeros is counted in one
+    // go instead of bit by bit.
+    auto num_zeros = count_leading_zeros(m_cache);
+    auto code_bits = 2 * num_zeros + 1;
+
+    if (code_bits <= m_cache_bits) {
+      auto value     = (m_cache >> (64 - code_bits)) - 1;
+      m_cache      <<= code_bits;
+      m_cache_bits  -= code_bits;
+
+      return value;
+    }
+
     int n = 0, bit;
 
     while ((bit = get_bit()) == 0)
@@ -113,39 +138,34 @@ public:
   }
 
   uint64_t peek_bits(std::size_t n) {
-    uint64_t r                             = 0;
-    const unsigned char *tmp_byte_position = m_byte_position;
-    std::size_t tmp_bits_valid                  = m_bits_valid;
-
-    while (0 < n) {
-      if (tmp_byte_position >= m_end_of_data)
-        throw mtx::mm_io::end_of_file_x();
-
-      std::size_t b = 8; // number of bits to extract from the current byte
-      if (b > n)
-        b = n;
-      if (b > tmp_bits_valid)
-        b = tmp_bits_valid;
+    if (!n)
+      return 0;
 
-      std::size_t rshift = tmp_bits_valid - b;
+    if (n > 56) {
+      auto saved = *this;
 
-      r <<= b;
-      r  |= ((*tmp_byte_position) >> rshift) & (0xff >> (8 - b));
+      try {
+        auto value = get_bits(n);
+        *this      = saved;
+        return value;
 
-      tmp_bits_valid -= b;
-      if (0 == tmp_bits_valid) {
-        tmp_bits_valid     = 8;
-        tmp_byte_position += 1;
+      } catch (...) {
+        *this = saved;
+        throw;
       }
+    }
 
-      n -= b;
+    if (m_cache_bits < n) {
+      refill();
+      if (m_cache_bits < n)
+        throw mtx::mm_io::end_of_file_x();
     }
 
-    return r;
+    return m_cache >> (64 - n);
   }
 
   void get_bytes(unsigned char *buf, std::size_t n) {
-    if (8 == m_bits_valid) {
+    if (!(m_cache_bits % 8)) {
       get_bytes_byte_aligned(buf, n);
       return;
     }
@@ -155,36 +175,51 @@ public:
   }
 
   void byte_align() {
-    if (8 != m_bits_valid)
-      skip_bits(m_bits_valid);
+    if (m_cache_bits % 8)
+      skip_bits(m_cache_bits % 8);
   }
 
   void set_bit_position(std::size_t pos) {
     if (pos > (static_cast<std::size_t>(m_end_of_data - m_start_of_data) * 8)) {
       m_byte_position = m_end_of_data;
+      m_cache         = 0;
+      m_cache_bits    = 0;
       m_out_of_data   = true;
 
       throw mtx::mm_io::end_of_file_x();
     }
 
     m_byte_position = m_start_of_data + (pos / 8);
-    m_bits_valid    = 8 - (pos % 8);
+    m_cache         = 0;
+    m_cache_bits    = 0;
+
+    if (pos % 8) {
+      refill();
+      m_cache      <<= pos % 8;
+      m_cache_bits  -= pos % 8;
+    }
   }
 
   int get_bit_position() const {
-    return (m_byte_position - m_start_of_data) * 8 + 8 - m_bits_valid;
+    return (m_byte_position - m_start_of_data) * 8 - m_cache_bits;
   }
 
   int get_remaining_bits() const {
-    return (m_end_of_data - m_byte_position) * 8 - 8 + m_bits_valid;
+    return (m_end_of_data - m_byte_position) * 8 + m_cache_bits;
   }
 
   void skip_bits(std::size_t num) {
+    if (num < m_cache_bits) {
+      m_cache      <<= num;
+      m_cache_bits  -= num;
+      return;
+    }
+
     set_bit_position(get_bit_position() + num);
   }
 
   void skip_bit() {
-    set_bit_position(get_bit_position() + 1);
+    skip_bits(1);
   }
 
   uint64_t skip_get_bits(std::size_t to_skip,
@@ -194,13 +229,68 @@ public:
   }
 
 protected:
+  // Tops the cache up to at least 56 valid bits if the data suffices.
+  // With eight or more bytes left a whole big-endian word is loaded
+  // and as many of its bytes are kept as fit; the bits below the valid
+  // ones are the following bits of the data then and are simply
+  // loaded again by the next refill.
+  void refill() {
+    if ((m_end_of_data - m_byte_position) >= 8) {
+      uint64_t word;
+      std::memcpy(&word, m_byte_position, 8);
+#if defined(ARCH_LITTLEENDIAN)
+      word = mtx::bswap_64(word);
+#endif
+
+      m_cache         |= word >> m_cache_bits;
+      m_byte_position += (63 - m_cache_bits) / 8;
+      m_cache_bits    |= 56;
+
+      return;
+    }
+
+    while ((m_cache_bits <= 56) && (m_byte_position < m_end_of_data)) {
+      m_cache         |= static_cast<uint64_t>(*m_byte_position) << (56 - m_cache_bits);
+      m_cache_bits    += 8;
+      m_byte_position += 1;
+    }
+  }
+
+  static unsigned int count_leading_zeros(uint64_t value) {
+    if (!value)
+      return 64;
+
+#if defined(__GNUC__)
+    return __builtin_clzll(value);
+#else
+    auto count = 0u;
+    for (; !(value & (1ull << 63)); value <<= 1)
+      ++count;
+    return count;
+#endif
+  }
+
+  void throw_out_of_data() {
+    m_byte_position = m_end_of_data;
+    m_cache         = 0;
+    m_cache_bits    = 0;
+    m_out_of_data   = true;
+
+    throw mtx::mm_io::end_of_file_x();
+  }
+
   void get_bytes_byte_aligned(unsigned char *buf, std::size_t n) {
-    auto bytes_to_copy = std::min<std::size_t>(n, m_end_of_data - m_byte_position);
-    std::memcpy(buf, m_byte_position, bytes_to_copy);
+    // Bytes still in the cache are handed out first.
+    auto idx = 0u;
+    for (; (idx < n) && m_cache_bits; ++idx)
+      buf[idx] = get_bits(8);
+
+    auto bytes_to_copy = std::min<std::size_t>(n - idx, m_end_of_data - m_byte_position);
+    std::memcpy(buf + idx, m_byte_position, bytes_to_copy);
 
     m_byte_position += bytes_to_copy;
 
-    if (bytes_to_copy < n) {
+    if ((idx + bytes_to_copy) < n) {
       m_out_of_data = true;
       throw mtx::mm_io::end_of_file_x();
     }
@@ -44,6 +44,21 @@ adler32_c::get_result_as_uint()
   return (m_b << 16) | m_a;
 }
 
+// Taken from zlib's adler32_combine_(): the second piece's sums are
+// each shifted by the first piece's contributions.
+void
+adler32_c::combine(base_c const &other,
+                   uint64_t other_size) {
+  auto &other_adler = dynamic_cast<adler32_c const &>(other);
+  auto remainder    = static_cast<uint32_t>(other_size % msc_mod_adler);
+  auto a            = m_a + other_adler.m_a + msc_mod_adler - 1;
+  auto b            = static_cast<uint32_t>((static_cast<uint64_t>(remainder) * m_a) % msc_mod_adler);
+  b                += m_b + other_adler.m_b + msc_mod_adler - remainder;
+
+  m_a = a % msc_mod_adler;
+  m_b = b % msc_mod_adler;
+}
+
 void
 adler32_c::add_impl(unsigned char const *buffer,
                     size_t size) {
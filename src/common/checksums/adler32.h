@@ -20,7 +20,7 @@
 
 namespace mtx { namespace checksum {
 
-class adler32_c: public base_c, public uint_result_c {
+class adler32_c: public base_c, public uint_result_c, public combinable_c {
 protected:
   static uint32_t const msc_mod_adler = 65521;
   uint32_t m_a, m_b;
@@ -31,6 +31,7 @@ public:
 
   virtual memory_cptr get_result() const;
   virtual uint64_t get_result_as_uint() const;
+  virtual void combine(base_c const &other, uint64_t other_size);
 
 protected:
   virtual void add_impl(unsigned char const *buffer, size_t size);
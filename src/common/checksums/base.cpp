@@ -121,6 +121,11 @@ uint_result_c::~uint_result_c() {
 
 // ----------------------------------------------------------------------
 
+combinable_c::~combinable_c() {
+}
+
+// ----------------------------------------------------------------------
+
 set_initial_value_c::~set_initial_value_c() {
 }
 
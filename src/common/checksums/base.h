@@ -53,6 +53,20 @@ public:
   virtual uint64_t get_result_as_uint() const = 0;
 };
 
+// Implemented by algorithms whose state after two consecutive pieces
+// of data can be derived from the states after each of them, allowing
+// the pieces to be checksummed independently, e.g. on several threads.
+class combinable_c {
+public:
+  virtual ~combinable_c();
+
+  // Continues the checksum as if the data 'other' has been calculated
+  // over had been added. 'other' must be of the same type, have been
+  // created with the default initial value and have seen exactly
+  // 'other_size' bytes.
+  virtual void combine(base_c const &other, uint64_t other_size) = 0;
+};
+
 }} // namespace mtx { namespace checksum {
 
 #endif // MTX_COMMON_CHECKSUMS_BASE_H
@@ -33,6 +33,7 @@ using base_uptr = std::unique_ptr<base_c>;
 
 class set_initial_value_c;
 class uint_result_c;
+class combinable_c;
 
 base_uptr for_algorithm(algorithm_e algorithm, uint64_t initial_value = 0);
 memory_cptr calculate(algorithm_e algorithm, memory_c const &buffer, uint64_t initial_value = 0);
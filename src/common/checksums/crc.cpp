@@ -16,12 +16,105 @@
 
 #include "common/common_pch.h"
 
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define MTX_HAVE_PCLMUL_DISPATCH
+#endif
+
 #include "common/bswap.h"
 #include "common/checksums/crc.h"
 #include "common/endian.h"
 
 namespace mtx { namespace checksum {
 
+#if defined(MTX_HAVE_PCLMUL_DISPATCH)
+namespace {
+
+inline __m128i
+load(unsigned char const *buffer) {
+  return _mm_loadu_si128(reinterpret_cast<__m128i const *>(buffer));
+}
+
+// Multiplies both halves of 'value' by their constant and adds the
+// next block, moving 'value' forward by the distance the constants
+// are made for.
+__attribute__((target("pclmul")))
+inline __m128i
+fold(__m128i value,
+     __m128i next,
+     __m128i constants) {
+  auto low  = _mm_clmulepi64_si128(value, constants, 0x00);
+  auto high = _mm_clmulepi64_si128(value, constants, 0x11);
+  return _mm_xor_si128(_mm_xor_si128(high, low), next);
+}
+
+// Folds 'size' bytes (at least 64, a multiple of 16) into the
+// bit-reflected CRC-32 register 'crc' with carry-less multiplication
+// as described in Intel's paper "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction". The constants are powers
+// of x modulo the reflected polynomial 0xEDB88320 and the Barrett
+// reduction constants for it.
+__attribute__((target("pclmul")))
+uint32_t
+crc32_le_pclmul(unsigned char const *buffer,
+                size_t size,
+                uint32_t crc) {
+  auto const k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+  auto const k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+  auto const k5   = _mm_set_epi64x(0,            0x0163cd6124);
+  auto const poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+  auto const mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  // Four 128-bit accumulators are folded in parallel, 64 bytes at a
+  // time.
+  auto x1 = _mm_xor_si128(load(buffer), _mm_cvtsi32_si128(crc));
+  auto x2 = load(buffer + 0x10);
+  auto x3 = load(buffer + 0x20);
+  auto x4 = load(buffer + 0x30);
+
+  buffer += 64;
+  size   -= 64;
+
+  while (size >= 64) {
+    x1 = fold(x1, load(buffer + 0x00), k1k2);
+    x2 = fold(x2, load(buffer + 0x10), k1k2);
+    x3 = fold(x3, load(buffer + 0x20), k1k2);
+    x4 = fold(x4, load(buffer + 0x30), k1k2);
+
+    buffer += 64;
+    size   -= 64;
+  }
+
+  // Fold the accumulators into one, then the remaining 16 byte blocks.
+  x1 = fold(x1, x2, k3k4);
+  x1 = fold(x1, x3, k3k4);
+  x1 = fold(x1, x4, k3k4);
+
+  while (size >= 16) {
+    x1 = fold(x1, load(buffer), k3k4);
+
+    buffer += 16;
+    size   -= 16;
+  }
+
+  // Reduce 128 to 64 bits, then to 32 bits via Barrett reduction.
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k5, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+}
+#endif
+
 crc_base_c::table_parameters_t const crc_base_c::ms_table_parameters[5] = {
   { 0,  8,       0x07 },
   { 0, 16,     0x8005 },
@@ -57,7 +150,7 @@ crc_base_c::init_table() {
   if ((parameters.bits < 8) || (parameters.bits > 32) || (parameters.poly >= (1LL<<parameters.bits)))
     throw std::domain_error{"Invalid CRC parameters"};
 
-  m_table.resize(256);
+  m_table.resize(256 * 8);
 
   for (auto i = 0u; i < 256u; i++) {
     if (parameters.le) {
@@ -74,6 +167,16 @@ crc_base_c::init_table() {
     }
   }
 
+  // Slicing-by-8: entry i of slice k is the register after feeding the
+  // byte i followed by k zero bytes. This works the same way for all
+  // variants as they all update the register with the same reflected
+  // formula.
+  for (auto k = 1u; k < 8u; ++k)
+    for (auto i = 0u; i < 256u; ++i) {
+      auto previous        = m_table[(k - 1) * 256 + i];
+      m_table[k * 256 + i] = (previous >> 8) ^ m_table[previous & 0xff];
+    }
+
   // for (auto row = 0u; row < (256u / 4); ++row)
   //   mxinfo(boost::format("0x%|1$08x| 0x%|2$08x| 0x%|3$08x| 0x%|4$08x|\n")
   //          % m_table[row * 4 + 0] % m_table[row * 4 + 1] % m_table[row * 4 + 2] % m_table[row * 4 + 3]);
@@ -124,13 +227,104 @@ crc_base_c::set_result_in_le(bool result_in_le) {
   m_result_in_le = result_in_le;
 }
 
+// Feeding zero bytes into the register is a linear operation on its
+// 32 bits. It is represented as a matrix over GF(2) whose columns are
+// the results for the individual bits and raised to the required power
+// by repeated squaring, the same way zlib's crc32_combine() does it.
+uint32_t
+crc_base_c::shift_by_zero_bytes(uint32_t crc,
+                                uint64_t num_bytes)
+  const {
+  using matrix_t = std::array<uint32_t, 32>;
+
+  auto multiply = [](matrix_t const &matrix, uint32_t vector) -> uint32_t {
+    auto result = 0u;
+    for (auto bit = 0u; vector; ++bit, vector >>= 1)
+      if (vector & 1)
+        result ^= matrix[bit];
+    return result;
+  };
+
+  matrix_t power, square;
+
+  for (auto bit = 0u; bit < 32; ++bit) {
+    auto reg   = 1u << bit;
+    power[bit] = m_table[reg & 0xff] ^ (reg >> 8);
+  }
+
+  while (num_bytes) {
+    if (num_bytes & 1)
+      crc = multiply(power, crc);
+
+    num_bytes >>= 1;
+    if (!num_bytes)
+      break;
+
+    for (auto bit = 0u; bit < 32; ++bit)
+      square[bit] = multiply(power, power[bit]);
+    power = square;
+  }
+
+  return crc;
+}
+
+void
+crc_base_c::combine(base_c const &other,
+                    uint64_t other_size) {
+  // The register is linear in both its previous value and the data.
+  // Therefore the result equals the first register moved along by as
+  // many zero bytes as the second piece is long, XORed with the second
+  // register started at 0.
+  auto &other_crc = dynamic_cast<crc_base_c const &>(other);
+  m_crc           = shift_by_zero_bytes(m_crc, other_size) ^ other_crc.m_crc;
+}
+
 void
 crc_base_c::add_impl(unsigned char const *buffer,
                      size_t size) {
+#if defined(MTX_HAVE_PCLMUL_DISPATCH)
+  static auto const s_have_pclmul = !!__builtin_cpu_supports("pclmul");
+
+  if ((crc_32_ieee_le == m_type) && (size >= 64) && s_have_pclmul) {
+    auto num_bytes = size & ~static_cast<size_t>(15);
+    m_crc          = crc32_le_pclmul(buffer, num_bytes, m_crc);
+    buffer        += num_bytes;
+    size          -= num_bytes;
+  }
+#endif
+
+  auto table = m_table.data();
+
+  // Eight bytes per step, the first four of which are combined with
+  // the register.
+  while (size >= 8) {
+    uint32_t one, two;
+    std::memcpy(&one, buffer,     4);
+    std::memcpy(&two, buffer + 4, 4);
+
+#if defined(ARCH_BIGENDIAN)
+    one = mtx::bswap_32(one);
+    two = mtx::bswap_32(two);
+#endif
+
+    one   ^= m_crc;
+    m_crc  = table[7 * 256 + ( one        & 0xff)]
+           ^ table[6 * 256 + ((one >>  8) & 0xff)]
+           ^ table[5 * 256 + ((one >> 16) & 0xff)]
+           ^ table[4 * 256 + ( one >> 24        )]
+           ^ table[3 * 256 + ( two        & 0xff)]
+           ^ table[2 * 256 + ((two >>  8) & 0xff)]
+           ^ table[1 * 256 + ((two >> 16) & 0xff)]
+           ^ table[          ( two >> 24        )];
+
+    buffer += 8;
+    size   -= 8;
+  }
+
   auto end = buffer + size;
 
   while (buffer < end) {
-    m_crc = m_table[(m_crc & 0xff) ^ *buffer] ^ (m_crc >> 8);
+    m_crc = table[(m_crc & 0xff) ^ *buffer] ^ (m_crc >> 8);
     ++buffer;
   }
 }
@@ -20,7 +20,7 @@
 
 namespace mtx { namespace checksum {
 
-class crc_base_c: public base_c, public uint_result_c, public set_initial_value_c {
+class crc_base_c: public base_c, public uint_result_c, public set_initial_value_c, public combinable_c {
 protected:
   enum type_e {
     crc_8_atm      = 0,
@@ -61,11 +61,15 @@ public:
   virtual void set_xor_result(uint64_t xor_result);
   virtual void set_result_in_le(bool result_in_le);
 
+  virtual void combine(base_c const &other, uint64_t other_size);
+
 protected:
   virtual void add_impl(unsigned char const *buffer, size_t size);
 
   virtual void set_initial_value_impl(uint64_t initial_value) ;
   virtual void set_initial_value_impl(unsigned char const *buffer, size_t size);
+
+  uint32_t shift_by_zero_bytes(uint32_t crc, uint64_t num_bytes) const;
 };
 
 class crc8_atm_c: public crc_base_c {
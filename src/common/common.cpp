@@ -79,8 +79,14 @@ static std::string s_program_name;
 
 // Functions
 
+static std::vector<std::function<void()>> s_cleanup_handlers;
+
 static void
 mtx_common_cleanup() {
+  for (auto const &handler : s_cleanup_handlers)
+    handler();
+  s_cleanup_handlers.clear();
+
   // Make sure g_mm_stdio is closed before the global destruction
   // kicks in. If it's redirected to a file then this is an instance
   // of a buffered file. If it's only collected via global destruction
@@ -98,8 +104,23 @@ mtx_common_cleanup() {
   matroska_done();
 }
 
+static thread_local bool s_mxexit_throws = false;
+
+void
+mxexit_throws_on_this_thread(bool enable) {
+  s_mxexit_throws = enable;
+}
+
+void
+mxexit_add_cleanup_handler(std::function<void()> const &handler) {
+  s_cleanup_handlers.push_back(handler);
+}
+
 void
 mxexit(int code) {
+  if (s_mxexit_throws)
+    throw mtx::exit_x{code};
+
   mtx_common_cleanup();
 
   if (code != -1)
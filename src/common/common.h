@@ -130,6 +130,13 @@ using namespace libmatroska;
 #define TIMECODE_SCALE 1000000
 
 void mxexit(int code = -1);
+// Makes mxexit() throw mtx::exit_x on the calling thread instead of
+// ending the program, e.g. on worker threads whose errors must be
+// handled by the main thread.
+void mxexit_throws_on_this_thread(bool enable);
+// Registers a function that mxexit() runs before ending the program,
+// e.g. for stopping worker threads that still access global state.
+void mxexit_add_cleanup_handler(std::function<void()> const &handler);
 void set_process_priority(int priority);
 
 extern unsigned int verbose;
@@ -69,8 +69,10 @@ zlib_compressor_c::do_compress(memory_cptr const &buffer) {
   c_stream.opaque = (voidpf)0;
   int result      = deflateInit(&c_stream, 9);
 
+  // Compression may run on a worker thread. Errors are therefore
+  // reported to the caller instead of ending the program.
   if (Z_OK != result)
-    mxerror(boost::format(Y("deflateInit() failed. Result: %1%\n")) % result);
+    throw mtx::compression_x(boost::format(Y("deflateInit() failed. Result: %1%\n")) % result);
 
   c_stream.next_in   = (Bytef *)buffer->get_buffer();
   c_stream.avail_in  = buffer->get_size();
@@ -84,8 +86,10 @@ zlib_compressor_c::do_compress(memory_cptr const &buffer) {
     c_stream.avail_out = 4000;
     result             = deflate(&c_stream, Z_FINISH);
 
-    if ((Z_OK != result) && (Z_STREAM_END != result))
-      mxerror(boost::format(Y("Zlib decompression failed. Result: %1%\n")) % result);
+    if ((Z_OK != result) && (Z_STREAM_END != result)) {
+      deflateEnd(&c_stream);
+      throw mtx::compression_x(boost::format(Y("Zlib decompression failed. Result: %1%\n")) % result);
+    }
 
   } while ((c_stream.avail_out == 0) && (result != Z_STREAM_END));
 
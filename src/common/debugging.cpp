@@ -13,6 +13,7 @@
 
 #include "common/common_pch.h"
 
+#include <mutex>
 #include <sstream>
 
 #include <ebml/EbmlDate.h>
@@ -102,8 +103,8 @@ debugging_c::output(std::string const &msg) {
 void
 debugging_c::hexdump(const void *buffer_to_dump,
                      size_t length) {
-  static auto s_fmt_line = boost::format{"Debug> %|1$08x|  "};
-  static auto s_fmt_byte = boost::format{"%|1$02x| "};
+  static thread_local auto s_fmt_line = boost::format{"Debug> %|1$08x|  "};
+  static thread_local auto s_fmt_byte = boost::format{"%|1$02x| "};
 
   std::stringstream dump, ascii;
   auto buffer     = static_cast<const unsigned char *>(buffer_to_dump);
@@ -137,23 +138,31 @@ debugging_c::hexdump(const void *buffer_to_dump,
 
 // ------------------------------------------------------------
 
-std::vector<debugging_option_c::option_c> debugging_option_c::ms_registered_options;
+std::deque<debugging_option_c::option_c> debugging_option_c::ms_registered_options;
 
-size_t
+// mkvmerge's reader threads register options concurrently with the
+// main thread. The deque keeps registered entries in place.
+static std::mutex s_registered_options_mutex;
+
+debugging_option_c::option_c &
 debugging_option_c::register_option(std::string const &option) {
+  std::lock_guard<std::mutex> lock{s_registered_options_mutex};
+
   auto itr = brng::find_if(ms_registered_options, [&option](option_c const &opt) { return opt.m_option == option; });
   if (itr != ms_registered_options.end())
-    return std::distance(ms_registered_options.begin(), itr);
+    return *itr;
 
   ms_registered_options.emplace_back(option);
 
-  return ms_registered_options.size() - 1;
+  return ms_registered_options.back();
 }
 
 void
 debugging_option_c::invalidate_cache() {
+  std::lock_guard<std::mutex> lock{s_registered_options_mutex};
+
   for (auto &opt : ms_registered_options)
-    opt.m_requested = boost::logic::indeterminate;
+    opt.m_requested = -1;
 }
 
 // ------------------------------------------------------------
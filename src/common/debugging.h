@@ -16,6 +16,8 @@
 
 #include "common/common_pch.h"
 
+#include <atomic>
+#include <deque>
 #include <sstream>
 #include <unordered_map>
 
@@ -43,46 +45,67 @@ public:
 
 class debugging_option_c {
   struct option_c {
-    boost::tribool m_requested;
+    std::atomic<int> m_requested; // -1 if not evaluated yet
     std::string m_option;
 
     option_c(std::string const &option)
-      : m_requested{boost::logic::indeterminate}
+      : m_requested{-1}
       , m_option{option}
     {
     }
 
     bool get() {
-      if (boost::logic::indeterminate(m_requested))
-        m_requested = debugging_c::requested(m_option);
+      auto requested = m_requested.load(std::memory_order_relaxed);
+      if (-1 == requested) {
+        requested = debugging_c::requested(m_option) ? 1 : 0;
+        m_requested.store(requested, std::memory_order_relaxed);
+      }
 
-      return m_requested;
+      return 1 == requested;
     }
   };
 
 protected:
-  mutable size_t m_registered_idx;
+  mutable std::atomic<option_c *> m_registered;
   std::string m_option;
 
 private:
-  static std::vector<option_c> ms_registered_options;
+  static std::deque<option_c> ms_registered_options;
 
 public:
   debugging_option_c(std::string const &option)
-    : m_registered_idx{std::numeric_limits<size_t>::max()}
+    : m_registered{nullptr}
     , m_option{option}
   {
   }
 
+  debugging_option_c(debugging_option_c const &other)
+    : m_registered{other.m_registered.load()}
+    , m_option{other.m_option}
+  {
+  }
+
+  debugging_option_c &
+  operator =(debugging_option_c const &other) {
+    m_registered = other.m_registered.load();
+    m_option     = other.m_option;
+    return *this;
+  }
+
+  // Options are checked on hot paths and from several threads. Only
+  // the first check registers the option; later ones don't lock.
   operator bool() const {
-    if (m_registered_idx == std::numeric_limits<size_t>::max())
-      m_registered_idx = register_option(m_option);
+    auto registered = m_registered.load(std::memory_order_acquire);
+    if (!registered) {
+      registered = &register_option(m_option);
+      m_registered.store(registered, std::memory_order_release);
+    }
 
-    return ms_registered_options.at(m_registered_idx).get();
+    return registered->get();
   }
 
 public:
-  static size_t register_option(std::string const &option);
+  static option_c &register_option(std::string const &option);
   static void invalidate_cache();
 };
 
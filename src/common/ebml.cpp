@@ -345,9 +345,10 @@ remove_voids_from_master(EbmlElement *element) {
 int
 write_ebml_element_head(mm_io_c &out,
                         EbmlId const &id,
-                        int64_t content_size) {
+                        int64_t content_size,
+                        int min_coded_size) {
 	int id_size    = EBML_ID_LENGTH(id);
-	int coded_size = CodedSizeLength(content_size, 0);
+	int coded_size = CodedSizeLength(content_size, min_coded_size);
   uint8_t buffer[4 + 8];
 
 	id.Fill(buffer);
@@ -38,6 +38,27 @@ public:
   }
 };
 
+// Thrown by mxexit() instead of ending the program on threads that
+// have requested it with mxexit_throws_on_this_thread().
+class exit_x: public exception {
+protected:
+  int m_code;
+
+public:
+  exit_x(int code)
+    : m_code{code}
+  {
+  }
+
+  virtual const char *what() const throw() {
+    return "exiting the program has been requested";
+  }
+
+  int code() const {
+    return m_code;
+  }
+};
+
 inline std::ostream &
 operator <<(std::ostream &out,
             exception const &ex) {
@@ -14,15 +14,21 @@
 #include "common/common_pch.h"
 
 #include <locale.h>
+#include <mutex>
 
 #include "common/at_scope_exit.h"
 #include "common/json.h"
 
 namespace mtx { namespace json {
 
+// The locale is process-wide, so threads must not switch it at the same
+// time.
+static std::mutex s_locale_mutex;
+
 nlohmann::json
 parse(nlohmann::json::string_t const &data,
       nlohmann::json::parser_callback_t callback) {
+  std::lock_guard<std::mutex> lock{s_locale_mutex};
   auto old_locale = std::string{::setlocale(LC_NUMERIC, "C")};
   at_scope_exit_c restore_locale{ [&]() { ::setlocale(LC_NUMERIC, old_locale.c_str()); } };
 
@@ -32,6 +38,7 @@ parse(nlohmann::json::string_t const &data,
 nlohmann::json::string_t
 dump(nlohmann::json const &json,
      int indentation) {
+  std::lock_guard<std::mutex> lock{s_locale_mutex};
   auto old_locale = std::string{::setlocale(LC_NUMERIC, "C")};
   at_scope_exit_c restore_locale{ [&]() { ::setlocale(LC_NUMERIC, old_locale.c_str()); } };
 
@@ -160,12 +160,20 @@ iconv_charset_converter_c::utf8(const std::string &source) {
   if (handle_string_with_bom(source, recoded))
     return recoded;
 
-  return m_is_utf8 ? source : iconv_charset_converter_c::convert(m_to_utf8_handle, source);
+  if (m_is_utf8)
+    return source;
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+  return iconv_charset_converter_c::convert(m_to_utf8_handle, source);
 }
 
 std::string
 iconv_charset_converter_c::native(const std::string &source) {
-  return m_is_utf8 ? source : iconv_charset_converter_c::convert(m_from_utf8_handle, source);
+  if (m_is_utf8)
+    return source;
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+  return iconv_charset_converter_c::convert(m_from_utf8_handle, source);
 }
 
 std::string
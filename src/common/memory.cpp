@@ -13,9 +13,167 @@
 
 #include "common/common_pch.h"
 
+#include "common/debugging.h"
 #include "common/memory.h"
 #include "common/error.h"
 
+memory_pool_c::memory_pool_c()
+  : m_size_classes(get_class_idx(ms_max_block_size) + 1)
+{
+}
+
+// Size classes are the powers of two and the values half way between
+// them: 16, 24, 32, 48, 64, 96…
+size_t
+memory_pool_c::get_class_idx(size_t size) {
+  if (size <= ms_min_block_size)
+    return 0;
+
+  auto idx        = size_t{};
+  auto class_size = ms_min_block_size;
+
+  while (class_size < size) {
+    class_size = idx & 1 ? class_size * 4 / 3 : class_size * 3 / 2;
+    ++idx;
+  }
+
+  return idx;
+}
+
+size_t
+memory_pool_c::get_class_size(size_t class_idx) {
+  auto size = ms_min_block_size << (class_idx / 2);
+  return class_idx & 1 ? size * 3 / 2 : size;
+}
+
+unsigned char *
+memory_pool_c::allocate(size_t size,
+                        size_t &capacity) {
+  if (size > ms_max_block_size) {
+    capacity = 0;
+    return safemalloc(size);
+  }
+
+  auto class_idx   = get_class_idx(size);
+  auto &size_class = m_size_classes[class_idx];
+  capacity         = get_class_size(class_idx);
+
+  {
+    std::lock_guard<std::mutex> lock{size_class.m_mutex};
+
+    ++size_class.m_num_allocations;
+
+    if (!size_class.m_free_blocks.empty()) {
+      auto block = size_class.m_free_blocks.back();
+      size_class.m_free_blocks.pop_back();
+
+      ++size_class.m_num_allocations_avoided;
+      m_bytes_retained -= capacity;
+
+      return block;
+    }
+  }
+
+  m_bytes_allocated += capacity;
+  update_peak_bytes();
+
+  return safemalloc(capacity);
+}
+
+void
+memory_pool_c::release(unsigned char *block,
+                       size_t capacity) {
+  auto &size_class = m_size_classes[get_class_idx(capacity)];
+
+  // Reserve the space first so that concurrent releases cannot exceed
+  // the limit together.
+  if ((m_bytes_retained += capacity) <= ms_max_bytes_retained) {
+    std::lock_guard<std::mutex> lock{size_class.m_mutex};
+    size_class.m_free_blocks.push_back(block);
+    return;
+  }
+
+  m_bytes_retained  -= capacity;
+  m_bytes_allocated -= capacity;
+
+  {
+    std::lock_guard<std::mutex> lock{size_class.m_mutex};
+    ++size_class.m_num_blocks_discarded;
+  }
+
+  free(block);
+}
+
+void
+memory_pool_c::forget(size_t capacity) {
+  m_bytes_allocated -= capacity;
+}
+
+void
+memory_pool_c::update_peak_bytes() {
+  auto bytes = m_bytes_allocated.load();
+  auto peak  = m_peak_bytes.load();
+
+  while ((peak < bytes) && !m_peak_bytes.compare_exchange_weak(peak, bytes))
+    ;
+}
+
+void *
+memory_pool_c::allocate_object(size_t size) {
+  auto capacity = size_t{};
+  return allocate(size, capacity);
+}
+
+void
+memory_pool_c::release_object(void *object,
+                              size_t size) {
+  if (object)
+    release(static_cast<unsigned char *>(object), get_class_size(get_class_idx(size)));
+}
+
+uint64_t
+memory_pool_c::get_num_heap_allocations() {
+  auto num_heap_allocations = uint64_t{};
+
+  for (auto &size_class : m_size_classes) {
+    std::lock_guard<std::mutex> lock{size_class.m_mutex};
+    num_heap_allocations += size_class.m_num_allocations - size_class.m_num_allocations_avoided;
+  }
+
+  return num_heap_allocations;
+}
+
+void
+memory_pool_c::dump_statistics() {
+  static debugging_option_c s_debug{"memory_pool"};
+
+  if (!s_debug)
+    return;
+
+  auto num_allocations = uint64_t{}, num_allocations_avoided = uint64_t{}, num_blocks_discarded = uint64_t{};
+
+  for (auto &size_class : m_size_classes) {
+    std::lock_guard<std::mutex> lock{size_class.m_mutex};
+
+    num_allocations         += size_class.m_num_allocations;
+    num_allocations_avoided += size_class.m_num_allocations_avoided;
+    num_blocks_discarded    += size_class.m_num_blocks_discarded;
+  }
+
+  mxdebug(boost::format("memory_pool: allocations: %1% avoided: %2% (%3%%%) discarded blocks: %4% peak pool memory: %5% bytes retained at exit: %6% bytes\n")
+          % num_allocations % num_allocations_avoided % (num_allocations ? num_allocations_avoided * 100 / num_allocations : 0)
+          % num_blocks_discarded % m_peak_bytes.load() % m_bytes_retained.load());
+}
+
+memory_pool_c &
+memory_pool_c::get() {
+  // Never destroyed on purpose: memory_c instances with static storage
+  // duration may release their buffers after all other static objects
+  // have been destroyed.
+  static auto s_pool = new memory_pool_c;
+  return *s_pool;
+}
+
 void
 memory_c::resize(size_t new_size)
   throw()
@@ -23,16 +181,35 @@ memory_c::resize(size_t new_size)
   if (!its_counter)
     its_counter = new counter(nullptr, 0, false);
 
-  if (its_counter->is_free) {
+  auto &pool = memory_pool_c::get();
+
+  if (its_counter->is_free && its_counter->capacity) {
+    auto total_size = new_size + its_counter->offset;
+
+    if (total_size > its_counter->capacity) {
+      auto new_capacity = size_t{};
+      auto tmp          = pool.allocate(total_size, new_capacity);
+
+      memcpy(tmp, its_counter->ptr, std::min(total_size, its_counter->size));
+      pool.release(its_counter->ptr, its_counter->capacity);
+
+      its_counter->ptr      = tmp;
+      its_counter->capacity = new_capacity;
+    }
+
+    its_counter->size = total_size;
+
+  } else if (its_counter->is_free) {
     its_counter->ptr  = (unsigned char *)saferealloc(its_counter->ptr, new_size + its_counter->offset);
     its_counter->size = new_size + its_counter->offset;
 
   } else {
-    auto tmp = (unsigned char *)safemalloc(new_size);
+    auto tmp = pool.allocate(new_size, its_counter->capacity);
     memcpy(tmp, its_counter->ptr + its_counter->offset, std::min(new_size, its_counter->size - its_counter->offset));
     its_counter->ptr     = tmp;
     its_counter->is_free = true;
     its_counter->size    = new_size;
+    its_counter->owner.reset();
   }
 }
 
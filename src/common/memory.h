@@ -16,7 +16,9 @@
 
 #include "common/common_pch.h"
 
+#include <atomic>
 #include <deque>
+#include <mutex>
 
 namespace mtx {
   namespace mem {
@@ -77,6 +79,59 @@ _safestrdup(const char *s,
 #define saferealloc(mem, size) _saferealloc(mem, size, __FILE__, __LINE__)
 unsigned char *_saferealloc(void *mem, size_t size, const char *file, int line);
 
+// Recycles heap blocks in size classes so that the per-packet
+// allocations on the muxing hot path (payload buffers, memory_c
+// objects and their counters, packet_t objects) don't have to go
+// through malloc()/free() each time. Blocks handed out are regular
+// malloc() blocks; a block that is never given back to the pool can
+// still be released with free(). Thread-safe; each size class has its
+// own lock so that threads working with blocks of different sizes
+// don't wait for each other.
+class memory_pool_c {
+protected:
+  struct size_class_t {
+    std::mutex m_mutex;
+    std::vector<unsigned char *> m_free_blocks;
+    uint64_t m_num_allocations{}, m_num_allocations_avoided{}, m_num_blocks_discarded{};
+  };
+
+  std::vector<size_class_t> m_size_classes;
+  // 'm_bytes_allocated' covers the blocks in use and the ones retained;
+  // it only changes when blocks are obtained from or given back to the
+  // heap.
+  std::atomic<size_t> m_bytes_allocated{}, m_bytes_retained{}, m_peak_bytes{};
+
+  static size_t const ms_min_block_size = 16, ms_max_block_size = 16 * 1024 * 1024, ms_max_bytes_retained = 64 * 1024 * 1024;
+
+public:
+  memory_pool_c();
+
+  // Returns a block of at least 'size' bytes. 'capacity' is set to the
+  // block's actual size if it stems from the pool and to 0 if it was
+  // allocated directly because it is too big.
+  unsigned char *allocate(size_t size, size_t &capacity);
+  void release(unsigned char *block, size_t capacity);
+  // Called when a pooled block is handed over to an owner that will
+  // free() it itself.
+  void forget(size_t capacity);
+
+  void *allocate_object(size_t size);
+  void release_object(void *object, size_t size);
+
+  // The number of blocks that had to be obtained with malloc().
+  uint64_t get_num_heap_allocations();
+  void dump_statistics();
+
+protected:
+  void update_peak_bytes();
+
+  static size_t get_class_idx(size_t size);
+  static size_t get_class_size(size_t class_idx);
+
+public:
+  static memory_pool_c &get();
+};
+
 class memory_c;
 using memory_cptr = std::shared_ptr<memory_c>;
 using memories_c  = std::vector<memory_cptr>;
@@ -93,8 +148,9 @@ public:
   }
 
   explicit memory_c(size_t s)
-    : its_counter(new counter(static_cast<unsigned char *>(safemalloc(s)), s, true))
+    : its_counter(new counter(nullptr, s, true))
   {
+    its_counter->ptr = memory_pool_c::get().allocate(s, its_counter->capacity);
   }
 
   ~memory_c() {
@@ -148,8 +204,10 @@ public:
     return its_counter && its_counter->is_free;
   }
 
+  // Makes sure the buffer stays valid independently of whoever handed
+  // it out. Slices already keep their owner alive and are left alone.
   void grab() {
-    if (!its_counter || its_counter->is_free)
+    if (!its_counter || its_counter->is_free || its_counter->owner)
       return;
 
     its_counter->ptr      = static_cast<unsigned char *>(safememdup(get_buffer(), get_size()));
@@ -159,8 +217,14 @@ public:
   }
 
   void lock() {
-    if (its_counter)
-      its_counter->is_free = false;
+    if (!its_counter)
+      return;
+
+    if (its_counter->is_free && its_counter->capacity)
+      memory_pool_c::get().forget(its_counter->capacity);
+
+    its_counter->is_free  = false;
+    its_counter->capacity = 0;
   }
 
   void resize(size_t new_size) throw();
@@ -195,16 +259,29 @@ public:
     return !(*this == cmp);
   }
 
+  static void *operator new(size_t size) {
+    return memory_pool_c::get().allocate_object(size);
+  }
+
+  static void operator delete(void *p, size_t size) {
+    memory_pool_c::get().release_object(p, size);
+  }
+
 public:
   static memory_cptr
   alloc(size_t size) {
-    return memory_cptr(new memory_c(static_cast<unsigned char *>(safemalloc(size)), size, true));
+    return memory_cptr(new memory_c(size));
   };
 
   static inline memory_cptr
   clone(const void *buffer,
         size_t size) {
-    return memory_cptr(new memory_c(static_cast<unsigned char *>(safememdup(buffer, size)), size, true));
+    if (!buffer)
+      return memory_cptr(new memory_c());
+
+    auto mem = memory_cptr(new memory_c(size));
+    memcpy(mem->get_buffer(), buffer, size);
+    return mem;
   }
 
   static inline memory_cptr
@@ -212,6 +289,29 @@ public:
     return clone(buffer.c_str(), buffer.length());
   }
 
+  // Returns a buffer referring to 'size' bytes at 'offset' within
+  // 'parent' without copying them. 'parent' is kept alive for as long
+  // as the slice exists.
+  static inline memory_cptr
+  slice(memory_cptr const &parent,
+        size_t offset,
+        size_t size) {
+    return borrow(parent, parent->get_buffer() + offset, size);
+  }
+
+  // Same as slice() for memory that isn't managed by a memory_c, e.g.
+  // a file mapping. 'buffer' must stay valid for as long as 'owner'
+  // exists.
+  static inline memory_cptr
+  borrow(std::shared_ptr<void> const &owner,
+         unsigned char *buffer,
+         size_t size) {
+    auto mem = memory_cptr(new memory_c(buffer, size, false));
+    if (mem->its_counter)
+      mem->its_counter->owner = owner;
+    return mem;
+  }
+
   static inline memory_cptr
   point_to(std::string &buffer) {
     return std::make_shared<memory_c>(reinterpret_cast<unsigned char *>(&buffer[0]), buffer.length(), false);
@@ -223,7 +323,8 @@ private:
     size_t size;
     bool is_free;
     unsigned count;
-    size_t offset;
+    size_t offset, capacity;
+    std::shared_ptr<void> owner;
 
     counter(unsigned char *p = nullptr,
             size_t s = 0,
@@ -234,7 +335,16 @@ private:
       , is_free(f)
       , count(c)
       , offset(0)
+      , capacity(0)
     { }
+
+    static void *operator new(size_t size) {
+      return memory_pool_c::get().allocate_object(size);
+    }
+
+    static void operator delete(void *p, size_t size) {
+      memory_pool_c::get().release_object(p, size);
+    }
   } *its_counter;
 
   void acquire(counter *c) throw() { // increment the count
@@ -246,7 +356,9 @@ private:
   void release() { // decrement the count, delete if it is 0
     if (its_counter) {
       if (--its_counter->count == 0) {
-        if (its_counter->is_free)
+        if (its_counter->is_free && its_counter->capacity)
+          memory_pool_c::get().release(its_counter->ptr, its_counter->capacity);
+        else if (its_counter->is_free)
           free(its_counter->ptr);
         delete its_counter;
       }
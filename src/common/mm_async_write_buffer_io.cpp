@@ -0,0 +1,318 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   IO callback class implementation
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include "common/mm_async_write_buffer_io.h"
+#include "common/mm_io_x.h"
+
+mm_async_write_buffer_io_c::mm_async_write_buffer_io_c(mm_io_c *out,
+                                                       size_t buffer_size,
+                                                       bool delete_out)
+  : mm_write_buffer_io_c(out, buffer_size, delete_out)
+  , m_af_pending_buffer(memory_c::alloc(buffer_size))
+  , m_pending_fill{}
+  , m_pending_referenced_size{}
+  , m_pending{}
+  , m_stop{}
+  , m_buffer_pos{out->getFilePointer()}
+  , m_num_buffers_written{}
+  , m_num_times_blocked{}
+  , m_bytes_written{}
+  , m_time_blocked{}
+  , m_time_writing{}
+  , m_debug_stats{"write_buffer_io|write_buffer_io_stats"}
+{
+  m_thread = std::thread{[this]() { write_in_background(); }};
+}
+
+mm_async_write_buffer_io_c::~mm_async_write_buffer_io_c() {
+  // Errors cannot be reported from here. Callers interested in them
+  // must call close() explicitly.
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+mm_io_cptr
+mm_async_write_buffer_io_c::open(const std::string &file_name,
+                                 size_t buffer_size) {
+  return mm_io_cptr(new mm_async_write_buffer_io_c(new mm_file_io_c(file_name, MODE_CREATE), buffer_size));
+}
+
+void
+mm_async_write_buffer_io_c::write_in_background() {
+  std::unique_lock<std::mutex> lock{m_mutex};
+
+  while (true) {
+    m_cond.wait(lock, [this]() { return m_pending || m_stop; });
+
+    if (!m_pending)
+      return;
+
+    auto buffer     = m_af_pending_buffer->get_buffer();
+    auto buffered   = m_pending_fill;
+    auto fill       = m_pending_fill + m_pending_referenced_size;
+    auto references = std::move(m_pending_references);
+
+    m_pending_references.clear();
+
+    lock.unlock();
+
+    auto start              = std::chrono::steady_clock::now();
+    auto exception          = std::exception_ptr{};
+    auto written            = size_t{};
+
+    try {
+      written = references.empty() ? m_proxy_io->write(buffer, fill)
+              :                      m_proxy_io->write_vectored(make_io_vecs(buffer, buffered, references));
+      if (written != fill)
+        throw mtx::mm_io::insufficient_space_x();
+    } catch (...) {
+      exception = std::current_exception();
+    }
+
+    auto duration = std::chrono::steady_clock::now() - start;
+
+    lock.lock();
+
+    mxdebug_if(m_debug_write, boost::format("flush_buffer() in background for %1% written %2%\n") % fill % written);
+
+    m_time_writing  += duration;
+    m_bytes_written += written;
+    ++m_num_buffers_written;
+
+    if (exception && !m_exception)
+      m_exception = exception;
+
+    m_pending = false;
+    m_cond.notify_all();
+  }
+}
+
+void
+mm_async_write_buffer_io_c::wait_for_pending_write() {
+  std::unique_lock<std::mutex> lock{m_mutex};
+
+  if (m_pending) {
+    auto start = std::chrono::steady_clock::now();
+    m_cond.wait(lock, [this]() { return !m_pending; });
+
+    m_time_blocked += std::chrono::steady_clock::now() - start;
+    ++m_num_times_blocked;
+  }
+
+  if (!m_exception)
+    return;
+
+  auto exception = m_exception;
+  m_exception    = nullptr;
+  std::rethrow_exception(exception);
+}
+
+// Writes out everything buffered so far and waits until the proxied
+// I/O object is idle again.
+void
+mm_async_write_buffer_io_c::synchronize() {
+  flush_buffer();
+  wait_for_pending_write();
+}
+
+void
+mm_async_write_buffer_io_c::flush_buffer() {
+  if (!m_fill && m_references.empty())
+    return;
+
+  wait_for_pending_write();
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+
+  std::swap(m_af_buffer, m_af_pending_buffer);
+  std::swap(m_references, m_pending_references);
+  m_buffer                   = m_af_buffer->get_buffer();
+  m_pending_fill             = m_fill;
+  m_pending_referenced_size  = m_referenced_size;
+  m_buffer_pos              += m_fill + m_referenced_size;
+  m_fill                     = 0;
+  m_referenced_size          = 0;
+  m_pending                  = true;
+
+  m_references.clear();
+
+  m_cond.notify_all();
+}
+
+uint64
+mm_async_write_buffer_io_c::getFilePointer() {
+  return m_buffer_pos + m_fill + m_referenced_size;
+}
+
+void
+mm_async_write_buffer_io_c::setFilePointer(int64 offset,
+                                           seek_mode mode) {
+  if ((seek_beginning == mode) && (offset == static_cast<int64>(getFilePointer())))
+    return;
+
+  synchronize();
+
+  int64_t previous_pos = m_buffer_pos;
+  mm_proxy_io_c::setFilePointer(offset, mode);
+  m_buffer_pos = m_proxy_io->getFilePointer();
+
+  mxdebug_if(m_debug_seek, boost::format("seek from %1% to %2% diff %3%\n") % previous_pos % m_buffer_pos % (static_cast<int64_t>(m_buffer_pos) - previous_pos));
+}
+
+bool
+mm_async_write_buffer_io_c::eof() {
+  synchronize();
+  return mm_proxy_io_c::eof();
+}
+
+void
+mm_async_write_buffer_io_c::clear_eof() {
+  synchronize();
+  mm_proxy_io_c::clear_eof();
+}
+
+void
+mm_async_write_buffer_io_c::flush() {
+  synchronize();
+  mm_proxy_io_c::flush();
+}
+
+void
+mm_async_write_buffer_io_c::stop_thread() {
+  if (!m_thread.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_stop = true;
+    m_cond.notify_all();
+  }
+
+  m_thread.join();
+}
+
+// Closes the proxied I/O object even if writing the remaining data
+// fails. The error is reported afterwards.
+void
+mm_async_write_buffer_io_c::close() {
+  auto exception = std::exception_ptr{};
+
+  if (m_thread.joinable()) {
+    try {
+      synchronize();
+    } catch (...) {
+      exception = std::current_exception();
+      mm_write_buffer_io_c::discard_buffer();
+    }
+
+    stop_thread();
+    dump_statistics();
+  }
+
+  mm_proxy_io_c::close();
+
+  if (exception)
+    std::rethrow_exception(exception);
+}
+
+// Drops both the buffer being filled and the one not yet picked up by
+// the background thread as well as any error reported by it. A write
+// that is already in progress is waited for.
+void
+mm_async_write_buffer_io_c::discard_buffer() {
+  mm_write_buffer_io_c::discard_buffer();
+
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_pending = false;
+    m_pending_references.clear();
+  }
+
+  stop_thread();
+
+  m_exception = nullptr;
+}
+
+bool
+mm_async_write_buffer_io_c::enable_direct_io() {
+  synchronize();
+
+  if (!mm_write_buffer_io_c::enable_direct_io())
+    return false;
+
+  m_af_pending_buffer = allocate_buffer(m_size);
+
+  return true;
+}
+
+uint32
+mm_async_write_buffer_io_c::_read(void *buffer,
+                                  size_t size) {
+  synchronize();
+
+  auto num_read = mm_proxy_io_c::_read(buffer, size);
+  m_buffer_pos  = m_proxy_io->getFilePointer();
+
+  return num_read;
+}
+
+size_t
+mm_async_write_buffer_io_c::_write(const void *buffer,
+                                   size_t size) {
+  if (reference_instead_of_copying(buffer, size))
+    return size;
+
+  // Unlike the synchronous base class large writes are always copied
+  // into the buffer so that the proxied I/O object is only ever
+  // written to by the background thread.
+  auto buf    = static_cast<unsigned char const *>(buffer);
+  auto remain = size;
+
+  while (remain) {
+    auto avail = std::min(remain, m_size - m_fill);
+
+    memcpy(m_buffer + m_fill, buf, avail);
+    m_fill += avail;
+    remain -= avail;
+    buf    += avail;
+
+    if (m_fill == m_size)
+      flush_full_buffer();
+  }
+
+  m_cached_size = -1;
+
+  return size;
+}
+
+void
+mm_async_write_buffer_io_c::dump_statistics()
+  const {
+  if (!m_debug_stats)
+    return;
+
+  auto to_seconds = [](std::chrono::steady_clock::duration const &duration) {
+    return std::chrono::duration_cast<std::chrono::duration<double>>(duration).count();
+  };
+
+  auto time_writing = to_seconds(m_time_writing);
+
+  mxdebug(boost::format("%1%: %2% bytes in %3% buffers written in %4%s (%5% MB/s); blocked %6% times for %7%s in total\n")
+          % get_file_name() % m_bytes_written % m_num_buffers_written % time_writing
+          % (time_writing > 0 ? m_bytes_written / time_writing / 1024 / 1024 : 0.0)
+          % m_num_times_blocked % to_seconds(m_time_blocked));
+}
@@ -0,0 +1,76 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   IO callback class definitions
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_COMMON_MM_ASYNC_WRITE_BUFFER_IO_H
+#define MTX_COMMON_MM_ASYNC_WRITE_BUFFER_IO_H
+
+#include "common/common_pch.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "common/mm_write_buffer_io.h"
+
+// A write buffer whose full buffers are written by a background thread
+// while the caller continues filling a second buffer. Every operation
+// other than buffered writing (seeking, reading, querying the size,
+// flushing) first waits for the background write to finish so that the
+// proxied I/O object is never accessed concurrently.
+class mm_async_write_buffer_io_c: public mm_write_buffer_io_c {
+protected:
+  memory_cptr m_af_pending_buffer;
+  size_t m_pending_fill, m_pending_referenced_size;
+  std::vector<reference_t> m_pending_references;
+  bool m_pending, m_stop;
+  uint64_t m_buffer_pos;
+  std::exception_ptr m_exception;
+
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+
+  int64_t m_num_buffers_written, m_num_times_blocked, m_bytes_written;
+  std::chrono::steady_clock::duration m_time_blocked, m_time_writing;
+  debugging_option_c m_debug_stats;
+
+public:
+  mm_async_write_buffer_io_c(mm_io_c *out, size_t buffer_size, bool delete_out = true);
+  virtual ~mm_async_write_buffer_io_c();
+
+  virtual uint64 getFilePointer();
+  virtual void setFilePointer(int64 offset, seek_mode mode = seek_beginning);
+  virtual bool eof();
+  virtual void clear_eof();
+  virtual void flush();
+  virtual void close();
+  virtual void discard_buffer();
+  virtual bool enable_direct_io();
+
+  static mm_io_cptr open(const std::string &file_name, size_t buffer_size);
+
+protected:
+  virtual uint32 _read(void *buffer, size_t size);
+  virtual size_t _write(const void *buffer, size_t size);
+  virtual void flush_buffer();
+
+  void wait_for_pending_write();
+  void synchronize();
+  void stop_thread();
+  void write_in_background();
+  void dump_statistics() const;
+};
+
+#endif // MTX_COMMON_MM_ASYNC_WRITE_BUFFER_IO_H
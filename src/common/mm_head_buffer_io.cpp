@@ -0,0 +1,100 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   IO class keeping the start of a file in memory
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include "common/mm_head_buffer_io.h"
+#include "common/mm_io_x.h"
+
+mm_head_buffer_io_c::mm_head_buffer_io_c(mm_io_c *in,
+                                         size_t head_size,
+                                         bool delete_in)
+  : mm_proxy_io_c{in, delete_in}
+{
+  head_size   = std::min<uint64_t>(head_size, std::max<int64_t>(in->get_size(), 0));
+  m_head      = memory_c::alloc(std::max<size_t>(head_size, 1));
+
+  in->setFilePointer(0);
+  m_head_fill = in->read(m_head->get_buffer(), head_size);
+}
+
+uint64
+mm_head_buffer_io_c::getFilePointer() {
+  return m_pos;
+}
+
+void
+mm_head_buffer_io_c::setFilePointer(int64 offset,
+                                    seek_mode mode) {
+  int64_t new_pos
+    = seek_beginning == mode ? offset
+    : seek_end       == mode ? get_size() + offset // offsets from the end are negative already
+    :                          static_cast<int64_t>(m_pos) + offset;
+
+  m_eof = false;
+
+  if ((0 <= new_pos) && (new_pos <= static_cast<int64_t>(m_head_fill))) {
+    m_pos = new_pos;
+    return;
+  }
+
+  // Let the underlying file decide whether or not positions outside
+  // the head are valid.
+  m_proxy_io->setFilePointer(new_pos);
+  m_pos = m_proxy_io->getFilePointer();
+}
+
+int64_t
+mm_head_buffer_io_c::get_size() {
+  return m_proxy_io->get_size();
+}
+
+bool
+mm_head_buffer_io_c::eof() {
+  return m_eof;
+}
+
+void
+mm_head_buffer_io_c::clear_eof() {
+  m_eof = false;
+}
+
+uint32
+mm_head_buffer_io_c::_read(void *buffer,
+                           size_t size) {
+  auto dst      = static_cast<unsigned char *>(buffer);
+  auto num_read = size_t{};
+
+  if (m_pos < m_head_fill) {
+    num_read = std::min<uint64_t>(size, m_head_fill - m_pos);
+    memcpy(dst, m_head->get_buffer() + m_pos, num_read);
+    m_pos += num_read;
+  }
+
+  if (num_read < size) {
+    m_proxy_io->setFilePointer(m_pos);
+    auto num_read_from_file  = m_proxy_io->read(dst + num_read, size - num_read);
+    num_read                += num_read_from_file;
+    m_pos                   += num_read_from_file;
+  }
+
+  m_eof = num_read < size;
+
+  return num_read;
+}
+
+size_t
+mm_head_buffer_io_c::_write(const void *,
+                            size_t) {
+  throw mtx::mm_io::wrong_read_write_access_x{};
+}
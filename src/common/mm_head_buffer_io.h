@@ -0,0 +1,47 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   class definition for an IO class keeping the start of a file in memory
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_COMMON_MM_HEAD_BUFFER_IO_H
+#define MTX_COMMON_MM_HEAD_BUFFER_IO_H
+
+#include "common/common_pch.h"
+
+#include "common/mm_io.h"
+
+// Reads the first 'head_size' bytes of a file once and serves all
+// reads within that range from memory; everything beyond it is read
+// from the underlying file. Meant for file type detection where dozens
+// of probes seek back to the start and read the same data over and
+// over again.
+class mm_head_buffer_io_c: public mm_proxy_io_c {
+protected:
+  memory_cptr m_head;
+  size_t m_head_fill{};
+  uint64_t m_pos{};
+  bool m_eof{};
+
+public:
+  mm_head_buffer_io_c(mm_io_c *in, size_t head_size, bool delete_in = true);
+
+  virtual uint64 getFilePointer();
+  virtual void setFilePointer(int64 offset, seek_mode mode = seek_beginning);
+  virtual int64_t get_size();
+  virtual bool eof();
+  virtual void clear_eof();
+
+protected:
+  virtual uint32 _read(void *buffer, size_t size);
+  virtual size_t _write(const void *buffer, size_t size);
+};
+
+#endif // MTX_COMMON_MM_HEAD_BUFFER_IO_H
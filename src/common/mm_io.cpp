@@ -15,6 +15,7 @@
 #include "common/common_pch.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #ifdef HAVE_UNISTD_H
@@ -22,6 +23,10 @@
 #endif
 #include <sys/stat.h>
 #include <sys/types.h>
+#if !defined(SYS_WINDOWS)
+# include <limits.h>
+# include <sys/uio.h>
+#endif
 
 #include "common/endian.h"
 #include "common/error.h"
@@ -30,6 +35,7 @@
 #include "common/mm_io_x.h"
 #include "common/strings/editing.h"
 #include "common/strings/parsing.h"
+#include "common/timing.h"
 
 union double_to_uint64_t {
   uint64_t i;
@@ -41,6 +47,7 @@ mm_file_io_c::mm_file_io_c(const std::string &path,
                            const open_mode mode)
   : m_file_name(path)
   , m_file(nullptr)
+  , m_direct_fd{-1}
 {
   const char *cmode;
 
@@ -78,6 +85,8 @@ mm_file_io_c::mm_file_io_c(const std::string &path,
 void
 mm_file_io_c::setFilePointer(int64 offset,
                              seek_mode mode) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::io_seek)};
+
   int whence = mode == seek_beginning ? SEEK_SET
              : mode == seek_end       ? SEEK_END
              :                          SEEK_CUR;
@@ -91,22 +100,72 @@ mm_file_io_c::setFilePointer(int64 offset,
 size_t
 mm_file_io_c::_write(const void *buffer,
                      size_t size) {
-  size_t bwritten = fwrite(buffer, 1, size, (FILE *)m_file);
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::io_write)};
+
+  size_t bdirect  = write_directly(buffer, size);
+  size_t bwritten = bdirect < size ? fwrite(static_cast<char const *>(buffer) + bdirect, 1, size - bdirect, (FILE *)m_file) : 0;
   if (ferror((FILE *)m_file) != 0)
     throw mtx::mm_io::read_write_x{mtx::mm_io::make_error_code()};
 
+  timing.add_bytes(bdirect + bwritten);
+
   m_current_position += bwritten;
   m_cached_size       = -1;
 
-  return bwritten;
+  return bdirect + bwritten;
+}
+
+size_t
+mm_file_io_c::write_directly(const void *buffer,
+                             size_t size) {
+  if (   (-1 == m_direct_fd)
+      || !size
+      || (reinterpret_cast<uintptr_t>(buffer) % s_direct_io_alignment)
+      || (size                                 % s_direct_io_alignment)
+      || (m_current_position                   % s_direct_io_alignment))
+    return 0;
+
+  auto file = static_cast<FILE *>(m_file);
+  if (0 != fflush(file))
+    throw mtx::mm_io::read_write_x{mtx::mm_io::make_error_code()};
+
+  ssize_t written;
+  do {
+    written = ::pwrite(m_direct_fd, buffer, size, m_current_position);
+  } while ((-1 == written) && (EINTR == errno));
+
+  if (-1 == written) {
+    // Some file systems have stricter requirements or don't support
+    // direct I/O at all; write normally from now on.
+    if (EINVAL != errno)
+      throw mtx::mm_io::read_write_x{mtx::mm_io::make_error_code()};
+
+    ::close(m_direct_fd);
+    m_direct_fd = -1;
+
+    return 0;
+  }
+
+  m_current_position += written;
+  m_cached_size       = -1;
+
+  // The stream doesn't know about the data written to the other
+  // descriptor.
+  if (0 != fseeko(file, m_current_position, SEEK_SET))
+    throw mtx::mm_io::seek_x{mtx::mm_io::make_error_code()};
+
+  return written;
 }
 
 uint32
 mm_file_io_c::_read(void *buffer,
                     size_t size) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::io_read)};
+
   int64_t bread = fread(buffer, 1, size, (FILE *)m_file);
 
   m_current_position += bread;
+  timing.add_bytes(bread);
 
   return bread;
 }
@@ -117,6 +176,11 @@ mm_file_io_c::close() {
     fclose((FILE *)m_file);
     m_file = nullptr;
   }
+
+  if (-1 != m_direct_fd) {
+    ::close(m_direct_fd);
+    m_direct_fd = -1;
+  }
 }
 
 bool
@@ -135,6 +199,124 @@ mm_file_io_c::truncate(int64_t pos) {
   return ftruncate(fileno((FILE *)m_file), pos);
 }
 
+size_t
+mm_file_io_c::write_vectored(std::vector<io_vec_t> const &parts) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::io_write)};
+
+  // The data fwrite() may still hold must reach the file first, and
+  // the descriptor must be positioned where the stream is.
+  auto file = static_cast<FILE *>(m_file);
+  auto fd   = fileno(file);
+
+  if (   (0 != fflush(file))
+      || (-1 == lseek(fd, m_current_position, SEEK_SET)))
+    throw mtx::mm_io::read_write_x{mtx::mm_io::make_error_code()};
+
+  std::vector<iovec> vecs;
+  vecs.reserve(parts.size());
+
+  for (auto const &part : parts)
+    if (part.m_size)
+      vecs.push_back(iovec{const_cast<void *>(part.m_buffer), part.m_size});
+
+#if defined(IOV_MAX)
+  static auto const s_max_vecs = static_cast<size_t>(IOV_MAX);
+#else
+  static auto const s_max_vecs = static_cast<size_t>(1024);
+#endif
+
+  auto total = size_t{};
+  auto idx   = size_t{};
+
+  while (idx < vecs.size()) {
+    auto written = ::writev(fd, &vecs[idx], std::min(vecs.size() - idx, s_max_vecs));
+
+    if ((-1 == written) && (EINTR == errno))
+      continue;
+
+    if (-1 == written)
+      throw mtx::mm_io::read_write_x{mtx::mm_io::make_error_code()};
+
+    if (!written)
+      break;
+
+    total += written;
+
+    // Skip the buffers written completely; continue with the rest of a
+    // partially written one.
+    for (auto remaining = static_cast<size_t>(written); remaining;) {
+      auto &vec = vecs[idx];
+
+      if (remaining >= vec.iov_len) {
+        remaining -= vec.iov_len;
+        ++idx;
+
+      } else {
+        vec.iov_base  = static_cast<char *>(vec.iov_base) + remaining;
+        vec.iov_len  -= remaining;
+        remaining     = 0;
+      }
+    }
+  }
+
+  timing.add_bytes(total);
+
+  m_current_position += total;
+  m_cached_size       = -1;
+
+  // The stream doesn't know about the data written to its descriptor.
+  if (0 != fseeko(file, m_current_position, SEEK_SET))
+    throw mtx::mm_io::seek_x{mtx::mm_io::make_error_code()};
+
+  return total;
+}
+
+bool
+mm_file_io_c::preallocate(uint64_t size) {
+#if defined(FALLOC_FL_KEEP_SIZE)
+  return 0 == fallocate(fileno(static_cast<FILE *>(m_file)), FALLOC_FL_KEEP_SIZE, 0, size);
+#else
+  (void)size;
+  return false;
+#endif
+}
+
+bool
+mm_file_io_c::enable_direct_io() {
+#if defined(O_DIRECT)
+  if (-1 == m_direct_fd)
+    m_direct_fd = ::open(g_cc_local_utf8->native(m_file_name).c_str(), O_WRONLY | O_DIRECT);
+
+  return -1 != m_direct_fd;
+#else
+  return false;
+#endif
+}
+
+void
+mm_file_io_c::advise(access_e access) {
+#if defined(POSIX_FADV_NORMAL)
+  auto advice = access_e::sequential == access ? POSIX_FADV_SEQUENTIAL
+              : access_e::random     == access ? POSIX_FADV_RANDOM
+              :                                  POSIX_FADV_NORMAL;
+
+  posix_fadvise(fileno(static_cast<FILE *>(m_file)), 0, 0, advice);
+#else
+  (void)access;
+#endif
+}
+
+void
+mm_file_io_c::advise_will_need(uint64_t pos,
+                               uint64_t size) {
+#if defined(POSIX_FADV_WILLNEED)
+  posix_fadvise(fileno(static_cast<FILE *>(m_file)), pos, size, POSIX_FADV_WILLNEED);
+#else
+  (void)pos;
+  (void)size;
+#endif
+}
+
 /** \brief OS and kernel dependant setup
 */
 void
@@ -515,6 +697,21 @@ mm_io_c::write(const memory_cptr &buffer,
   return size;
 }
 
+size_t
+mm_io_c::write_vectored(std::vector<io_vec_t> const &parts) {
+  size_t total = 0;
+
+  for (auto const &part : parts) {
+    auto written  = write(part.m_buffer, part.m_size);
+    total        += written;
+
+    if (written != part.m_size)
+      break;
+  }
+
+  return total;
+}
+
 void
 mm_io_c::skip(int64 num_bytes) {
   uint64_t pos = getFilePointer();
@@ -1081,7 +1278,9 @@ mm_text_io_c::setFilePointer(int64 offset,
    Class for reading from stdin & writing to stdout.
 */
 
-mm_stdio_c::mm_stdio_c() {
+mm_stdio_c::mm_stdio_c(FILE *file)
+  : m_file{file}
+{
 }
 
 uint64
@@ -1106,7 +1305,7 @@ mm_stdio_c::_write(const void *buffer,
                    size_t size) {
   m_cached_size = -1;
 
-  return fwrite(buffer, 1, size, stdout);
+  return fwrite(buffer, 1, size, m_file);
 }
 #endif // defined(SYS_WINDOWS)
 
@@ -1116,5 +1315,5 @@ mm_stdio_c::close() {
 
 void
 mm_stdio_c::flush() {
-  fflush(stdout);
+  fflush(m_file);
 }
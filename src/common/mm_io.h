@@ -29,6 +29,19 @@ class charset_converter_c;
 using charset_converter_cptr = std::shared_ptr<charset_converter_c>;
 
 class mm_io_c: public IOCallback {
+public:
+  enum class access_e {
+    normal,
+    sequential,
+    random,
+  };
+
+  // One of several buffers written with write_vectored().
+  struct io_vec_t {
+    void const *m_buffer;
+    size_t m_size;
+  };
+
 protected:
   bool m_dos_style_newlines, m_bom_written;
   std::stack<int64_t> m_positions;
@@ -76,6 +89,7 @@ public:
   virtual size_t write(const void *buffer, size_t size);
   virtual size_t write(std::string const &buffer);
   virtual size_t write(const memory_cptr &buffer, size_t size = UINT_MAX, size_t offset = 0);
+  virtual size_t write_vectored(std::vector<io_vec_t> const &parts);
   virtual bool eof() = 0;
   virtual void clear_eof() { }
   virtual void flush() {
@@ -114,6 +128,13 @@ public:
   virtual void enable_buffering(bool /* enable */) {
   }
 
+  // Tell the operating system how the file will be read. They do
+  // nothing for I/O classes that aren't backed by a file.
+  virtual void advise(access_e /* access */) {
+  }
+  virtual void advise_will_need(uint64_t /* pos */, uint64_t /* size */) {
+  }
+
 protected:
   virtual uint32 _read(void *buffer, size_t size) = 0;
   virtual size_t _write(const void *buffer, size_t size) = 0;
@@ -126,9 +147,15 @@ protected:
 
 #if defined(SYS_WINDOWS)
   bool m_eof;
+#else
+  int m_direct_fd;
 #endif
 
 public:
+  // Buffers, sizes and file positions of writes bypassing the
+  // page cache must be multiples of this.
+  static size_t const s_direct_io_alignment = 4096;
+
   mm_file_io_c(const std::string &path, const open_mode mode = MODE_READ);
   virtual ~mm_file_io_c();
 
@@ -150,6 +177,19 @@ public:
 
   virtual int truncate(int64_t pos);
 
+  virtual void advise(access_e access);
+  virtual void advise_will_need(uint64_t pos, uint64_t size);
+#if !defined(SYS_WINDOWS)
+  virtual size_t write_vectored(std::vector<io_vec_t> const &parts);
+#endif
+
+  // Reserves disk space for 'size' bytes without changing the file's
+  // size. Returns false if that isn't supported.
+  virtual bool preallocate(uint64_t size);
+  // Writes suitably aligned data bypassing the page cache from now
+  // on. Returns false if that isn't supported.
+  virtual bool enable_direct_io();
+
   static void setup();
   static void cleanup();
   static mm_io_cptr open(const std::string &path, const open_mode mode = MODE_READ);
@@ -157,6 +197,9 @@ public:
 protected:
   virtual uint32 _read(void *buffer, size_t size);
   virtual size_t _write(const void *buffer, size_t size);
+#if !defined(SYS_WINDOWS)
+  size_t write_directly(const void *buffer, size_t size);
+#endif
 };
 
 using mm_file_io_cptr = std::shared_ptr<mm_file_io_c>;
@@ -195,6 +238,12 @@ public:
   virtual mm_io_c *get_proxied() const {
     return m_proxy_io;
   }
+  virtual void advise(access_e access) {
+    m_proxy_io->advise(access);
+  }
+  virtual void advise_will_need(uint64_t pos, uint64_t size) {
+    m_proxy_io->advise_will_need(pos, size);
+  }
 
 protected:
   virtual uint32 _read(void *buffer, size_t size);
@@ -295,8 +344,13 @@ public:
 using mm_text_io_cptr = std::shared_ptr<mm_text_io_c>;
 
 class mm_stdio_c: public mm_io_c {
+protected:
+  FILE *m_file;
+
 public:
-  mm_stdio_c();
+  // Reads from the standard input; writes to 'file' which must be
+  // either stdout or stderr.
+  mm_stdio_c(FILE *file = stdout);
 
   virtual uint64 getFilePointer();
   virtual void setFilePointer(int64 offset, seek_mode mode=seek_beginning);
@@ -33,6 +33,7 @@
 #include "common/strings/editing.h"
 #include "common/strings/parsing.h"
 #include "common/strings/utf8.h"
+#include "common/timing.h"
 
 mm_file_io_c::mm_file_io_c(const std::string &path,
                            const open_mode mode)
@@ -101,6 +102,8 @@ mm_file_io_c::get_real_file_pointer() {
 void
 mm_file_io_c::setFilePointer(int64 offset,
                              seek_mode mode) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::io_seek)};
+
   DWORD method = seek_beginning == mode ? FILE_BEGIN
                : seek_current   == mode ? FILE_CURRENT
                : seek_end       == mode ? FILE_END
@@ -118,6 +121,7 @@ mm_file_io_c::setFilePointer(int64 offset,
 uint32
 mm_file_io_c::_read(void *buffer,
                     size_t size) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::io_read)};
   DWORD bytes_read;
 
   if (!ReadFile((HANDLE)m_file, buffer, size, &bytes_read, nullptr)) {
@@ -129,6 +133,7 @@ mm_file_io_c::_read(void *buffer,
 
   m_eof               = size != bytes_read;
   m_current_position += bytes_read;
+  timing.add_bytes(bytes_read);
 
   return bytes_read;
 }
@@ -136,6 +141,7 @@ mm_file_io_c::_read(void *buffer,
 size_t
 mm_file_io_c::_write(const void *buffer,
                      size_t size) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::io_write)};
   DWORD bytes_written;
 
   if (!WriteFile((HANDLE)m_file, buffer, size, &bytes_written, nullptr))
@@ -200,6 +206,25 @@ mm_file_io_c::truncate(int64_t pos) {
   return -1;
 }
 
+bool
+mm_file_io_c::preallocate(uint64_t) {
+  return false;
+}
+
+bool
+mm_file_io_c::enable_direct_io() {
+  return false;
+}
+
+void
+mm_file_io_c::advise(access_e) {
+}
+
+void
+mm_file_io_c::advise_will_need(uint64_t,
+                               uint64_t) {
+}
+
 void
 mm_file_io_c::setup() {
 }
@@ -209,7 +234,7 @@ static bool s_stdout_binmode_set = false;
 size_t
 mm_stdio_c::_write(const void *buffer,
                    size_t size) {
-  HANDLE h_stdout = GetStdHandle(STD_OUTPUT_HANDLE);
+  HANDLE h_stdout = GetStdHandle(stderr == m_file ? STD_ERROR_HANDLE : STD_OUTPUT_HANDLE);
   if (INVALID_HANDLE_VALUE == h_stdout)
     return 0;
 
@@ -229,13 +254,13 @@ mm_stdio_c::_write(const void *buffer,
     return bytes_written;
   }
 
-  if (!s_stdout_binmode_set) {
+  if ((stdout == m_file) && !s_stdout_binmode_set) {
     _setmode(1, _O_BINARY);
     s_stdout_binmode_set = true;
   }
 
-  size_t bytes_written = fwrite(buffer, 1, size, stdout);
-  fflush(stdout);
+  size_t bytes_written = fwrite(buffer, 1, size, m_file);
+  fflush(m_file);
 
   m_cached_size = -1;
 
@@ -0,0 +1,286 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   memory-mapped input file class
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#if defined(SYS_WINDOWS)
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <sys/types.h>
+# ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+# endif
+#endif
+
+#include "common/mm_io_x.h"
+#include "common/mm_mmap_io.h"
+#if defined(SYS_WINDOWS)
+#include "common/strings/utf8.h"
+#endif
+#include "common/timing.h"
+
+// Owns the mapped memory and the handles it was created from. Shared
+// between the file object and all buffers pointing into the mapping.
+struct mm_mmap_io_c::mapping_t {
+  unsigned char *m_mem{};
+  uint64_t m_size{};
+#if defined(SYS_WINDOWS)
+  HANDLE m_file{INVALID_HANDLE_VALUE}, m_mapping{};
+#else
+  int m_file{-1};
+#endif
+
+  ~mapping_t();
+};
+
+mm_mmap_io_c::mm_mmap_io_c(std::string const &path,
+                           access_e access)
+  : m_file_name{path}
+{
+  map();
+  advise(access);
+}
+
+mm_mmap_io_c::~mm_mmap_io_c() {
+  close();
+}
+
+void
+mm_mmap_io_c::unmap() {
+  m_mapping.reset();
+  m_mem = nullptr;
+}
+
+#if defined(SYS_WINDOWS)
+
+mm_mmap_io_c::mapping_t::~mapping_t() {
+  if (m_mem)
+    UnmapViewOfFile(m_mem);
+  if (m_mapping)
+    CloseHandle(m_mapping);
+  if (INVALID_HANDLE_VALUE != m_file)
+    CloseHandle(m_file);
+}
+
+void
+mm_mmap_io_c::map() {
+  auto mapping    = std::make_shared<mapping_t>();
+  auto w_path     = to_wide(m_file_name);
+  mapping->m_file = CreateFileW(w_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+  if (INVALID_HANDLE_VALUE == mapping->m_file)
+    throw mtx::mm_io::open_x{mtx::mm_io::make_error_code()};
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(mapping->m_file, &size))
+    throw mtx::mm_io::open_x{mtx::mm_io::make_error_code()};
+
+  m_size = size.QuadPart;
+  if (!m_size)
+    return;
+
+  if (static_cast<uint64_t>(m_size) != static_cast<uint64_t>(static_cast<size_t>(m_size)))
+    throw mtx::mm_io::open_x{std::make_error_code(std::errc::file_too_large)};
+
+  mapping->m_mapping = CreateFileMappingW(mapping->m_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  if (mapping->m_mapping)
+    mapping->m_mem = static_cast<unsigned char *>(MapViewOfFile(mapping->m_mapping, FILE_MAP_COPY, 0, 0, 0));
+
+  if (!mapping->m_mem)
+    throw mtx::mm_io::open_x{mtx::mm_io::make_error_code()};
+
+  mapping->m_size = m_size;
+  m_mapping       = mapping;
+  m_mem           = mapping->m_mem;
+}
+
+void
+mm_mmap_io_c::advise(access_e) {
+}
+
+void
+mm_mmap_io_c::advise_will_need(uint64_t,
+                               uint64_t) {
+}
+
+#else  // SYS_WINDOWS
+
+mm_mmap_io_c::mapping_t::~mapping_t() {
+  if (m_mem)
+    munmap(m_mem, m_size);
+  if (-1 != m_file)
+    ::close(m_file);
+}
+
+void
+mm_mmap_io_c::map() {
+  auto mapping    = std::make_shared<mapping_t>();
+  auto local_path = g_cc_local_utf8->native(m_file_name);
+
+  mapping->m_file = ::open(local_path.c_str(), O_RDONLY);
+  if (-1 == mapping->m_file)
+    throw mtx::mm_io::open_x{mtx::mm_io::make_error_code()};
+
+  struct stat st;
+  if (0 != fstat(mapping->m_file, &st))
+    throw mtx::mm_io::open_x{mtx::mm_io::make_error_code()};
+
+  // Pipes, devices etc. cannot be mapped.
+  if (!S_ISREG(st.st_mode))
+    throw mtx::mm_io::open_x{std::make_error_code(std::errc::not_supported)};
+
+  m_size = st.st_size;
+  if (!m_size)
+    return;
+
+  if (static_cast<uint64_t>(m_size) != static_cast<uint64_t>(static_cast<size_t>(m_size)))
+    throw mtx::mm_io::open_x{std::make_error_code(std::errc::file_too_large)};
+
+  // The mapping is writable but private so that users of the buffers
+  // returned by read(size_t) can modify them in place without ever
+  // touching the file.
+  auto mem = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, mapping->m_file, 0);
+  if (MAP_FAILED == mem)
+    throw mtx::mm_io::open_x{mtx::mm_io::make_error_code()};
+
+  mapping->m_mem  = static_cast<unsigned char *>(mem);
+  mapping->m_size = m_size;
+  m_mapping       = mapping;
+  m_mem           = mapping->m_mem;
+}
+
+void
+mm_mmap_io_c::advise(access_e access) {
+  if (!m_mem)
+    return;
+
+  auto advice = access_e::sequential == access ? POSIX_MADV_SEQUENTIAL
+              : access_e::random     == access ? POSIX_MADV_RANDOM
+              :                                  POSIX_MADV_NORMAL;
+
+  posix_madvise(m_mem, m_size, advice);
+}
+
+void
+mm_mmap_io_c::advise_will_need(uint64_t pos,
+                               uint64_t size) {
+  if (!m_mem || (pos >= m_size))
+    return;
+
+  // The address must be aligned to a page boundary.
+  static auto s_page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+  auto start = pos - (pos % s_page_size);
+  auto end   = std::min(pos + size, m_size);
+
+  posix_madvise(m_mem + start, end - start, POSIX_MADV_WILLNEED);
+}
+
+#endif  // SYS_WINDOWS
+
+void
+mm_mmap_io_c::close() {
+  unmap();
+  m_size = 0;
+  m_pos  = 0;
+}
+
+uint64
+mm_mmap_io_c::getFilePointer() {
+  return m_pos;
+}
+
+void
+mm_mmap_io_c::setFilePointer(int64 offset,
+                             seek_mode mode) {
+  int64_t new_pos
+    = seek_beginning == mode ? offset
+    : seek_end       == mode ? static_cast<int64_t>(m_size) + offset // offsets from the end are negative already
+    :                          static_cast<int64_t>(m_pos)  + offset;
+
+  if (0 > new_pos)
+    throw mtx::mm_io::seek_x{std::make_error_code(std::errc::invalid_argument)};
+
+  // Seeking beyond the end behaves like it does for buffered files:
+  // the position is clamped, and the next read returns nothing.
+  m_pos = std::min<uint64_t>(new_pos, m_size);
+  m_eof = false;
+}
+
+int64_t
+mm_mmap_io_c::get_size() {
+  return m_size;
+}
+
+bool
+mm_mmap_io_c::eof() {
+  return m_eof;
+}
+
+void
+mm_mmap_io_c::clear_eof() {
+  m_eof = false;
+}
+
+memory_cptr
+mm_mmap_io_c::slice(uint64_t pos,
+                    uint64_t size)
+  const {
+  if ((pos > m_size) || (size > (m_size - pos)))
+    throw mtx::mm_io::end_of_file_x{};
+
+  return memory_c::borrow(m_mapping, m_mem + pos, size);
+}
+
+memory_cptr
+mm_mmap_io_c::read(size_t size) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::io_read)};
+
+  if (size > (m_size - m_pos)) {
+    m_pos = m_size;
+    m_eof = true;
+    throw mtx::mm_io::end_of_file_x{};
+  }
+
+  auto buffer = slice(m_pos, size);
+  m_pos      += size;
+
+  timing.add_bytes(size);
+
+  return buffer;
+}
+
+uint32
+mm_mmap_io_c::_read(void *buffer,
+                    size_t size) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::io_read)};
+
+  auto num_read = std::min<uint64_t>(size, m_size - m_pos);
+  if (num_read)
+    memcpy(buffer, m_mem + m_pos, num_read);
+
+  m_pos += num_read;
+  m_eof  = num_read < size;
+
+  timing.add_bytes(num_read);
+
+  return num_read;
+}
+
+size_t
+mm_mmap_io_c::_write(const void *,
+                     size_t) {
+  throw mtx::mm_io::wrong_read_write_access_x{};
+}
@@ -0,0 +1,75 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   class definition for the memory-mapped input file class
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_COMMON_MM_MMAP_IO_H
+#define MTX_COMMON_MM_MMAP_IO_H
+
+#include "common/common_pch.h"
+
+#include "common/mm_io.h"
+
+// Maps a whole file into memory for reading. The mapping is private
+// and copy-on-write: the file itself is never modified, but the
+// buffers handed out by read(size_t) may be modified by their users
+// just like freshly allocated ones.
+//
+// read(size_t) returns buffers that point directly into the mapping
+// instead of copying the data. Each of them keeps the mapping alive,
+// even after the mm_mmap_io_c object has been closed or destroyed.
+class mm_mmap_io_c: public mm_io_c {
+protected:
+  struct mapping_t;
+
+  std::string m_file_name;
+  std::shared_ptr<mapping_t> m_mapping;
+  unsigned char *m_mem{};
+  uint64_t m_size{}, m_pos{};
+  bool m_eof{};
+
+public:
+  mm_mmap_io_c(std::string const &path, access_e access = access_e::sequential);
+  virtual ~mm_mmap_io_c();
+
+  virtual uint64 getFilePointer();
+  virtual void setFilePointer(int64 offset, seek_mode mode = seek_beginning);
+  virtual memory_cptr read(size_t size);
+  using mm_io_c::read;
+  virtual int64_t get_size();
+  virtual bool eof();
+  virtual void clear_eof();
+  virtual void close();
+  virtual std::string get_file_name() const {
+    return m_file_name;
+  }
+
+  // Tells the kernel how the file will be read. Has no effect on
+  // systems that don't support it.
+  virtual void advise(access_e access);
+  // Asks the kernel to read the given range ahead of time.
+  virtual void advise_will_need(uint64_t pos, uint64_t size);
+
+  // Returns a buffer referring to 'size' bytes at 'pos' without
+  // copying them or changing the file pointer.
+  memory_cptr slice(uint64_t pos, uint64_t size) const;
+
+protected:
+  virtual uint32 _read(void *buffer, size_t size);
+  virtual size_t _write(const void *buffer, size_t size);
+
+  void map();
+  void unmap();
+};
+
+using mm_mmap_io_cptr = std::shared_ptr<mm_mmap_io_c>;
+
+#endif // MTX_COMMON_MM_MMAP_IO_H
@@ -0,0 +1,72 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   read cache with one window per cursor
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include "common/mm_io_x.h"
+#include "common/mm_multi_cursor_read_cache.h"
+
+mm_multi_cursor_read_cache_c::mm_multi_cursor_read_cache_c(mm_io_c &in,
+                                                           size_t num_cursors,
+                                                           size_t window_size)
+  : m_in(in)
+  , m_window_size{window_size}
+  , m_windows(num_cursors)
+  , m_debug{"read_cache|multi_cursor_read_cache"}
+{
+}
+
+mm_multi_cursor_read_cache_c::~mm_multi_cursor_read_cache_c() {
+  mxdebug_if(m_debug,
+             boost::format("multi cursor read cache: %1% cursors, %2% reads, %3% reads from the file for refilling windows, %4% direct reads\n")
+             % m_windows.size() % m_num_reads % m_num_file_reads % m_num_direct_reads);
+}
+
+void
+mm_multi_cursor_read_cache_c::fill_window(window_t &window,
+                                          uint64_t pos) {
+  if (!window.m_buffer)
+    window.m_buffer = memory_c::alloc(m_window_size);
+
+  m_in.setFilePointer(pos);
+
+  window.m_start = pos;
+  window.m_fill  = m_in.read(window.m_buffer->get_buffer(), m_window_size);
+
+  ++m_num_file_reads;
+}
+
+memory_cptr
+mm_multi_cursor_read_cache_c::read(unsigned int cursor,
+                                   uint64_t pos,
+                                   size_t size) {
+  ++m_num_reads;
+
+  // Requests as big as a whole window gain nothing from the cache.
+  if ((cursor >= m_windows.size()) || (size >= m_window_size)) {
+    ++m_num_direct_reads;
+    m_in.setFilePointer(pos);
+    return m_in.read(size);
+  }
+
+  auto &window = m_windows[cursor];
+
+  if (   (pos < window.m_start)
+      || ((pos + size) > (window.m_start + window.m_fill)))
+    fill_window(window, pos);
+
+  if ((pos + size) > (window.m_start + window.m_fill))
+    throw mtx::mm_io::end_of_file_x{};
+
+  return memory_c::clone(window.m_buffer->get_buffer() + (pos - window.m_start), size);
+}
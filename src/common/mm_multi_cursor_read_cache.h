@@ -0,0 +1,54 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   class definition for a read cache with one window per cursor
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_COMMON_MM_MULTI_CURSOR_READ_CACHE_H
+#define MTX_COMMON_MM_MULTI_CURSOR_READ_CACHE_H
+
+#include "common/common_pch.h"
+
+#include "common/mm_io.h"
+
+// Caches reads from several positions of the same file that are far
+// apart, e.g. the samples of the individual tracks of a badly
+// interleaved MP4 file. Each cursor (usually one per track) has a
+// window of its own, so sequential reads through a cursor only hit
+// the file when that cursor's window has been used up, no matter how
+// many reads through other cursors happened in between.
+class mm_multi_cursor_read_cache_c {
+protected:
+  struct window_t {
+    memory_cptr m_buffer;
+    uint64_t m_start{};
+    size_t m_fill{};
+  };
+
+  mm_io_c &m_in;
+  size_t m_window_size;
+  std::vector<window_t> m_windows;
+  uint64_t m_num_reads{}, m_num_file_reads{}, m_num_direct_reads{};
+  debugging_option_c m_debug;
+
+public:
+  mm_multi_cursor_read_cache_c(mm_io_c &in, size_t num_cursors, size_t window_size = 256 * 1024);
+  ~mm_multi_cursor_read_cache_c();
+
+  // Returns 'size' bytes from position 'pos' and leaves the file
+  // pointer of the underlying file in an unspecified state. Throws
+  // mtx::mm_io::end_of_file_x if fewer bytes are available.
+  memory_cptr read(unsigned int cursor, uint64_t pos, size_t size);
+
+protected:
+  void fill_window(window_t &window, uint64_t pos);
+};
+
+#endif // MTX_COMMON_MM_MULTI_CURSOR_READ_CACHE_H
@@ -0,0 +1,258 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   IO class reading ahead in a background thread
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include "common/mm_io_x.h"
+#include "common/mm_prefetch_io.h"
+
+mm_prefetch_io_c::mm_prefetch_io_c(mm_io_c *in,
+                                   size_t window_size,
+                                   size_t queue_depth,
+                                   bool delete_in)
+  : mm_proxy_io_c{in, delete_in}
+  , m_window_size{std::max<size_t>(window_size, 1)}
+  , m_queue_depth{std::max<size_t>(queue_depth, 1)}
+  , m_size(in->get_size())
+  , m_fetch_pos{in->getFilePointer()}
+  , m_debug{"prefetch|prefetch_io"}
+{
+  m_pos = m_fetch_pos;
+}
+
+mm_prefetch_io_c::mm_prefetch_io_c(mm_io_cptr const &in,
+                                   size_t window_size,
+                                   size_t queue_depth)
+  : mm_prefetch_io_c{in.get(), window_size, queue_depth, false}
+{
+  m_in_holder = in;
+}
+
+mm_prefetch_io_c::~mm_prefetch_io_c() {
+  close();
+}
+
+void
+mm_prefetch_io_c::close() {
+  if (!m_proxy_io)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_stop = true;
+  }
+
+  m_cond.notify_all();
+
+  if (m_thread.joinable())
+    m_thread.join();
+
+  mxdebug_if(m_debug,
+             boost::format("prefetch: %1%: %2% blocks read ahead, %3% restarts after seeking, %4% times waited for data\n")
+             % get_file_name() % m_num_blocks % m_num_restarts % m_num_waits);
+
+  m_queue.clear();
+  m_current = block_t{};
+
+  mm_proxy_io_c::close();
+  m_in_holder.reset();
+}
+
+void
+mm_prefetch_io_c::run() {
+  std::unique_lock<std::mutex> lock{m_mutex};
+
+  while (true) {
+    m_cond.wait(lock, [this]() { return m_stop || m_restart || (!m_fetch_eof && (m_queue.size() < m_queue_depth)); });
+
+    if (m_stop)
+      return;
+
+    if (m_restart) {
+      m_queue.clear();
+      m_fetch_pos = m_restart_pos;
+      m_fetch_eof = false;
+      m_restart   = false;
+      m_error     = nullptr;
+    }
+
+    auto pos   = m_fetch_pos;
+    auto block = block_t{ pos, memory_cptr{} };
+    auto error = std::exception_ptr{};
+
+    lock.unlock();
+
+    if (pos < m_size) {
+      try {
+        block.m_data  = memory_c::alloc(std::min<uint64_t>(m_window_size, m_size - pos));
+        m_proxy_io->setFilePointer(pos);
+        auto num_read = m_proxy_io->read(block.m_data->get_buffer(), block.m_data->get_size());
+        block.m_data->set_size(num_read);
+
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+
+    lock.lock();
+
+    // The consumer has sought somewhere else in the meantime.
+    if (m_restart)
+      continue;
+
+    if (error) {
+      m_error     = error;
+      m_fetch_eof = true;
+
+    } else if (!block.m_data || !block.m_data->get_size())
+      m_fetch_eof = true;
+
+    else {
+      m_fetch_pos += block.m_data->get_size();
+      m_fetch_eof  = m_fetch_pos >= m_size;
+      m_queue.push_back(block);
+    }
+
+    m_cond.notify_all();
+  }
+}
+
+void
+mm_prefetch_io_c::restart_at(uint64_t pos) {
+  m_queue.clear();
+  m_restart     = true;
+  m_restart_pos = pos;
+
+  ++m_num_restarts;
+
+  m_cond.notify_all();
+}
+
+bool
+mm_prefetch_io_c::fetch_block_for_current_pos() {
+  std::unique_lock<std::mutex> lock{m_mutex};
+
+  if (m_stop)
+    return false;
+
+  if (!m_thread.joinable())
+    m_thread = std::thread{[this]() { run(); }};
+
+  while (true) {
+    while (!m_queue.empty() && ((m_queue.front().m_pos + m_queue.front().m_data->get_size()) <= m_pos)) {
+      m_queue.pop_front();
+      m_cond.notify_all();
+    }
+
+    if (!m_queue.empty()) {
+      if (m_queue.front().m_pos <= m_pos) {
+        m_current = m_queue.front();
+        m_queue.pop_front();
+        m_cond.notify_all();
+
+        ++m_num_blocks;
+
+        return true;
+      }
+
+      // The position lies before the blocks read ahead.
+      restart_at(m_pos);
+      continue;
+    }
+
+    if (m_error && !m_restart) {
+      auto error = m_error;
+      m_error    = nullptr;
+      restart_at(m_pos);
+      std::rethrow_exception(error);
+    }
+
+    if (!m_restart && (m_fetch_pos != m_pos))
+      restart_at(m_pos);
+
+    else if (!m_restart && m_fetch_eof)
+      return false;
+
+    ++m_num_waits;
+    m_cond.wait(lock);
+  }
+}
+
+uint32
+mm_prefetch_io_c::_read(void *buffer,
+                        size_t size) {
+  auto dst      = static_cast<unsigned char *>(buffer);
+  auto num_read = size_t{};
+
+  while (num_read < size) {
+    auto have_current =    m_current.m_data
+                        && (m_current.m_pos <= m_pos)
+                        && (m_pos < (m_current.m_pos + m_current.m_data->get_size()));
+
+    if (!have_current && !fetch_block_for_current_pos())
+      break;
+
+    auto offset   = m_pos - m_current.m_pos;
+    auto num_copy = std::min<uint64_t>(size - num_read, m_current.m_data->get_size() - offset);
+
+    memcpy(dst + num_read, m_current.m_data->get_buffer() + offset, num_copy);
+
+    num_read += num_copy;
+    m_pos    += num_copy;
+  }
+
+  m_eof = num_read < size;
+
+  return num_read;
+}
+
+size_t
+mm_prefetch_io_c::_write(const void *,
+                         size_t) {
+  throw mtx::mm_io::wrong_read_write_access_x{};
+}
+
+uint64
+mm_prefetch_io_c::getFilePointer() {
+  return m_pos;
+}
+
+void
+mm_prefetch_io_c::setFilePointer(int64 offset,
+                                 seek_mode mode) {
+  int64_t new_pos
+    = seek_beginning == mode ? offset
+    : seek_end       == mode ? static_cast<int64_t>(m_size) + offset // offsets from the end are negative already
+    :                          static_cast<int64_t>(m_pos)  + offset;
+
+  if (0 > new_pos)
+    throw mtx::mm_io::seek_x{std::make_error_code(std::errc::invalid_argument)};
+
+  m_pos = new_pos;
+  m_eof = false;
+}
+
+int64_t
+mm_prefetch_io_c::get_size() {
+  return m_size;
+}
+
+bool
+mm_prefetch_io_c::eof() {
+  return m_eof;
+}
+
+void
+mm_prefetch_io_c::clear_eof() {
+  m_eof = false;
+}
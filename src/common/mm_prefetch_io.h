@@ -0,0 +1,87 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   class definition for an IO class reading ahead in a background thread
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_COMMON_MM_PREFETCH_IO_H
+#define MTX_COMMON_MM_PREFETCH_IO_H
+
+#include "common/common_pch.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "common/mm_io.h"
+
+// Reads the underlying file in a background thread in blocks of
+// 'window_size' bytes and keeps up to 'queue_depth' of them ahead of
+// the current position. Reads are served from those blocks. Seeking
+// outside of the blocks already read makes the thread start over at
+// the new position.
+//
+// Once the thread has been started the underlying file must not be
+// accessed other than through this object. For an underlying
+// mm_multi_file_io_c the thread simply continues with the next file
+// when it reaches the end of the current one.
+class mm_prefetch_io_c: public mm_proxy_io_c {
+protected:
+  struct block_t {
+    uint64_t m_pos{};
+    memory_cptr m_data;
+  };
+
+  mm_io_cptr m_in_holder;
+  size_t m_window_size, m_queue_depth;
+  uint64_t m_size;
+
+  // Only used by the consumer.
+  uint64_t m_pos{};
+  block_t m_current;
+  bool m_eof{};
+
+  // Shared with the background thread and protected by m_mutex.
+  std::deque<block_t> m_queue;
+  uint64_t m_fetch_pos{}, m_restart_pos{};
+  bool m_fetch_eof{}, m_restart{}, m_stop{};
+  std::exception_ptr m_error;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::thread m_thread;
+
+  uint64_t m_num_blocks{}, m_num_restarts{}, m_num_waits{};
+  debugging_option_c m_debug;
+
+public:
+  mm_prefetch_io_c(mm_io_c *in, size_t window_size, size_t queue_depth, bool delete_in = true);
+  mm_prefetch_io_c(mm_io_cptr const &in, size_t window_size, size_t queue_depth);
+  virtual ~mm_prefetch_io_c();
+
+  virtual uint64 getFilePointer();
+  virtual void setFilePointer(int64 offset, seek_mode mode = seek_beginning);
+  virtual int64_t get_size();
+  virtual bool eof();
+  virtual void clear_eof();
+  // Stops and joins the background thread before closing the
+  // underlying file.
+  virtual void close();
+
+protected:
+  virtual uint32 _read(void *buffer, size_t size);
+  virtual size_t _write(const void *buffer, size_t size);
+
+  bool fetch_block_for_current_pos();
+  void restart_at(uint64_t pos);
+  void run();
+};
+
+#endif // MTX_COMMON_MM_PREFETCH_IO_H
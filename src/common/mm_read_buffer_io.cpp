@@ -28,14 +28,20 @@ mm_read_buffer_io_c::mm_read_buffer_io_c(mm_io_c *in,
   , m_fill(0)
   , m_offset(0)
   , m_size(buffer_size)
+  , m_min_size(std::min(buffer_size, std::max<size_t>(buffer_size / 8, 1 << 12)))
+  , m_max_size(buffer_size * 8)
   , m_buffering(true)
-  , m_debug_seek{"read_buffer_io|read_buffer_io_read"}
+  , m_debug_seek{"read_buffer_io|read_buffer_io_seek"}
   , m_debug_read{"read_buffer_io|read_buffer_io_read"}
 {
   setFilePointer(0, seek_beginning);
 }
 
 mm_read_buffer_io_c::~mm_read_buffer_io_c() {
+  mxdebug_if(m_debug_read,
+             boost::format("read buffer statistics: %1% hits, %2% misses, %3% direct reads, %4% seeks, %5% bytes read, %6% bytes used, final buffer size %7%\n")
+             % m_num_hits % m_num_misses % m_num_direct_reads % m_num_seeks % m_bytes_read % m_bytes_used % m_size);
+
   close();
 }
 
@@ -84,6 +90,8 @@ mm_read_buffer_io_c::setFilePointer(int64 offset,
     return;
   }
 
+  adapt_to_seek();
+
   int64_t previous_pos = m_proxy_io->getFilePointer();
 
   // Actual seeking
@@ -112,43 +120,79 @@ mm_read_buffer_io_c::_read(void *buffer,
 
   char *buf    = static_cast<char *>(buffer);
   uint32_t res = 0;
+  bool missed  = false;
 
   while (0 < size) {
-    // TODO Directly write full blocks into the output buffer when size > m_size
     size_t avail = std::min(size, m_fill - m_cursor);
     if (avail) {
       memcpy(buf, m_buffer + m_cursor, avail);
-      buf      += avail;
-      res      += avail;
-      size     -= avail;
-      m_cursor += avail;
-
-    } else {
-      // Refill the buffer
-      m_offset += m_cursor;
-      m_cursor  = 0;
-      m_fill    = 0;
-      avail     = std::min(get_size() - m_offset, static_cast<int64_t>(m_size));
-
-      if (!avail) {
-        // must keep track of eof, as m_proxy_io->eof() will never be reached
-        // because of the above eof calculation
+      buf            += avail;
+      res            += avail;
+      size           -= avail;
+      m_cursor       += avail;
+      m_used_in_fill += avail;
+      m_bytes_used   += avail;
+      continue;
+    }
+
+    // Refill the buffer
+    missed    = true;
+    m_offset += m_cursor;
+    m_cursor  = 0;
+    m_fill    = 0;
+
+    adapt_to_fill_position();
+
+    int64_t remaining = get_size() - m_offset;
+    if (0 >= remaining) {
+      // must keep track of eof, as m_proxy_io->eof() will never be reached
+      // because of the above eof calculation
+      m_eof = true;
+      break;
+    }
+
+    int64_t previous_pos = m_proxy_io->getFilePointer();
+
+    // Requests at least as big as the buffer would only be copied
+    // through it; read them into the caller's buffer directly.
+    if (size >= m_size) {
+      size_t wanted    = std::min<int64_t>(size, remaining);
+      size_t num_read  = m_proxy_io->read(buf, wanted);
+      buf             += num_read;
+      res             += num_read;
+      size            -= num_read;
+      m_offset        += num_read;
+      m_bytes_read    += num_read;
+      m_bytes_used    += num_read;
+      ++m_num_direct_reads;
+
+      m_previous_fill_end = m_offset;
+
+      mxdebug_if(m_debug_read, boost::format("direct read from position %3% for %1% returned %2%\n") % wanted % num_read % previous_pos);
+      if (num_read != wanted) {
         m_eof = true;
         break;
       }
 
-      int64_t previous_pos = m_proxy_io->getFilePointer();
+      continue;
+    }
 
-      m_fill = m_proxy_io->read(m_buffer, avail);
-      mxdebug_if(m_debug_read, boost::format("physical read from position %3% for %1% returned %2%\n") % avail % m_fill % previous_pos);
-      if (m_fill != avail) {
-        m_eof = true;
-        if (!m_fill)
-          break;
-      }
+    avail               = std::min<int64_t>(remaining, m_size);
+    m_fill              = m_proxy_io->read(m_buffer, avail);
+    m_used_in_fill      = 0;
+    m_bytes_read       += m_fill;
+    m_previous_fill_end = m_offset + m_fill;
+
+    mxdebug_if(m_debug_read, boost::format("physical read from position %3% for %1% returned %2%\n") % avail % m_fill % previous_pos);
+    if (m_fill != avail) {
+      m_eof = true;
+      if (!m_fill)
+        break;
     }
   }
 
+  ++(missed ? m_num_misses : m_num_hits);
+
   return res;
 }
 
@@ -168,3 +212,74 @@ mm_read_buffer_io_c::enable_buffering(bool enable) {
     m_fill   = 0;
   }
 }
+
+void
+mm_read_buffer_io_c::adapt_to_fill_position() {
+  // Called right before the buffer is refilled from m_offset. Reading
+  // on where the previous fill ended means the file is being scanned
+  // sequentially; the buffer grows after a couple of such fills.
+  if (m_offset == m_previous_fill_end) {
+    ++m_num_sequential_fills;
+    m_num_wasted_fills = 0;
+
+  } else
+    m_num_sequential_fills = 0;
+
+  if (m_num_sequential_fills < 2)
+    return;
+
+  if (m_size < m_max_size)
+    resize_buffer(std::min(m_size * 2, m_max_size));
+
+  set_access(access_e::sequential);
+
+  m_proxy_io->advise_will_need(m_offset + m_size, m_size);
+}
+
+void
+mm_read_buffer_io_c::adapt_to_seek() {
+  // Called when a seek leaves the buffer. If most of the buffered data
+  // hasn't been used, reading it was wasted; the buffer shrinks after
+  // a couple of such seeks.
+  ++m_num_seeks;
+
+  if (!m_fill)
+    return;
+
+  if (m_used_in_fill >= (m_fill / 2)) {
+    m_num_wasted_fills = 0;
+    return;
+  }
+
+  ++m_num_wasted_fills;
+  m_num_sequential_fills = 0;
+
+  if (m_num_wasted_fills < 2)
+    return;
+
+  if (m_size > m_min_size)
+    resize_buffer(std::max(m_size / 2, m_min_size));
+
+  set_access(access_e::random);
+}
+
+void
+mm_read_buffer_io_c::resize_buffer(size_t size) {
+  // Only called while the buffer is empty or about to be dropped.
+  mxdebug_if(m_debug_read, boost::format("buffer size changed from %1% to %2%\n") % m_size % size);
+
+  m_af_buffer = memory_c::alloc(size);
+  m_buffer    = m_af_buffer->get_buffer();
+  m_size      = size;
+}
+
+void
+mm_read_buffer_io_c::set_access(access_e access) {
+  if (m_access == access)
+    return;
+
+  mxdebug_if(m_debug_read, boost::format("access pattern changed to %1%\n") % (access_e::sequential == access ? "sequential" : access_e::random == access ? "random" : "normal"));
+
+  m_access = access;
+  m_proxy_io->advise(access);
+}
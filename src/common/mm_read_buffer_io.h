@@ -19,6 +19,10 @@
 
 #include "common/mm_io.h"
 
+// The buffer adapts its size to the way it is used. Long sequential
+// scans let it grow up to eight times the initial size, and seeks
+// that leave most of the buffered data unused shrink it again. The
+// operating system is told about the detected access pattern.
 class mm_read_buffer_io_c: public mm_proxy_io_c {
 protected:
   memory_cptr m_af_buffer;
@@ -27,8 +31,16 @@ protected:
   bool m_eof;
   size_t m_fill;
   int64_t m_offset;
-  const size_t m_size;
+  size_t m_size, m_min_size, m_max_size;
   bool m_buffering;
+
+  access_e m_access{access_e::normal};
+  int64_t m_previous_fill_end{-1};
+  size_t m_used_in_fill{};
+  unsigned int m_num_sequential_fills{}, m_num_wasted_fills{};
+
+  uint64_t m_num_hits{}, m_num_misses{}, m_num_direct_reads{}, m_num_seeks{}, m_bytes_read{}, m_bytes_used{};
+
   debugging_option_c m_debug_seek, m_debug_read;
 
 public:
@@ -42,9 +54,18 @@ public:
   virtual void clear_eof() { m_eof = false; }
   virtual void enable_buffering(bool enable);
 
+  size_t get_buffer_size() const {
+    return m_size;
+  }
+
 protected:
   virtual uint32 _read(void *buffer, size_t size);
   virtual size_t _write(const void *buffer, size_t size);
+
+  void adapt_to_fill_position();
+  void adapt_to_seek();
+  void resize_buffer(size_t size);
+  void set_access(access_e access);
 };
 
 using mm_read_buffer_io_cptr = std::shared_ptr<mm_read_buffer_io_c>;
@@ -0,0 +1,136 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   IO callback class implementation
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include "common/mm_io_x.h"
+#include "common/mm_stream_write_io.h"
+
+mm_stream_write_io_c::mm_stream_write_io_c(mm_io_c *out,
+                                           bool delete_out)
+  : mm_proxy_io_c(out, delete_out)
+  , m_pos{}
+  , m_committed{}
+  , m_holding{true}
+{
+}
+
+mm_stream_write_io_c::~mm_stream_write_io_c() {
+  close();
+}
+
+// "-" denotes the standard output.
+mm_io_cptr
+mm_stream_write_io_c::open(std::string const &file_name) {
+  auto out = file_name == "-" ? static_cast<mm_io_c *>(new mm_stdio_c) : new mm_file_io_c(file_name, MODE_CREATE);
+  return mm_io_cptr(new mm_stream_write_io_c(out));
+}
+
+uint64
+mm_stream_write_io_c::getFilePointer() {
+  return m_pos;
+}
+
+void
+mm_stream_write_io_c::setFilePointer(int64 offset,
+                                     seek_mode mode) {
+  int64_t new_pos
+    = seek_beginning == mode ? offset
+    : seek_end       == mode ? get_size()       + offset // offsets from the end are negative already
+    :                          getFilePointer() + offset;
+
+  if ((new_pos < static_cast<int64_t>(m_committed)) || (new_pos > get_size()))
+    throw mtx::mm_io::seek_x{};
+
+  m_pos = new_pos;
+}
+
+int64_t
+mm_stream_write_io_c::get_size() {
+  return m_committed + m_held.size();
+}
+
+bool
+mm_stream_write_io_c::eof() {
+  return static_cast<int64_t>(m_pos) >= get_size();
+}
+
+void
+mm_stream_write_io_c::flush() {
+  if (m_proxy_io)
+    m_proxy_io->flush();
+}
+
+void
+mm_stream_write_io_c::close() {
+  if (!m_proxy_io)
+    return;
+
+  commit();
+  flush();
+  mm_proxy_io_c::close();
+}
+
+void
+mm_stream_write_io_c::commit() {
+  m_holding = false;
+
+  if (m_held.empty())
+    return;
+
+  mm_proxy_io_c::_write(&m_held[0], m_held.size());
+
+  m_committed += m_held.size();
+  m_held.clear();
+  m_held.shrink_to_fit();
+}
+
+bool
+mm_stream_write_io_c::is_committed()
+  const {
+  return !m_holding;
+}
+
+uint32
+mm_stream_write_io_c::_read(void *buffer,
+                            size_t size) {
+  auto offset = m_pos - m_committed;
+  auto num    = std::min<size_t>(size, m_held.size() - offset);
+
+  if (num)
+    memcpy(buffer, &m_held[offset], num);
+  m_pos += num;
+
+  return num;
+}
+
+size_t
+mm_stream_write_io_c::_write(const void *buffer,
+                             size_t size) {
+  if (!m_holding) {
+    auto num_written  = mm_proxy_io_c::_write(buffer, size);
+    m_pos            += num_written;
+    m_committed      += num_written;
+
+    return num_written;
+  }
+
+  auto offset = m_pos - m_committed;
+  if ((offset + size) > m_held.size())
+    m_held.resize(offset + size);
+
+  memcpy(&m_held[offset], buffer, size);
+  m_pos += size;
+
+  return size;
+}
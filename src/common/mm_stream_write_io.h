@@ -0,0 +1,55 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   IO callback class definitions
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_COMMON_MM_STREAM_WRITE_IO_H
+#define MTX_COMMON_MM_STREAM_WRITE_IO_H
+
+#include "common/common_pch.h"
+
+#include "common/mm_io.h"
+
+// Writes to destinations that cannot seek such as pipes or the
+// standard output. Everything written before commit() is called is
+// kept in memory and may be read, overwritten and moved around
+// freely. Afterwards the data is passed through to the destination,
+// and seeking anywhere but to the current end results in an
+// mtx::mm_io::seek_x exception.
+class mm_stream_write_io_c: public mm_proxy_io_c {
+protected:
+  std::vector<unsigned char> m_held;
+  uint64_t m_pos, m_committed;
+  bool m_holding;
+
+public:
+  mm_stream_write_io_c(mm_io_c *out, bool delete_out = true);
+  virtual ~mm_stream_write_io_c();
+
+  virtual uint64 getFilePointer();
+  virtual void setFilePointer(int64 offset, seek_mode mode = seek_beginning);
+  virtual int64_t get_size();
+  virtual bool eof();
+  virtual void flush();
+  virtual void close();
+
+  virtual void commit();
+  virtual bool is_committed() const;
+
+  static mm_io_cptr open(std::string const &file_name);
+
+protected:
+  virtual uint32 _read(void *buffer, size_t size);
+  virtual size_t _write(const void *buffer, size_t size);
+};
+using mm_stream_write_io_cptr = std::shared_ptr<mm_stream_write_io_c>;
+
+#endif // MTX_COMMON_MM_STREAM_WRITE_IO_H
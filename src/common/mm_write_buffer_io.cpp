@@ -25,6 +25,8 @@ mm_write_buffer_io_c::mm_write_buffer_io_c(mm_io_c *out,
   , m_buffer(m_af_buffer->get_buffer())
   , m_fill(0)
   , m_size(buffer_size)
+  , m_referenced_size{}
+  , m_alignment{}
   , m_debug_seek{ "write_buffer_io|write_buffer_io_read"}
   , m_debug_write{"write_buffer_io|write_buffer_io_write"}
 {
@@ -42,7 +44,7 @@ mm_write_buffer_io_c::open(const std::string &file_name,
 
 uint64
 mm_write_buffer_io_c::getFilePointer() {
-  return mm_proxy_io_c::getFilePointer() + m_fill;
+  return mm_proxy_io_c::getFilePointer() + m_fill + m_referenced_size;
 }
 
 void
@@ -88,23 +90,29 @@ mm_write_buffer_io_c::_read(void *buffer,
 size_t
 mm_write_buffer_io_c::_write(const void *buffer,
                              size_t size) {
+  if (reference_instead_of_copying(buffer, size))
+    return size;
+
   size_t avail;
   const char *buf = static_cast<const char *>(buffer);
   size_t remain   = size;
 
   // whole blocks
   while (remain >= (avail = m_size - m_fill)) {
-    if (m_fill) {
+    if (m_fill || m_alignment) {
       // Fill the buffer in an attempt to defeat potentially
       // lousy OS I/O scheduling
       memcpy(m_buffer + m_fill, buf, avail);
       m_fill = m_size;
-      flush_buffer();
       remain -= avail;
       buf    += avail;
+      flush_full_buffer();
 
     } else {
-      // write whole blocks, skipping the buffer
+      // write whole blocks, skipping the buffer, but only after
+      // the buffers referenced so far
+      flush_buffer();
+
       avail = mm_proxy_io_c::_write(buf, m_size);
       if (avail != m_size)
         throw mtx::mm_io::insufficient_space_x();
@@ -126,14 +134,19 @@ mm_write_buffer_io_c::_write(const void *buffer,
 
 void
 mm_write_buffer_io_c::flush_buffer() {
-  if (!m_fill)
+  if (!m_fill && m_references.empty())
     return;
 
-  size_t written = mm_proxy_io_c::_write(m_buffer, m_fill);
-  size_t fill    = m_fill;
-  m_fill         = 0;
+  size_t fill    = m_fill + m_referenced_size;
+  size_t written = m_references.empty() ? mm_proxy_io_c::_write(m_buffer, m_fill)
+                 :                        m_proxy_io->write_vectored(make_io_vecs(m_buffer, m_fill, m_references));
+  auto num_refs  = m_references.size();
+
+  m_fill            = 0;
+  m_referenced_size = 0;
+  m_references.clear();
 
-  mxdebug_if(m_debug_write, boost::format("flush_buffer() at %1% for %2% written %3%\n") % (mm_proxy_io_c::getFilePointer() - written) % fill % written);
+  mxdebug_if(m_debug_write, boost::format("flush_buffer() at %1% for %2% (%4% referenced buffers) written %3%\n") % (mm_proxy_io_c::getFilePointer() - written) % fill % written % num_refs);
 
   if (written != fill)
     throw mtx::mm_io::insufficient_space_x();
@@ -141,5 +154,112 @@ mm_write_buffer_io_c::flush_buffer() {
 
 void
 mm_write_buffer_io_c::discard_buffer() {
-  m_fill = 0;
+  m_fill            = 0;
+  m_referenced_size = 0;
+  m_references.clear();
+}
+
+void
+mm_write_buffer_io_c::flush_full_buffer() {
+  // The part of the buffer following the last aligned file position
+  // is kept for the next write.
+  auto tail = m_alignment ? static_cast<size_t>(getFilePointer() % m_alignment) : 0;
+  if (!tail || (tail >= m_fill)) {
+    flush_buffer();
+    return;
+  }
+
+  auto kept  = memory_c::clone(m_buffer + m_fill - tail, tail);
+  m_fill    -= tail;
+
+  flush_buffer();
+
+  memcpy(m_buffer, kept->get_buffer(), tail);
+  m_fill = tail;
+}
+
+memory_cptr
+mm_write_buffer_io_c::allocate_buffer(size_t size)
+  const {
+  if (!m_alignment)
+    return memory_c::alloc(size);
+
+  auto buffer  = memory_c::alloc(size + m_alignment);
+  auto address = reinterpret_cast<uintptr_t>(buffer->get_buffer());
+  buffer->set_offset((m_alignment - address % m_alignment) % m_alignment);
+
+  return buffer;
+}
+
+bool
+mm_write_buffer_io_c::enable_direct_io() {
+  auto file = dynamic_cast<mm_file_io_c *>(m_proxy_io);
+  if (!file || (m_size % mm_file_io_c::s_direct_io_alignment) || !file->enable_direct_io())
+    return false;
+
+  flush_buffer();
+
+  m_alignment = mm_file_io_c::s_direct_io_alignment;
+  m_af_buffer = allocate_buffer(m_size);
+  m_buffer    = m_af_buffer->get_buffer();
+
+  m_referencable.clear();
+
+  return true;
+}
+
+void
+mm_write_buffer_io_c::add_referencable(memory_cptr const &data) {
+  if (!m_alignment && data && (data->get_size() >= s_min_reference_size))
+    m_referencable[data->get_buffer()] = data;
+}
+
+void
+mm_write_buffer_io_c::clear_referencable() {
+  m_referencable.clear();
+}
+
+bool
+mm_write_buffer_io_c::reference_instead_of_copying(void const *buffer,
+                                                   size_t size) {
+  if (m_referencable.empty() || (size < s_min_reference_size))
+    return false;
+
+  auto itr = m_referencable.find(static_cast<unsigned char const *>(buffer));
+  if ((itr == m_referencable.end()) || (itr->second->get_size() != size))
+    return false;
+
+  m_references.push_back(reference_t{ m_fill, itr->second });
+  m_referenced_size += size;
+  m_cached_size      = -1;
+
+  m_referencable.erase(itr);
+
+  if ((m_fill + m_referenced_size) >= m_size)
+    flush_buffer();
+
+  return true;
+}
+
+std::vector<mm_io_c::io_vec_t>
+mm_write_buffer_io_c::make_io_vecs(unsigned char const *buffer,
+                                   size_t fill,
+                                   std::vector<reference_t> const &references) {
+  std::vector<io_vec_t> vecs;
+  vecs.reserve(references.size() * 2 + 1);
+
+  auto position = size_t{};
+
+  for (auto const &reference : references) {
+    if (reference.m_buffer_position > position)
+      vecs.push_back(io_vec_t{ buffer + position, reference.m_buffer_position - position });
+
+    vecs.push_back(io_vec_t{ reference.m_data->get_buffer(), reference.m_data->get_size() });
+    position = reference.m_buffer_position;
+  }
+
+  if (fill > position)
+    vecs.push_back(io_vec_t{ buffer + position, fill - position });
+
+  return vecs;
 }
@@ -19,14 +19,29 @@
 
 #include "common/mm_io.h"
 
+// Buffers registered with add_referencable() aren't copied when they
+// are written as a whole. Only a reference is kept, and the buffered
+// data and the referenced buffers are written with a single vectored
+// write once the buffer is flushed. The referenced buffers must not be
+// modified until then.
 class mm_write_buffer_io_c: public mm_proxy_io_c {
 protected:
+  struct reference_t {
+    size_t m_buffer_position;
+    memory_cptr m_data;
+  };
+
   memory_cptr m_af_buffer;
   unsigned char *m_buffer;
   size_t m_fill;
   const size_t m_size;
+  std::unordered_map<unsigned char const *, memory_cptr> m_referencable;
+  std::vector<reference_t> m_references;
+  size_t m_referenced_size, m_alignment;
   debugging_option_c m_debug_seek, m_debug_write;
 
+  static size_t const s_min_reference_size = 8 * 1024;
+
 public:
   mm_write_buffer_io_c(mm_io_c *out, size_t buffer_size, bool delete_out = true);
   virtual ~mm_write_buffer_io_c();
@@ -37,12 +52,25 @@ public:
   virtual void close();
   virtual void discard_buffer();
 
+  void add_referencable(memory_cptr const &data);
+  void clear_referencable();
+
+  // Lets the file write the buffered data bypassing the page cache.
+  // Full buffers are then only written up to the last suitably
+  // aligned file position, and nothing is referenced anymore.
+  virtual bool enable_direct_io();
+
   static mm_io_cptr open(const std::string &file_name, size_t buffer_size);
 
 protected:
   virtual uint32 _read(void *buffer, size_t size);
   virtual size_t _write(const void *buffer, size_t size);
   virtual void flush_buffer();
+  void flush_full_buffer();
+  memory_cptr allocate_buffer(size_t size) const;
+
+  bool reference_instead_of_copying(void const *buffer, size_t size);
+  static std::vector<io_vec_t> make_io_vecs(unsigned char const *buffer, size_t fill, std::vector<reference_t> const &references);
 };
 using mm_write_buffer_io_cptr = std::shared_ptr<mm_write_buffer_io_c>;
 
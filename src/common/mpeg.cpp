@@ -12,53 +12,227 @@
 
 #include "common/common_pch.h"
 
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define MTX_HAVE_AVX2_DISPATCH
+#endif
+
 #include "common/mpeg.h"
 
 namespace mpeg {
 
-memory_cptr
-nalu_to_rbsp(memory_cptr const &buffer) {
-  int pos, size = buffer->get_size();
-  mm_mem_io_c d(nullptr, size, 100);
-  unsigned char *b = buffer->get_buffer();
-
-  for (pos = 0; pos < size; ++pos) {
-    if (   ((pos + 2) < size)
-        && (0 == b[pos])
-        && (0 == b[pos + 1])
-        && (3 == b[pos + 2])) {
-      d.write_uint8(0);
-      d.write_uint8(0);
-      pos += 2;
-
-    } else
-      d.write_uint8(b[pos]);
+namespace {
+
+unsigned int
+count_trailing_zeros(uint32_t value) {
+#if defined(__GNUC__)
+  return __builtin_ctz(value);
+#else
+  auto count = 0u;
+  for (; !(value & 1); value >>= 1)
+    ++count;
+  return count;
+#endif
+}
+
+// All of the searches below look for two zero bytes followed by a
+// byte in the range [lowest, highest]: 00 00 01 is a start code,
+// 00 00 03 an emulation prevention sequence, and 00 00 00..03 must be
+// escaped.
+
+size_t
+find_prefix_scalar(unsigned char const *buffer,
+                   size_t size,
+                   size_t pos,
+                   unsigned char lowest,
+                   unsigned char highest) {
+  while ((pos + 2) < size) {
+    // The third byte decides how far to move on: a prefix can only
+    // begin at one of the next two positions if it is 0.
+    auto third = buffer[pos + 2];
+
+    if (!buffer[pos] && !buffer[pos + 1] && (third >= lowest) && (third <= highest))
+      return pos;
+
+    pos += third ? 3 : 1;
+  }
+
+  return size;
+}
+
+#if defined(__SSE2__)
+size_t
+find_prefix_sse2(unsigned char const *buffer,
+                 size_t size,
+                 unsigned char lowest,
+                 unsigned char highest) {
+  auto const zero   = _mm_setzero_si128();
+  auto const offset = _mm_set1_epi8(lowest);
+  auto const range  = _mm_set1_epi8(highest - lowest);
+  auto pos          = size_t{};
+
+  // Compares 16 candidate positions at once; the loads for the second
+  // and third bytes must not exceed the buffer. The third byte is in
+  // range if subtracting 'lowest' leaves a value no bigger than the
+  // range's width (unsigned comparison via the minimum).
+  while ((pos + 18) <= size) {
+    auto first    = _mm_loadu_si128(reinterpret_cast<__m128i const *>(buffer + pos));
+    auto second   = _mm_loadu_si128(reinterpret_cast<__m128i const *>(buffer + pos + 1));
+    auto third    = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const *>(buffer + pos + 2)), offset);
+    auto in_range = _mm_cmpeq_epi8(_mm_min_epu8(third, range), third);
+    auto found    = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(first, zero), _mm_cmpeq_epi8(second, zero)), in_range);
+    auto mask     = static_cast<uint32_t>(_mm_movemask_epi8(found));
+
+    if (mask)
+      return pos + count_trailing_zeros(mask);
+
+    pos += 16;
   }
 
-  return std::make_shared<memory_c>(d.get_and_lock_buffer(), d.getFilePointer(), true);
+  return find_prefix_scalar(buffer, size, pos, lowest, highest);
+}
+#endif
+
+#if defined(MTX_HAVE_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+size_t
+find_prefix_avx2(unsigned char const *buffer,
+                 size_t size,
+                 unsigned char lowest,
+                 unsigned char highest) {
+  auto const zero   = _mm256_setzero_si256();
+  auto const offset = _mm256_set1_epi8(lowest);
+  auto const range  = _mm256_set1_epi8(highest - lowest);
+  auto pos          = size_t{};
+
+  while ((pos + 34) <= size) {
+    auto first    = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(buffer + pos));
+    auto second   = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(buffer + pos + 1));
+    auto third    = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(buffer + pos + 2)), offset);
+    auto in_range = _mm256_cmpeq_epi8(_mm256_min_epu8(third, range), third);
+    auto found    = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(first, zero), _mm256_cmpeq_epi8(second, zero)), in_range);
+    auto mask     = static_cast<uint32_t>(_mm256_movemask_epi8(found));
+
+    if (mask)
+      return pos + count_trailing_zeros(mask);
+
+    pos += 32;
+  }
+
+  return find_prefix_scalar(buffer, size, pos, lowest, highest);
+}
+#endif
+
+size_t
+find_prefix(unsigned char const *buffer,
+            size_t size,
+            unsigned char lowest,
+            unsigned char highest) {
+#if defined(MTX_HAVE_AVX2_DISPATCH)
+  static auto const s_have_avx2 = !!__builtin_cpu_supports("avx2");
+
+  if (s_have_avx2)
+    return find_prefix_avx2(buffer, size, lowest, highest);
+#endif
+
+#if defined(__SSE2__)
+  return find_prefix_sse2(buffer, size, lowest, highest);
+#else
+  return find_prefix_scalar(buffer, size, 0, lowest, highest);
+#endif
+}
+
+}
+
+size_t
+nalu_to_rbsp(unsigned char const *src,
+             size_t src_size,
+             unsigned char *dst,
+             size_t max_dst_size) {
+  auto src_pos = size_t{};
+  auto dst_pos = size_t{};
+
+  while ((src_pos < src_size) && (dst_pos < max_dst_size)) {
+    // An emulation prevention sequence only matters if it starts
+    // within the part that is still going to be copied.
+    auto remaining = max_dst_size - dst_pos;
+    auto window    = std::min(src_size - src_pos, remaining);
+    window         = std::min(src_size - src_pos, window + 2);
+    auto pos       = find_prefix(src + src_pos, window, 3, 3);
+
+    if (pos >= window) {
+      auto num_bytes = std::min(window, remaining);
+      memcpy(dst + dst_pos, src + src_pos, num_bytes);
+      dst_pos += num_bytes;
+      break;
+    }
+
+    // Keep the two zero bytes, drop the 03.
+    auto num_bytes = std::min(pos + 2, remaining);
+    memcpy(dst + dst_pos, src + src_pos, num_bytes);
+    dst_pos += num_bytes;
+    src_pos += pos + 3;
+  }
+
+  return dst_pos;
+}
+
+size_t
+rbsp_to_nalu(unsigned char const *src,
+             size_t src_size,
+             unsigned char *dst) {
+  auto src_pos = size_t{};
+  auto dst_pos = size_t{};
+
+  while (src_pos < src_size) {
+    auto pos = find_prefix(src + src_pos, src_size - src_pos, 0, 3);
+
+    if (pos >= (src_size - src_pos)) {
+      memcpy(dst + dst_pos, src + src_pos, src_size - src_pos);
+      dst_pos += src_size - src_pos;
+      break;
+    }
+
+    // Insert 03 after the two zero bytes. The byte following them is
+    // examined again as it may start another sequence.
+    memcpy(dst + dst_pos, src + src_pos, pos + 2);
+    dst_pos      += pos + 2;
+    dst[dst_pos]  = 3;
+    ++dst_pos;
+    src_pos      += pos + 2;
+  }
+
+  return dst_pos;
+}
+
+memory_cptr
+nalu_to_rbsp(memory_cptr const &buffer,
+             size_t max_size) {
+  auto size = buffer->get_size();
+  auto rbsp = memory_c::alloc(std::min(size, max_size));
+
+  rbsp->set_size(nalu_to_rbsp(buffer->get_buffer(), size, rbsp->get_buffer(), rbsp->get_size()));
+
+  return rbsp;
 }
 
 memory_cptr
 rbsp_to_nalu(memory_cptr const &buffer) {
-  int pos, size = buffer->get_size();
-  mm_mem_io_c d(nullptr, size, 100);
-  unsigned char *b = buffer->get_buffer();
-
-  for (pos = 0; pos < size; ++pos) {
-    if (   ((pos + 2) < size)
-        && (0 == b[pos])
-        && (0 == b[pos + 1])
-        && (3 >= b[pos + 2])) {
-      d.write_uint8(0);
-      d.write_uint8(0);
-      d.write_uint8(3);
-      ++pos;
-
-    } else
-      d.write_uint8(b[pos]);
-  }
+  auto size = buffer->get_size();
+  auto nalu = memory_c::alloc(size + size / 2);
+
+  nalu->set_size(rbsp_to_nalu(buffer->get_buffer(), size, nalu->get_buffer()));
+
+  return nalu;
+}
 
-  return std::make_shared<memory_c>(d.get_and_lock_buffer(), d.getFilePointer(), true);
+size_t
+find_start_code(unsigned char const *buffer,
+                size_t size) {
+  return find_prefix(buffer, size, 1, 1);
 }
 
 }
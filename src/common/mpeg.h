@@ -17,8 +17,22 @@
 
 namespace mpeg {
 
-memory_cptr nalu_to_rbsp(memory_cptr const &buffer);
+// Remove the emulation prevention bytes (the 03 in 00 00 03) from a
+// NALU. Only the first 'max_size' bytes of the result are produced;
+// callers that only parse the beginning of a NALU (e.g. a slice
+// header) can save unescaping the rest.
+memory_cptr nalu_to_rbsp(memory_cptr const &buffer, size_t max_size = std::numeric_limits<size_t>::max());
+size_t nalu_to_rbsp(unsigned char const *src, size_t src_size, unsigned char *dst, size_t max_dst_size);
+
+// Insert emulation prevention bytes into a RBSP. 'dst' must have room
+// for at least 'src_size + src_size / 2' bytes.
 memory_cptr rbsp_to_nalu(memory_cptr const &buffer);
+size_t rbsp_to_nalu(unsigned char const *src, size_t src_size, unsigned char *dst);
+
+// Returns the offset of the first start code prefix (00 00 01) in
+// the buffer or 'size' if there is none. Uses SSE2 or AVX2 if the CPU
+// supports them.
+size_t find_start_code(unsigned char const *buffer, size_t size);
 
 }
 
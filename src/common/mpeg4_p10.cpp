@@ -33,6 +33,11 @@ namespace p10 {
 static auto s_debug_fix_bistream_timing_info = debugging_option_c{"fix_bitstream_timing_info"};
 static auto s_debug_remove_bistream_ar_info  = debugging_option_c{"remove_bitstream_ar_info"};
 
+// parse_slice() only reads the first few fields of a slice header.
+// They fit into this many bytes, so the rest of the slice doesn't
+// have to be unescaped.
+static size_t const s_max_slice_header_size = 256;
+
 avcc_c::avcc_c()
   : m_profile_idc{}
   , m_profile_compat{}
@@ -968,63 +973,73 @@ mpeg4::p10::avc_es_parser_c::remove_trailing_zero_bytes(memory_c &memory) {
 void
 mpeg4::p10::avc_es_parser_c::add_bytes(unsigned char *buffer,
                                        size_t size) {
-  memory_slice_cursor_c cursor;
-  int marker_size              = 0;
-  int previous_marker_size     = 0;
-  int previous_pos             = -1;
-  uint64_t previous_parsed_pos = m_parsed_position;
-
-  if (m_unparsed_buffer && (0 != m_unparsed_buffer->get_size()))
-    cursor.add_slice(m_unparsed_buffer);
-  cursor.add_slice(buffer, size);
-
-  if (3 <= cursor.get_remaining_size()) {
-    uint32_t marker =                               1 << 24
-                    | (unsigned int)cursor.get_char() << 16
-                    | (unsigned int)cursor.get_char() <<  8
-                    | (unsigned int)cursor.get_char();
+  // The unparsed data begins with the last start code found (if any).
+  // The new data is appended to it. NALUs are handed out as slices of
+  // that buffer, so it can only be grown in place as long as none of
+  // them refers to it.
+  auto previous_size       = m_unparsed_buffer ? m_unparsed_buffer->get_size() : 0;
+  auto previous_parsed_pos = m_parsed_position;
 
-    while (1) {
-      if (NALU_START_CODE == marker)
-        marker_size = 4;
-      else if (NALU_START_CODE == (marker & 0x00ffffff))
-        marker_size = 3;
-
-      if (0 != marker_size) {
-        if (-1 != previous_pos) {
-          int new_size = cursor.get_position() - marker_size - previous_pos - previous_marker_size;
-          memory_cptr nalu(new memory_c(safemalloc(new_size), new_size, true));
-          cursor.copy(nalu->get_buffer(), previous_pos + previous_marker_size, new_size);
-          m_parsed_position = previous_parsed_pos + previous_pos;
-          remove_trailing_zero_bytes(*nalu);
-          handle_nalu(nalu);
-        }
-        previous_pos         = cursor.get_position() - marker_size;
-        previous_marker_size = marker_size;
-        marker_size          = 0;
-      }
+  if (!previous_size)
+    m_unparsed_buffer = memory_c::clone(buffer, size);
 
-      if (!cursor.char_available())
-        break;
+  else if ((1 == m_unparsed_buffer.use_count()) && m_unparsed_buffer->is_free())
+    m_unparsed_buffer->add(buffer, size);
 
-      marker <<= 8;
-      marker  |= (unsigned int)cursor.get_char();
-    }
+  else {
+    auto combined = memory_c::alloc(previous_size + size);
+    memcpy(combined->get_buffer(),                 m_unparsed_buffer->get_buffer(), previous_size);
+    memcpy(combined->get_buffer() + previous_size, buffer,                          size);
+    m_unparsed_buffer = combined;
+  }
+
+  auto data                 = m_unparsed_buffer->get_buffer();
+  auto total_size           = m_unparsed_buffer->get_size();
+  auto have_start_code      = false;
+  auto previous_pos         = size_t{};
+  auto previous_marker_size = size_t{};
+
+  if ((4 <= previous_size) && (NALU_START_CODE == get_uint32_be(data))) {
+    have_start_code      = true;
+    previous_marker_size = 4;
+
+  } else if ((3 <= previous_size) && (NALU_START_CODE == get_uint24_be(data))) {
+    have_start_code      = true;
+    previous_marker_size = 3;
   }
 
-  if (-1 == previous_pos)
-    previous_pos = 0;
+  // Everything before the last two bytes of the previous data has
+  // been searched already.
+  auto scan_pos = std::max<size_t>(previous_size, 2) - 2;
+  scan_pos      = std::max(scan_pos, previous_marker_size);
+
+  while (scan_pos < total_size) {
+    auto pos = scan_pos + mpeg::find_start_code(data + scan_pos, total_size - scan_pos);
+    if (pos >= total_size)
+      break;
+
+    // A zero byte in front of the prefix makes it a four-byte start code.
+    auto marker_size = (pos > previous_pos) && !data[pos - 1] ? 4u : 3u;
+    auto marker_pos  = pos + 3 - marker_size;
+
+    if (have_start_code) {
+      auto nalu         = memory_c::slice(m_unparsed_buffer, previous_pos + previous_marker_size, marker_pos - previous_pos - previous_marker_size);
+      m_parsed_position = previous_parsed_pos + previous_pos;
+      remove_trailing_zero_bytes(*nalu);
+      handle_nalu(nalu);
+    }
+
+    have_start_code      = true;
+    previous_pos         = marker_pos;
+    previous_marker_size = marker_size;
+    scan_pos             = pos + 3;
+  }
 
   m_stream_position += size;
   m_parsed_position  = previous_parsed_pos + previous_pos;
 
-  int new_size = cursor.get_size() - previous_pos;
-  if (0 != new_size) {
-    m_unparsed_buffer = memory_cptr(new memory_c(safemalloc(new_size), new_size, true));
-    cursor.copy(m_unparsed_buffer->get_buffer(), previous_pos, new_size);
-
-  } else
-    m_unparsed_buffer.reset();
+  if (previous_pos)
+    m_unparsed_buffer = memory_c::clone(data + previous_pos, total_size - previous_pos);
 }
 
 void
@@ -1139,7 +1154,7 @@ mpeg4::p10::avc_es_parser_c::handle_slice_nalu(memory_cptr const &nalu) {
   }
 
   slice_info_t si;
-  if (!parse_slice(mpeg::nalu_to_rbsp(nalu), si))
+  if (!parse_slice(mpeg::nalu_to_rbsp(nalu, s_max_slice_header_size), si))
     return;
 
   if (m_have_incomplete_frame && flush_decision(si, m_incomplete_frame.m_si))
@@ -13,6 +13,7 @@
 
 #include "common/common_pch.h"
 
+#include <mutex>
 #include <sstream>
 
 #include "common/command_line.h"
@@ -34,7 +35,13 @@ charset_converter_cptr g_cc_stdio = charset_converter_cptr(new charset_converter
 std::shared_ptr<mm_io_c> g_mm_stdio   = std::shared_ptr<mm_io_c>(new mm_stdio_c);
 
 static mxmsg_handler_t s_mxmsg_info_handler, s_mxmsg_warning_handler, s_mxmsg_error_handler;
-static std::vector<std::string> s_warnings_emitted, s_errors_emitted;
+
+// During batch identification several files are identified by worker
+// threads at the same time. Each thread collects the warnings and
+// errors for the file it is currently working on.
+static thread_local std::vector<std::string> s_warnings_emitted, s_errors_emitted;
+static thread_local boost::optional<std::string> s_json_batch_file_name;
+static bool s_json_output_as_lines = false;
 
 static nlohmann::json
 to_json_array(std::vector<std::string> const &messages) {
@@ -46,12 +53,45 @@ to_json_array(std::vector<std::string> const &messages) {
   return result;
 }
 
-void
-display_json_output(nlohmann::json json) {
+nlohmann::json
+complete_json_output(nlohmann::json json) {
+  if (s_json_batch_file_name && (json.find("file_name") == json.end()))
+    json["file_name"] = *s_json_batch_file_name;
+
   json["warnings"] = to_json_array(s_warnings_emitted);
   json["errors"]   = to_json_array(s_errors_emitted);
 
-  mxinfo(boost::format("%1%\n") % mtx::json::dump(json, 2));
+  return json;
+}
+
+void
+display_completed_json_output(nlohmann::json const &json) {
+  mxinfo(boost::format("%1%\n") % mtx::json::dump(json, s_json_output_as_lines ? -1 : 2));
+}
+
+void
+display_json_output(nlohmann::json json) {
+  display_completed_json_output(complete_json_output(json));
+}
+
+void
+exit_after_json_output(int code) {
+  if (s_json_batch_file_name)
+    throw mtx::output::json_output_done_x{};
+
+  mxexit(code);
+}
+
+void
+output_json_as_lines() {
+  s_json_output_as_lines = true;
+}
+
+void
+start_json_batch_item(std::string const &file_name) {
+  s_warnings_emitted.clear();
+  s_errors_emitted.clear();
+  s_json_batch_file_name = file_name;
 }
 
 static void
@@ -63,7 +103,7 @@ json_warning_error_handler(unsigned int level,
   else {
     s_errors_emitted.push_back(message);
     display_json_output(nlohmann::json{});
-    mxexit(2);
+    exit_after_json_output(2);
   }
 }
 
@@ -102,10 +142,14 @@ void
 mxmsg(unsigned int level,
       std::string message) {
   static bool s_saw_cr_after_nl = false;
+  static std::mutex s_mutex;
 
   if (g_suppress_info && (MXMSG_INFO == level))
     return;
 
+  // Packetizers may emit messages from mkvmerge's reader threads.
+  std::lock_guard<std::mutex> lock{s_mutex};
+
   if ('\n' == message[0]) {
     message.erase(0, 1);
     g_mm_stdio->puts("\n");
@@ -37,8 +37,34 @@ extern std::shared_ptr<mm_io_c> g_mm_stdio;
 void redirect_stdio(const mm_io_cptr &new_stdio);
 bool stdio_redirected();
 
+namespace mtx { namespace output {
+
+// Thrown by exit_after_json_output() during batch identification.
+class json_output_done_x: public exception {
+public:
+  virtual const char *what() const throw() {
+    return "the JSON output for the current file is complete";
+  }
+};
+
+}}
+
 void redirect_warnings_and_errors_to_json();
 void display_json_output(nlohmann::json json);
+// Adds the warnings and errors emitted so far to 'json' like
+// display_json_output() does, e.g. for storing the complete output.
+nlohmann::json complete_json_output(nlohmann::json json);
+void display_completed_json_output(nlohmann::json const &json);
+
+// Ends the program after the JSON output has been written. During batch
+// identification only the identification of the current thread's file is
+// ended by throwing mtx::output::json_output_done_x.
+void exit_after_json_output(int code);
+
+// Batch identification: output each JSON object on a single line, and
+// collect warnings and errors per thread and per file.
+void output_json_as_lines();
+void start_json_batch_item(std::string const &file_name);
 
 void init_common_output(bool no_charset_detection);
 void set_cc_stdio(const std::string &charset);
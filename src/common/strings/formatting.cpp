@@ -24,8 +24,8 @@
 std::string
 format_timestamp(int64_t timestamp,
                 unsigned int precision) {
-  static boost::format s_bf_format("%4%%|1$02d|:%|2$02d|:%|3$02d|");
-  static boost::format s_bf_decimals(".%|1$09d|");
+  static thread_local boost::format s_bf_format("%4%%|1$02d|:%|2$02d|:%|3$02d|");
+  static thread_local boost::format s_bf_decimals(".%|1$09d|");
 
   bool negative = 0 > timestamp;
   if (negative)
@@ -127,7 +127,7 @@ to_string(int64_t numerator,
   if (0 == fractional_part)
     return output;
 
-  static boost::format s_bf_precision_format_format(".%%0%1%d");
+  static thread_local boost::format s_bf_precision_format_format(".%%0%1%d");
 
   std::string format         = (s_bf_precision_format_format % precision).str();
   output                    += (boost::format(format) % fractional_part).str();
@@ -287,8 +287,8 @@ std::string
 to_hex(const unsigned char *buf,
        size_t size,
        bool compact) {
-  static boost::format s_bf_to_hex("0x%|1$02x|");
-  static boost::format s_bf_to_hex_compact("%|1$02x|");
+  static thread_local boost::format s_bf_to_hex("0x%|1$02x|");
+  static thread_local boost::format s_bf_to_hex_compact("%|1$02x|");
 
   std::string hex;
   for (size_t idx = 0; idx < size; ++idx)
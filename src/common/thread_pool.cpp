@@ -0,0 +1,77 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   a simple pool of worker threads
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include "common/thread_pool.h"
+
+thread_pool_c::thread_pool_c(size_t num_threads) {
+  for (auto idx = 0u; idx < std::max<size_t>(num_threads, 1); ++idx)
+    m_threads.emplace_back([this]() { run(); });
+}
+
+thread_pool_c::~thread_pool_c() {
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_stop = true;
+  }
+  m_cond.notify_all();
+
+  for (auto &thread : m_threads)
+    thread.join();
+}
+
+std::future<void>
+thread_pool_c::submit(std::function<void()> const &job) {
+  auto task   = std::make_shared<std::packaged_task<void()>>(job);
+  auto result = task->get_future();
+
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_jobs.push_back([task]() { (*task)(); });
+  }
+  m_cond.notify_one();
+
+  return result;
+}
+
+void
+thread_pool_c::run() {
+  // A job calling mxerror() must not end the program while the thread
+  // that submitted it is still running. The error reaches that thread
+  // through the job's future instead.
+  mxexit_throws_on_this_thread(true);
+
+  while (true) {
+    std::function<void()> job;
+
+    {
+      std::unique_lock<std::mutex> lock{m_mutex};
+      m_cond.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+
+      if (m_jobs.empty())
+        return;
+
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+
+    job();
+  }
+}
+
+thread_pool_c &
+thread_pool_c::get() {
+  static auto s_pool = new thread_pool_c{std::thread::hardware_concurrency()};
+  return *s_pool;
+}
@@ -0,0 +1,55 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   class definition for a simple pool of worker threads
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_COMMON_THREAD_POOL_H
+#define MTX_COMMON_THREAD_POOL_H
+
+#include "common/common_pch.h"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+// Runs jobs on a fixed number of worker threads in the order they were
+// submitted. Exceptions thrown by a job are stored in the future
+// returned by submit() and re-thrown by its get().
+class thread_pool_c {
+protected:
+  std::vector<std::thread> m_threads;
+  std::deque<std::function<void()>> m_jobs;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  bool m_stop{};
+
+public:
+  explicit thread_pool_c(size_t num_threads);
+  ~thread_pool_c();
+
+  std::future<void> submit(std::function<void()> const &job);
+
+  size_t get_num_threads() const {
+    return m_threads.size();
+  }
+
+protected:
+  void run();
+
+public:
+  // The global pool with one thread per CPU core. It is never
+  // destroyed so that mxerror() may end the program from any thread.
+  static thread_pool_c &get();
+};
+
+#endif  // MTX_COMMON_THREAD_POOL_H
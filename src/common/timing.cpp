@@ -0,0 +1,138 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   per-stage timing instrumentation
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include <array>
+#include <mutex>
+
+#include "common/json.h"
+#include "common/mm_io.h"
+#include "common/mm_io_x.h"
+#include "common/timing.h"
+
+namespace mtx { namespace timing {
+
+bool g_enabled = false;
+
+thread_local scope_c *scope_c::ms_current = nullptr;
+
+namespace {
+
+std::array<counter_t, static_cast<size_t>(stage_e::max)> s_stage_counters;
+std::map<std::pair<stage_e, std::string>, counter_t> s_named_counters;
+std::mutex s_named_counters_mutex;
+
+char const *
+stage_name(stage_e stage) {
+  return stage_e::reader_read        == stage ? "reader_read"
+       : stage_e::packetizer_process == stage ? "packetizer_process"
+       : stage_e::cluster_render     == stage ? "cluster_render"
+       : stage_e::cues               == stage ? "cues"
+       : stage_e::io_read            == stage ? "io_read"
+       : stage_e::io_write           == stage ? "io_write"
+       : stage_e::io_seek            == stage ? "io_seek"
+       :                                        "unknown";
+}
+
+struct totals_t {
+  uint64_t m_calls{}, m_total_ns{}, m_self_ns{}, m_bytes{};
+
+  void
+  add(counter_t const &counter) {
+    m_calls    += counter.m_calls;
+    m_total_ns += counter.m_total_ns;
+    m_self_ns  += counter.m_self_ns;
+    m_bytes    += counter.m_bytes;
+  }
+
+  void
+  fill(nlohmann::json &json)
+    const {
+    json["calls"]    = m_calls;
+    json["total_ns"] = m_total_ns;
+    json["self_ns"]  = m_self_ns;
+    json["bytes"]    = m_bytes;
+  }
+};
+
+}
+
+void
+enable() {
+  g_enabled = true;
+}
+
+counter_t &
+get_counter(stage_e stage,
+            std::string const &name) {
+  if (name.empty())
+    return s_stage_counters[static_cast<size_t>(stage)];
+
+  std::lock_guard<std::mutex> lock{s_named_counters_mutex};
+  return s_named_counters[{ stage, name }];
+}
+
+void
+scope_c::finish() {
+  auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+
+  ++m_counter->m_calls;
+  m_counter->m_total_ns += elapsed;
+  m_counter->m_self_ns  += elapsed - std::min(elapsed, m_children_ns);
+
+  if (m_parent)
+    m_parent->m_children_ns += elapsed;
+
+  ms_current = m_parent;
+}
+
+/** \brief Writes the accumulated counters as a JSON object
+
+   The object contains one member per stage with that stage's
+   totals. Stages that are broken down further, e.g. by the format of
+   the reader, contain the individual counters in 'by_name'.
+*/
+void
+write_report(std::string const &file_name) {
+  std::vector<totals_t> stage_totals(s_stage_counters.size());
+  auto report = nlohmann::json::object();
+
+  for (auto idx = 0u; idx < s_stage_counters.size(); ++idx)
+    stage_totals[idx].add(s_stage_counters[idx]);
+
+  {
+    std::lock_guard<std::mutex> lock{s_named_counters_mutex};
+
+    for (auto const &pair : s_named_counters) {
+      auto totals = totals_t{};
+      totals.add(pair.second);
+
+      stage_totals[static_cast<size_t>(pair.first.first)].add(pair.second);
+      totals.fill(report[stage_name(pair.first.first)]["by_name"][pair.first.second]);
+    }
+  }
+
+  for (auto idx = 0u; idx < s_stage_counters.size(); ++idx)
+    stage_totals[idx].fill(report[stage_name(static_cast<stage_e>(idx))]);
+
+  try {
+    mm_file_io_c out{file_name, MODE_CREATE};
+    out.write(mtx::json::dump(report, 2) + "\n");
+
+  } catch (mtx::mm_io::exception &ex) {
+    mxwarn(boost::format(Y("The file '%1%' could not be opened for writing: %2%.\n")) % file_name % ex);
+  }
+}
+
+}}
@@ -0,0 +1,109 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   definitions for the per-stage timing instrumentation
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_COMMON_TIMING_H
+#define MTX_COMMON_TIMING_H
+
+#include "common/common_pch.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace mtx { namespace timing {
+
+enum class stage_e {
+  reader_read,
+  packetizer_process,
+  cluster_render,
+  cues,
+  io_read,
+  io_write,
+  io_seek,
+  max,
+};
+
+struct counter_t {
+  std::atomic<uint64_t> m_calls{}, m_total_ns{}, m_self_ns{}, m_bytes{};
+};
+
+extern bool g_enabled;
+
+void enable();
+counter_t &get_counter(stage_e stage, std::string const &name = std::string{});
+void write_report(std::string const &file_name);
+
+// Measures the time spent between its construction and destruction
+// and adds it to a counter. Time spent in nested scopes on the same
+// thread is excluded from the counter's self time. Does nothing at
+// all if no counter is given, which is what happens if timing hasn't
+// been enabled.
+class scope_c {
+protected:
+  counter_t *m_counter;
+  scope_c *m_parent{};
+  std::chrono::steady_clock::time_point m_start;
+  uint64_t m_children_ns{};
+
+  static thread_local scope_c *ms_current;
+
+public:
+  explicit scope_c(counter_t *counter)
+    : m_counter{counter}
+  {
+    if (!m_counter)
+      return;
+
+    m_parent   = ms_current;
+    ms_current = this;
+    m_start    = std::chrono::steady_clock::now();
+  }
+
+  ~scope_c() {
+    if (m_counter)
+      finish();
+  }
+
+  void
+  add_bytes(uint64_t num_bytes) {
+    if (m_counter)
+      m_counter->m_bytes += num_bytes;
+  }
+
+protected:
+  void finish();
+};
+
+// Returns the counter for a stage, or nullptr if timing is disabled.
+inline counter_t *
+counter_for(stage_e stage) {
+  return g_enabled ? &get_counter(stage) : nullptr;
+}
+
+// Same as above for counters that are further broken down by name,
+// e.g. by the format of a reader. The counter is looked up only once
+// and cached in 'cache'.
+template<typename T>
+counter_t *
+counter_for(stage_e stage,
+            counter_t *&cache,
+            T const &get_name) {
+  if (!g_enabled)
+    return nullptr;
+  if (!cache)
+    cache = &get_counter(stage, get_name());
+  return cache;
+}
+
+}}
+
+#endif // MTX_COMMON_TIMING_H
@@ -38,6 +38,9 @@ public:
   virtual file_status_e read(generic_packetizer_c *ptzr, bool force = false);
   virtual void identify();
   virtual void create_packetizer(int64_t id);
+  virtual int64_t get_duration() const {
+    return 0 < m_ac3header.m_bit_rate ? std::llround(m_size * 8000000000.0 / m_ac3header.m_bit_rate) : -1;
+  }
   virtual bool is_providing_timecodes() const {
     return false;
   }
@@ -798,6 +798,15 @@ avi_reader_c::get_progress() {
   return 0 == m_bytes_to_process ? 0 : 100 * m_bytes_processed / m_bytes_to_process;
 }
 
+int64_t
+avi_reader_c::get_duration()
+  const {
+  if (!m_max_video_frames || (0 >= m_fps))
+    return -1;
+
+  return std::llround(m_max_video_frames * 1000000000.0 / m_fps);
+}
+
 void
 avi_reader_c::extended_identify_mpeg4_l2(mtx::id::info_c &info) {
   int size = AVI_frame_size(m_avi, 0);
@@ -57,6 +57,9 @@ public:
   virtual file_status_e read(generic_packetizer_c *ptzr, bool force = false);
   virtual void identify();
   virtual void create_packetizer(int64_t id);
+  virtual int64_t get_duration() const {
+    return metadata_parsed && stream_info.total_samples && sample_rate ? std::llround(stream_info.total_samples * 1000000000.0 / sample_rate) : -1;
+  }
   virtual bool is_providing_timecodes() const {
     return false;
   }
@@ -221,6 +221,9 @@ public:
   virtual file_status_e read(generic_packetizer_c *ptzr, bool force = false);
 
   virtual int get_progress();
+  virtual int64_t get_duration() const {
+    return 0 != m_segment_duration ? m_segment_duration : -1;
+  }
   virtual void set_headers();
   virtual void identify();
   virtual void create_packetizers();
@@ -38,6 +38,10 @@ public:
   virtual file_status_e read(generic_packetizer_c *ptzr, bool force = false);
   virtual void identify();
   virtual void create_packetizer(int64_t tid);
+  // Only exact for files with a constant bitrate.
+  virtual int64_t get_duration() const {
+    return 0 < m_mp3header.bitrate ? m_size * 8000000ll / m_mp3header.bitrate : -1;
+  }
   virtual bool is_providing_timecodes() const {
     return false;
   }
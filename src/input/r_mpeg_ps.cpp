@@ -20,6 +20,7 @@
 #include "common/error.h"
 #include "common/id_info.h"
 #include "common/math.h"
+#include "common/mm_prefetch_io.h"
 #include "common/mp3.h"
 #include "common/mpeg1_2.h"
 #include "common/mpeg4_p2.h"
@@ -27,6 +28,7 @@
 #include "common/truehd.h"
 #include "input/r_mpeg_ps.h"
 #include "merge/file_status.h"
+#include "merge/output_control.h"
 #include "mpegparser/M2VParser.h"
 #include "output/p_ac3.h"
 #include "output/p_avc.h"
@@ -79,6 +81,9 @@ mpeg_ps_reader_c::read_headers() {
     if (!m_ti.m_disable_multi_file && boost::regex_search(bfs::path{m_ti.m_fname}.filename().string(), boost::regex{"^vts_\\d+_\\d+", boost::regex::icase | boost::regex::perl})) {
       m_in.reset();               // Close the source file first before opening it a second time.
       m_in = mm_multi_file_io_c::open_multi(m_ti.m_fname, false);
+
+      if (g_prefetch_window_size && !g_identifying)
+        m_in = std::make_shared<mm_prefetch_io_c>(m_in, g_prefetch_window_size, g_prefetch_queue_depth);
     }
 
     m_size          = m_in->get_size();
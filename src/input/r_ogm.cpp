@@ -812,7 +812,7 @@ ogm_reader_c::handle_stream_comments() {
     bool segment_title_set = false;
     if (title != "") {
       title = cch->utf8(title);
-      if (!g_segment_title_set && g_segment_title.empty() && dmx->ms_compat) {
+      if (!g_identifying && !g_segment_title_set && g_segment_title.empty() && dmx->ms_compat) {
         g_segment_title     = title;
         g_segment_title_set = true;
         segment_title_set   = true;
@@ -1309,7 +1309,7 @@ ogm_v_mscomp_demuxer_c::initialize() {
   stream_header *sth = (stream_header *)(packet_data[0]->get_buffer() + 1);
   codec              = codec_c::look_up(get_codec());
 
-  if (0 > g_video_fps)
+  if (!g_identifying && (0 > g_video_fps))
     g_video_fps = 10000000.0 / (float)get_uint64_le(&sth->time_unit);
 
   default_duration = 100 * get_uint64_le(&sth->time_unit);
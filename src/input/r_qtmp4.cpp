@@ -30,6 +30,7 @@
 #include "common/id_info.h"
 #include "common/iso639.h"
 #include "common/math.h"
+#include "common/mm_mmap_io.h"
 #include "common/mp3.h"
 #include "common/strings/formatting.h"
 #include "common/strings/parsing.h"
@@ -55,6 +56,7 @@
 using namespace libmatroska;
 
 #define MAX_INTERLEAVING_BADNESS 0.4
+#define MAX_COALESCED_READ_SIZE  (1024 * 1024)
 
 static std::string
 space(int num) {
@@ -139,6 +141,7 @@ qtmp4_reader_c::qtmp4_reader_c(const track_info_c &ti,
   , m_debug_tables{            "qtmp4_full|qtmp4_tables"}
   , m_debug_interleaving{"qtmp4|qtmp4_full|qtmp4_interleaving"}
   , m_debug_resync{      "qtmp4|qtmp4_full|qtmp4_resync"}
+  , m_debug_read{              "qtmp4_full|qtmp4_read"}
 {
 }
 
@@ -1448,7 +1451,7 @@ qtmp4_reader_c::read(generic_packetizer_c *ptzr,
     if ((-1 == dmx->ptzr) || (PTZR(dmx->ptzr) != ptzr))
       continue;
 
-    if (dmx->pos < dmx->m_index.size())
+    if (dmx->pos < dmx->get_num_index_entries())
       break;
   }
 
@@ -1456,42 +1459,106 @@ qtmp4_reader_c::read(generic_packetizer_c *ptzr,
     return flush_packetizers();
 
   qtmp4_demuxer_cptr &dmx = m_demuxers[dmx_idx];
-  qt_index_t &index       = dmx->m_index[dmx->pos];
+  auto index              = dmx->get_index_entry(dmx->pos);
 
-  m_in->setFilePointer(index.file_pos);
-
-  int buffer_offset = 0;
   memory_cptr buffer;
+  auto ok = true;
 
   if (   dmx->is_video()
       && !dmx->pos
       && dmx->codec.is(codec_c::type_e::V_MPEG4_P2)
       && dmx->esds_parsed
       && (dmx->esds.decoder_config)) {
-    buffer        = memory_c::alloc(index.size + dmx->esds.decoder_config->get_size());
-    buffer_offset = dmx->esds.decoder_config->get_size();
+    auto buffer_offset = dmx->esds.decoder_config->get_size();
+    buffer             = memory_c::alloc(index.size + buffer_offset);
 
-    memcpy(buffer->get_buffer(), dmx->esds.decoder_config->get_buffer(), dmx->esds.decoder_config->get_size());
+    m_in->setFilePointer(index.file_pos);
+    memcpy(buffer->get_buffer(), dmx->esds.decoder_config->get_buffer(), buffer_offset);
+    ok = m_in->read(buffer->get_buffer() + buffer_offset, index.size) == index.size;
 
   } else {
-    buffer = memory_c::alloc(index.size);
+    try {
+      buffer = read_index_entry(*dmx, index, dmx_idx);
+    } catch (mtx::mm_io::end_of_file_x &) {
+      ok = false;
+    }
   }
 
-  if (m_in->read(buffer->get_buffer() + buffer_offset, index.size) != index.size) {
+  if (!ok) {
     mxwarn(boost::format(Y("Quicktime/MP4 reader: Could not read chunk number %1%/%2% with size %3% from position %4%. Aborting.\n"))
-           % dmx->pos % dmx->m_index.size() % index.size % index.file_pos);
+           % dmx->pos % dmx->get_num_index_entries() % index.size % index.file_pos);
     return flush_packetizers();
   }
 
   PTZR(dmx->ptzr)->process(new packet_t(buffer, index.timecode, index.duration, index.is_keyframe ? VFT_IFRAME : VFT_PFRAMEAUTOMATIC, VFT_NOBFRAME));
   ++dmx->pos;
 
-  if (dmx->pos < dmx->m_index.size())
+  if (dmx->pos < dmx->get_num_index_entries())
     return FILE_STATUS_MOREDATA;
 
   return flush_packetizers();
 }
 
+memory_cptr
+qtmp4_reader_c::read_from_file(unsigned int cursor,
+                               uint64_t pos,
+                               size_t size) {
+  if (m_read_cache)
+    return m_read_cache->read(cursor, pos, size);
+
+  // Reading the data as a whole lets memory-mapped files hand it out
+  // without copying it.
+  m_in->setFilePointer(pos);
+  return m_in->read(size);
+}
+
+// Reads the demuxer's current index entry. Consecutive entries that
+// are stored back to back in the file, e.g. all samples of a chunk,
+// are read with a single read and handed out as slices of that
+// buffer.
+memory_cptr
+qtmp4_reader_c::read_index_entry(qtmp4_demuxer_c &dmx,
+                                 qt_index_t const &index,
+                                 unsigned int cursor) {
+  auto run_end = dmx.m_read_run ? dmx.m_read_run_pos + static_cast<int64_t>(dmx.m_read_run->get_size()) : 0;
+
+  if (   !dmx.m_read_run
+      || (index.file_pos              < dmx.m_read_run_pos)
+      || ((index.file_pos + index.size) > run_end)) {
+    auto num_bytes   = index.size;
+    auto next_idx    = dmx.pos + 1;
+    auto num_entries = dmx.get_num_index_entries();
+
+    for (auto previous = index; next_idx < num_entries; ++next_idx) {
+      auto next = dmx.get_index_entry(next_idx);
+      if (   (next.file_pos != (previous.file_pos + previous.size))
+          || ((num_bytes + next.size) > MAX_COALESCED_READ_SIZE))
+        break;
+
+      num_bytes += next.size;
+      previous   = next;
+    }
+
+    dmx.m_read_run.reset();
+
+    try {
+      dmx.m_read_run = read_from_file(cursor, index.file_pos, num_bytes);
+
+    } catch (mtx::mm_io::end_of_file_x &) {
+      // Truncated file: the current entry might still be complete.
+      if (num_bytes == index.size)
+        throw;
+      dmx.m_read_run = read_from_file(cursor, index.file_pos, index.size);
+    }
+
+    dmx.m_read_run_pos = index.file_pos;
+
+    mxdebug_if(m_debug_read, boost::format("read: track %1% entries %2%-%3% at %4% with %5% bytes in one go\n") % dmx.id % dmx.pos % (next_idx - 1) % index.file_pos % num_bytes);
+  }
+
+  return memory_c::slice(dmx.m_read_run, index.file_pos - dmx.m_read_run_pos, index.size);
+}
+
 memory_cptr
 qtmp4_reader_c::create_bitmap_info_header(qtmp4_demuxer_cptr &dmx,
                                           const char *fourcc,
@@ -1813,6 +1880,18 @@ qtmp4_reader_c::get_progress() {
   return 100 * dmx->pos / max_chunks;
 }
 
+int64_t
+qtmp4_reader_c::get_duration()
+  const {
+  auto duration = static_cast<int64_t>(-1);
+
+  for (auto const &dmx : m_demuxers)
+    if (dmx->global_duration && dmx->time_scale)
+      duration = std::max<int64_t>(duration, std::llround(dmx->global_duration * 1000000000.0 / dmx->time_scale));
+
+  return duration;
+}
+
 void
 qtmp4_reader_c::identify() {
   unsigned int i;
@@ -1928,8 +2007,17 @@ qtmp4_reader_c::detect_interleaving() {
   double badness = *boost::max_element(gradients) - *boost::min_element(gradients);
   mxdebug_if(m_debug_interleaving, boost::format("Interleaving: Badness: %1% (%2%)\n") % badness % (MAX_INTERLEAVING_BADNESS < badness ? "badly interleaved" : "ok"));
 
-  if (MAX_INTERLEAVING_BADNESS < badness)
-    m_in->enable_buffering(false);
+  if (MAX_INTERLEAVING_BADNESS >= badness)
+    return;
+
+  // Memory-mapped files don't need any buffering.
+  if (dynamic_cast<mm_mmap_io_c *>(m_in.get()))
+    return;
+
+  // A single buffer would be refilled on nearly each read. Give each
+  // demuxer a window of its own instead.
+  m_in->enable_buffering(false);
+  m_read_cache = std::make_unique<mm_multi_cursor_read_cache_c>(*m_in, m_demuxers.size());
 }
 
 // ----------------------------------------------------------------------
@@ -1961,7 +2049,8 @@ qtmp4_demuxer_c::calculate_fps() {
 }
 
 int64_t
-qtmp4_demuxer_c::to_nsecs(int64_t value) {
+qtmp4_demuxer_c::to_nsecs(int64_t value)
+  const {
   int i;
 
   for (i = 1; i <= 100000000ll; i *= 10) {
@@ -1977,76 +2066,73 @@ qtmp4_demuxer_c::to_nsecs(int64_t value) {
 
 void
 qtmp4_demuxer_c::calculate_timecodes_constant_sample_size() {
-  auto frame = 0u;
-  for (auto &chunk : chunk_table) {
-    timecodes.push_back(to_nsecs(static_cast<uint64_t>(chunk.samples) * duration) + constant_editlist_offset_ns);
-    durations.push_back(to_nsecs(static_cast<uint64_t>(chunk.size)    * duration));
-    frame_indices.push_back(frame++);
-  }
+  m_num_index_entries = chunk_table.size();
 }
 
 void
 qtmp4_demuxer_c::calculate_timecodes_variable_sample_size() {
-  auto const num_edits         = editlist_table.size();
-  auto const num_frame_offsets = frame_offset_table.size();
-  bool is_avc                  = codec.is(codec_c::type_e::V_MPEG4_P10);
-  bool is_hevc                 = codec.is(codec_c::type_e::V_MPEGH_P2);
-  int64_t v_dts_offset         = (is_avc || is_hevc) && num_frame_offsets ? to_nsecs(frame_offset_table[0]) : 0;
-
-  std::vector<int64_t> timecodes_before_offsets;
-
-  for (unsigned int frame = 0, num_samples = sample_table.size(); num_samples > frame; ++frame) {
-    int64_t pts_offset = 0;
-    auto real_frame    = frame;
+  auto is_avc            = codec.is(codec_c::type_e::V_MPEG4_P10);
+  auto is_hevc           = codec.is(codec_c::type_e::V_MPEGH_P2);
+  m_use_frame_offsets    = is_avc || is_hevc;
+  m_v_dts_offset         = m_use_frame_offsets && !frame_offset_table.empty() ? to_nsecs(frame_offset_table[0]) : 0;
+  m_num_index_entries    = sample_table.size();
 
-    if (0 < num_edits) {
-      auto editlist_pos = 0u;
+  // Frames whose duration cannot be derived from the following
+  // frame's timecode get the average duration of all other frames.
+  int64_t total_duration = 0, num_good_frames = 0;
+  size_t real_frame;
 
-      while (((num_edits - 1) > editlist_pos) && (frame >= editlist_table[editlist_pos + 1].start_frame))
-        ++editlist_pos;
+  for (size_t frame = 0; m_num_index_entries > (frame + 1); ++frame) {
+    int64_t diff = get_timecode_before_offsets(frame + 1, real_frame) - get_timecode_before_offsets(frame, real_frame);
 
-      auto &edit = editlist_table[editlist_pos];
-      if ((edit.start_frame + edit.frames) > frame) {
-        // calc real frame index & assign pts_offset:
-        real_frame = real_frame - edit.start_frame + edit.start_sample;
-        pts_offset = edit.pts_offset;
-      }
+    if (0 < diff) {
+      ++num_good_frames;
+      total_duration += diff;
     }
+  }
 
-    int64_t timecode = to_nsecs(sample_table[real_frame].pts + pts_offset);
-
-    frame_indices.push_back(real_frame);
+  m_avg_duration = num_good_frames ? total_duration / num_good_frames : 0;
+}
 
-    timecodes_before_offsets.push_back(timecode);
+// Maps a frame number to the number of the sample to use via the
+// edit list and returns that sample's timecode without the
+// composition time offsets applied.
+int64_t
+qtmp4_demuxer_c::get_timecode_before_offsets(size_t frame,
+                                             size_t &real_frame)
+  const {
+  int64_t pts_offset = 0;
+  real_frame         = frame;
 
-    if ((is_avc || is_hevc) && (num_frame_offsets > real_frame))
-       timecode += to_nsecs(frame_offset_table[real_frame]) - v_dts_offset;
+  if (!editlist_table.empty()) {
+    auto edit_itr = std::upper_bound(editlist_table.begin() + 1, editlist_table.end(), frame, [](size_t value, qt_editlist_t const &edit) {
+      return static_cast<int64_t>(value) < edit.start_frame;
+    });
+    auto &edit    = *(edit_itr - 1);
 
-    timecodes.push_back(timecode + constant_editlist_offset_ns);
+    if ((edit.start_frame + edit.frames) > static_cast<int64_t>(frame)) {
+      // calc real frame index & assign pts_offset:
+      real_frame = real_frame - edit.start_frame + edit.start_sample;
+      pts_offset = edit.pts_offset;
+    }
   }
 
-  int64_t avg_duration = 0, num_good_frames = 0;
+  return to_nsecs(sample_table[real_frame].pts + pts_offset);
+}
 
-  for (unsigned int frame = 0, num_timecodes_before_offsets = timecodes_before_offsets.size(); num_timecodes_before_offsets > (frame + 1); ++frame) {
-    int64_t diff = timecodes_before_offsets[frame + 1] - timecodes_before_offsets[frame];
+int64_t
+qtmp4_demuxer_c::get_timecode(size_t idx)
+  const {
+  if (0 != sample_size)
+    return to_nsecs(static_cast<uint64_t>(chunk_table[idx].samples) * duration) + constant_editlist_offset_ns + m_timecode_adjustment;
 
-    if (0 >= diff)
-      durations.push_back(0);
-    else {
-      ++num_good_frames;
-      avg_duration += diff;
-      durations.push_back(diff);
-    }
-  }
+  size_t real_frame;
+  auto timecode = get_timecode_before_offsets(idx, real_frame);
 
-  durations.push_back(0);
+  if (m_use_frame_offsets && (frame_offset_table.size() > real_frame))
+     timecode += to_nsecs(frame_offset_table[real_frame]) - m_v_dts_offset;
 
-  if (num_good_frames) {
-    avg_duration /= num_good_frames;
-    for (auto &duration : durations)
-      if (!duration)
-        duration = avg_duration;
-  }
+  return timecode + constant_editlist_offset_ns + m_timecode_adjustment;
 }
 
 void
@@ -2066,17 +2152,20 @@ qtmp4_demuxer_c::calculate_timecodes() {
 
 void
 qtmp4_demuxer_c::adjust_timecodes(int64_t delta) {
-  for (auto &timecode : timecodes)
-    timecode += delta;
-
-  for (auto &index : m_index)
-    index.timecode += delta;
+  m_timecode_adjustment += delta;
 }
 
 int64_t
 qtmp4_demuxer_c::min_timecode()
   const {
-  return timecodes.empty() ? 0 : *brng::min_element(timecodes);
+  if (!m_num_index_entries)
+    return 0;
+
+  auto min = get_timecode(0);
+  for (size_t idx = 1; idx < m_num_index_entries; ++idx)
+    min = std::min(min, get_timecode(idx));
+
+  return min;
 }
 
 bool
@@ -2273,101 +2362,101 @@ void
 qtmp4_demuxer_c::build_index() {
   if (sample_size != 0)
     build_index_constant_sample_size_mode();
-  else
-    build_index_chunk_mode();
 
-  mark_open_gop_random_access_points_as_key_frames();
+  build_random_access_point_ranges();
 }
 
 void
 qtmp4_demuxer_c::build_index_constant_sample_size_mode() {
-  size_t keyframe_table_idx  = 0;
-  size_t keyframe_table_size = keyframe_table.size();
-
-  auto is_audio              = 'a' == type;
-  auto sound_stsd_atom       = reinterpret_cast<sound_v1_stsd_atom_t *>(is_audio && stsd ? stsd->get_buffer() : nullptr);
-  auto v0_sample_size        = sound_stsd_atom       ? get_uint16_be(&sound_stsd_atom->v0.sample_size)        : 0;
-  auto v0_audio_version      = sound_stsd_atom       ? get_uint16_be(&sound_stsd_atom->v0.version)            : 0;
-  auto v1_bytes_per_frame    = 1 == v0_audio_version ? get_uint32_be(&sound_stsd_atom->v1.bytes_per_frame)    : 0;
-  auto v1_samples_per_packet = 1 == v0_audio_version ? get_uint32_be(&sound_stsd_atom->v1.samples_per_packet) : 0;
+  auto sound_stsd_atom    = reinterpret_cast<sound_v1_stsd_atom_t *>(is_audio() && stsd ? stsd->get_buffer() : nullptr);
+  auto v0_audio_version   = sound_stsd_atom       ? get_uint16_be(&sound_stsd_atom->v0.version)            : 0;
+  m_v0_sample_size        = sound_stsd_atom       ? get_uint16_be(&sound_stsd_atom->v0.sample_size)        : 0;
+  m_v1_bytes_per_frame    = 1 == v0_audio_version ? get_uint32_be(&sound_stsd_atom->v1.bytes_per_frame)    : 0;
+  m_v1_samples_per_packet = 1 == v0_audio_version ? get_uint32_be(&sound_stsd_atom->v1.samples_per_packet) : 0;
+}
 
-  size_t frame_idx;
-  for (frame_idx = 0; frame_idx < chunk_table.size(); ++frame_idx) {
-    uint64_t frame_size;
+uint64_t
+qtmp4_demuxer_c::get_frame_size(size_t chunk_idx)
+  const {
+  uint64_t frame_size = chunk_table[chunk_idx].size;
 
-    if (1 != sample_size) {
-      frame_size = chunk_table[frame_idx].size * sample_size;
+  if (1 != sample_size)
+    return frame_size * sample_size;
 
-    } else {
-      frame_size = chunk_table[frame_idx].size;
-
-      if (is_audio) {
-        if ((0 != v1_bytes_per_frame) && (0 != v1_samples_per_packet)) {
-          frame_size *= v1_bytes_per_frame;
-          frame_size /= v1_samples_per_packet;
-        } else
-          frame_size  = frame_size * a_channels * v0_sample_size / 8;
-      }
-    }
+  if (!is_audio())
+    return frame_size;
 
-    bool is_keyframe = false;
-    if (keyframe_table.empty())
-      is_keyframe = true;
-    else if ((keyframe_table_idx < keyframe_table_size) && ((frame_idx + 1) == keyframe_table[keyframe_table_idx])) {
-      is_keyframe = true;
-      ++keyframe_table_idx;
-    }
+  if ((0 != m_v1_bytes_per_frame) && (0 != m_v1_samples_per_packet))
+    return frame_size * m_v1_bytes_per_frame / m_v1_samples_per_packet;
 
-    m_index.push_back(qt_index_t(chunk_table[frame_idx].pos, frame_size, timecodes[frame_idx], durations[frame_idx], is_keyframe));
-  }
+  return frame_size * a_channels * m_v0_sample_size / 8;
 }
 
 void
-qtmp4_demuxer_c::build_index_chunk_mode() {
-  size_t keyframe_table_idx  = 0;
-  size_t keyframe_table_size = keyframe_table.size();
+qtmp4_demuxer_c::build_random_access_point_ranges() {
+  // Samples indicated by the 'rap ' sample group are key frames, too.
+  m_random_access_point_ranges.clear();
 
-  size_t frame_idx;
-  for (frame_idx = 0; frame_idx < frame_indices.size(); ++frame_idx) {
-    int act_frame_idx = frame_indices[frame_idx];
-
-    bool is_keyframe  = false;
-    if (keyframe_table.empty())
-      is_keyframe = true;
-    else if ((keyframe_table_idx < keyframe_table_size) && ((frame_idx + 1) == keyframe_table[keyframe_table_idx])) {
-      is_keyframe = true;
-      ++keyframe_table_idx;
-    }
-
-    m_index.push_back(qt_index_t(sample_table[act_frame_idx].pos, sample_table[act_frame_idx].size, timecodes[frame_idx], durations[frame_idx], is_keyframe));
-  }
-}
-
-void
-qtmp4_demuxer_c::mark_open_gop_random_access_points_as_key_frames() {
-  // Mark samples indicated by the 'rap ' sample group to be key
-  // frames, too.
   auto table_itr = sample_to_group_tables.find(fourcc_c{"rap "}.value());
   if (table_itr == sample_to_group_tables.end())
     return;
 
-  auto const num_index_entries        = m_index.size();
   auto const num_random_access_points = random_access_point_table.size();
-  auto current_sample                 = 0u;
+  size_t current_sample               = 0;
 
   for (auto const &s2g : table_itr->second) {
     if (s2g.group_description_index && ((s2g.group_description_index - 1) < num_random_access_points)) {
-      for (auto end = std::min<size_t>(current_sample + s2g.sample_count, num_index_entries); current_sample < end; ++current_sample)
-        m_index[current_sample].is_keyframe = true;
+      auto end = std::min<size_t>(current_sample + s2g.sample_count, m_num_index_entries);
+      if (current_sample < end)
+        m_random_access_point_ranges.emplace_back(current_sample, end);
+      current_sample = end;
 
     } else
       current_sample += s2g.sample_count;
 
-    if (current_sample >= num_index_entries)
+    if (current_sample >= m_num_index_entries)
       return;
   }
 }
 
+bool
+qtmp4_demuxer_c::is_keyframe(size_t idx)
+  const {
+  if (keyframe_table.empty() || std::binary_search(keyframe_table.begin(), keyframe_table.end(), idx + 1))
+    return true;
+
+  auto range_itr = std::upper_bound(m_random_access_point_ranges.begin(), m_random_access_point_ranges.end(), idx, [](size_t value, std::pair<size_t, size_t> const &range) {
+    return value < range.first;
+  });
+
+  return (range_itr != m_random_access_point_ranges.begin()) && (idx < (range_itr - 1)->second);
+}
+
+size_t
+qtmp4_demuxer_c::get_num_index_entries()
+  const {
+  return m_timecodes_calculated ? m_num_index_entries : 0;
+}
+
+qt_index_t
+qtmp4_demuxer_c::get_index_entry(size_t idx)
+  const {
+  if (0 != sample_size)
+    return qt_index_t(chunk_table[idx].pos, get_frame_size(idx), get_timecode(idx), to_nsecs(static_cast<uint64_t>(chunk_table[idx].size) * duration), is_keyframe(idx));
+
+  size_t real_frame, next_real_frame;
+  auto timecode_before_offsets = get_timecode_before_offsets(idx, real_frame);
+  auto frame_duration          = m_avg_duration;
+
+  if ((idx + 1) < m_num_index_entries) {
+    auto diff = get_timecode_before_offsets(idx + 1, next_real_frame) - timecode_before_offsets;
+    if (0 < diff)
+      frame_duration = diff;
+  }
+
+  return qt_index_t(sample_table[real_frame].pos, sample_table[real_frame].size, get_timecode(idx), frame_duration, is_keyframe(idx));
+}
+
 memory_cptr
 qtmp4_demuxer_c::read_first_bytes(int num_bytes) {
   if (!update_tables())
@@ -2379,8 +2468,8 @@ qtmp4_demuxer_c::read_first_bytes(int num_bytes) {
   size_t buf_pos = 0;
   size_t idx_pos = 0;
 
-  while ((0 < num_bytes) && (idx_pos < m_index.size())) {
-    qt_index_t &index          = m_index[idx_pos];
+  while ((0 < num_bytes) && (idx_pos < get_num_index_entries())) {
+    auto index                 = get_index_entry(idx_pos);
     uint64_t num_bytes_to_read = std::min((int64_t)num_bytes, index.size);
 
     m_reader.m_in->setFilePointer(index.file_pos);
@@ -21,6 +21,7 @@
 #include "common/dts.h"
 #include "common/fourcc.h"
 #include "common/mm_io.h"
+#include "common/mm_multi_cursor_read_cache.h"
 #include "input/qtmp4_atoms.h"
 #include "merge/generic_reader.h"
 #include "output/p_pcm.h"
@@ -242,11 +243,21 @@ struct qtmp4_demuxer_c {
   std::vector<qt_random_access_point_t> random_access_point_table;
   std::unordered_map<uint32_t, std::vector<qt_sample_to_group_t> > sample_to_group_tables;
 
-  std::vector<int64_t> timecodes, durations, frame_indices;
-
-  std::vector<qt_index_t> m_index;
   std::vector<qt_fragment_t> m_fragments;
 
+  // The index entries (one per chunk in constant sample size mode, one
+  // per frame otherwise) aren't stored. They're computed from the
+  // tables above when needed; see get_index_entry().
+  size_t m_num_index_entries{};
+  int64_t m_timecode_adjustment{}, m_avg_duration{}, m_v_dts_offset{};
+  bool m_use_frame_offsets{};
+  uint64_t m_v0_sample_size{}, m_v1_bytes_per_frame{}, m_v1_samples_per_packet{};
+  std::vector<std::pair<size_t, size_t> > m_random_access_point_ranges;
+
+  // Data of consecutive index entries read in one go
+  memory_cptr m_read_run;
+  int64_t m_read_run_pos{};
+
   double fps;
 
   esds_t esds;
@@ -313,7 +324,7 @@ struct qtmp4_demuxer_c {
   }
 
   void calculate_fps();
-  int64_t to_nsecs(int64_t value);
+  int64_t to_nsecs(int64_t value) const;
   void calculate_timecodes();
   void adjust_timecodes(int64_t delta);
 
@@ -321,6 +332,8 @@ struct qtmp4_demuxer_c {
   void update_editlist_table();
 
   void build_index();
+  size_t get_num_index_entries() const;
+  qt_index_t get_index_entry(size_t idx) const;
 
   memory_cptr read_first_bytes(int num_bytes);
 
@@ -362,13 +375,17 @@ struct qtmp4_demuxer_c {
   void determine_codec();
 
 private:
-  void build_index_chunk_mode();
   void build_index_constant_sample_size_mode();
-  void mark_open_gop_random_access_points_as_key_frames();
+  void build_random_access_point_ranges();
 
   void calculate_timecodes_constant_sample_size();
   void calculate_timecodes_variable_sample_size();
 
+  int64_t get_timecode(size_t idx) const;
+  int64_t get_timecode_before_offsets(size_t frame, size_t &real_frame) const;
+  uint64_t get_frame_size(size_t chunk_idx) const;
+  bool is_keyframe(size_t idx) const;
+
   bool parse_esds_atom(mm_mem_io_c &memio, int level);
   uint32_t read_esds_descr_len(mm_mem_io_c &memio);
 };
@@ -444,7 +461,9 @@ private:
 
   bool m_timecodes_calculated;
 
-  debugging_option_c m_debug_chapters, m_debug_headers, m_debug_tables, m_debug_interleaving, m_debug_resync;
+  std::unique_ptr<mm_multi_cursor_read_cache_c> m_read_cache;
+
+  debugging_option_c m_debug_chapters, m_debug_headers, m_debug_tables, m_debug_interleaving, m_debug_resync, m_debug_read;
 
   friend class qtmp4_demuxer_c;
 
@@ -459,6 +478,7 @@ public:
   virtual void read_headers();
   virtual file_status_e read(generic_packetizer_c *ptzr, bool force = false);
   virtual int get_progress();
+  virtual int64_t get_duration() const;
   virtual void identify();
   virtual void create_packetizers();
   virtual void create_packetizer(int64_t tid);
@@ -512,6 +532,8 @@ protected:
   virtual void handle_elst_atom(qtmp4_demuxer_cptr &new_dmx, qt_atom_t parent, int level);
   virtual void handle_tref_atom(qtmp4_demuxer_cptr &new_dmx, qt_atom_t parent, int level);
 
+  virtual memory_cptr read_index_entry(qtmp4_demuxer_c &dmx, qt_index_t const &index, unsigned int cursor);
+  virtual memory_cptr read_from_file(unsigned int cursor, uint64_t pos, size_t size);
   virtual memory_cptr create_bitmap_info_header(qtmp4_demuxer_cptr &dmx, const char *fourcc, size_t extra_size = 0, const void *extra_data = nullptr);
 
   virtual void create_audio_packetizer_aac(qtmp4_demuxer_cptr &dmx);
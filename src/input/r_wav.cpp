@@ -663,6 +663,16 @@ wav_reader_c::find_chunk(const char *id,
   return -1;
 }
 
+int64_t
+wav_reader_c::get_duration()
+  const {
+  auto bytes_per_second = get_uint32_le(&m_wheader.common.dwAvgBytesPerSec);
+  if (!bytes_per_second || !m_bytes_in_data_chunks)
+    return -1;
+
+  return std::llround(m_bytes_in_data_chunks * 1000000000.0 / bytes_per_second);
+}
+
 void
 wav_reader_c::identify() {
   if (!m_demuxer) {
@@ -79,6 +79,7 @@ public:
   virtual file_status_e read(generic_packetizer_c *ptzr, bool force = false);
   virtual void identify();
   virtual void create_packetizer(int64_t tid);
+  virtual int64_t get_duration() const;
   virtual bool is_providing_timecodes() const {
     return false;
   }
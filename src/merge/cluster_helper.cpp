@@ -17,8 +17,11 @@
 #include "common/ebml.h"
 #include "common/hacks.h"
 #include "common/math.h"
+#include "common/mm_stream_write_io.h"
+#include "common/mm_write_buffer_io.h"
 #include "common/strings/formatting.h"
 #include "common/tags/tags.h"
+#include "common/timing.h"
 #include "common/translation.h"
 #include "merge/cluster_helper.h"
 #include "merge/cues.h"
@@ -26,6 +29,7 @@
 #include "merge/output_control.h"
 #include "merge/packet_extensions.h"
 #include "merge/private/cluster_helper.h"
+#include "merge/reader_thread.h"
 #include "output/p_video.h"
 
 #include <matroska/KaxBlock.h>
@@ -370,6 +374,11 @@ cluster_helper_c::must_duration_be_set(render_groups_c *rg,
 
 int
 cluster_helper_c::render() {
+  // Rendering queries the packetizers' state; keep reader threads from
+  // modifying it in the meantime.
+  reader_thread_c::pause_c pause;
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::cluster_render)};
+
   std::vector<render_groups_cptr> render_groups;
   KaxCues cues;
   cues.SetGlobalTimecodeScale(g_timecode_scale);
@@ -384,6 +393,10 @@ cluster_helper_c::render() {
   int elements_in_cluster = 0;
   bool added_to_cues      = false;
 
+  // Let the write buffer reference the frames' data instead of
+  // copying it. It keeps the data alive until it has been written.
+  auto write_buffer       = dynamic_cast<mm_write_buffer_io_c *>(m->out);
+
   // Splitpoint stuff
   if ((-1 == m->header_overhead) && splitting())
     m->header_overhead = m->out->getFilePointer() + g_tags_size;
@@ -427,6 +440,9 @@ cluster_helper_c::render() {
 
     DataBuffer *data_buffer                = new DataBuffer((binary *)pack->data->get_buffer(), pack->data->get_size());
 
+    if (write_buffer)
+      write_buffer->add_referencable(pack->data);
+
     KaxTrackEntry &track_entry             = static_cast<KaxTrackEntry &>(*source->get_track_entry());
 
     kax_block_blob_c *previous_block_group = !render_group->m_groups.empty() ? render_group->m_groups.back().get() : nullptr;
@@ -541,6 +557,12 @@ cluster_helper_c::render() {
       m->cluster->set_min_timecode(min_cl_timecode - timecode_offset);
       m->cluster->set_max_timecode(max_cl_timecode - timecode_offset);
 
+      // Once the first cluster goes out to a live stream the headers
+      // written so far are final.
+      auto stream_out = dynamic_cast<mm_stream_write_io_c *>(m->out);
+      if (stream_out)
+        stream_out->commit();
+
       m->cluster->Render(*m->out, cues);
       m->bytes_in_file += m->cluster->ElementSize();
 
@@ -555,6 +577,9 @@ cluster_helper_c::render() {
       m->previous_cluster_tc = -1;
   }
 
+  if (write_buffer)
+    write_buffer->clear_referencable();
+
   m->min_timecode_in_cluster = -1;
   m->max_timecode_in_cluster = -1;
 
@@ -650,6 +675,22 @@ cluster_helper_c::add_split_point(const split_point_c &split_point) {
     ++m->current_split_point;
 }
 
+int64_t
+cluster_helper_c::get_expected_file_size()
+  const {
+  // Files split by size end shortly after the split point. Without
+  // splitting the whole content of all source files may end up in
+  // the file. For other kinds of splitting there's no estimate.
+  if (!splitting())
+    return g_file_sizes;
+
+  if (   (m->current_split_point != m->split_points.end())
+      && (split_point_c::size     == m->current_split_point->m_type))
+    return m->current_split_point->m_point;
+
+  return -1;
+}
+
 bool
 cluster_helper_c::split_mode_produces_many_files()
   const {
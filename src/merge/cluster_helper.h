@@ -67,6 +67,7 @@ public:
   void dump_split_points() const;
   bool splitting() const;
   bool split_mode_produces_many_files() const;
+  int64_t get_expected_file_size() const;
 
   bool discarding() const;
 
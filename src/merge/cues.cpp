@@ -13,11 +13,14 @@
 
 #include "common/common_pch.h"
 
+#include <ebml/EbmlVoid.h>
+
 #include "common/debugging.h"
 #include "common/ebml.h"
 #include "common/fs_sys_helpers.h"
 #include "common/hacks.h"
 #include "common/math.h"
+#include "common/timing.h"
 #include "merge/cluster_helper.h"
 #include "merge/cues.h"
 #include "merge/generic_packetizer.h"
@@ -78,6 +81,65 @@ cues_c::write(mm_io_c &out,
   if (!m_points.size() || !g_cue_writing_requested)
     return;
 
+  write_points(out, seek_head, 0);
+}
+
+/** \brief Writes the cues into space reserved earlier
+
+   The cues are written at \c placeholder_position, and the rest of
+   the \c placeholder_size bytes is turned into an EbmlVoid
+   element. Nothing is written if the cues don't fit, in which case
+   \c false is returned.
+*/
+bool
+cues_c::write_into_placeholder(mm_io_c &out,
+                               KaxSeekHead &seek_head,
+                               uint64_t placeholder_position,
+                               uint64_t placeholder_size) {
+  if (!m_points.size() || !g_cue_writing_requested)
+    return true;
+
+  auto content_size = calculate_total_size();
+  auto coded_size   = CodedSizeLength(content_size, 0);
+  auto element_size = EBML_ID_LENGTH(EBML_ID(KaxCues)) + coded_size + content_size;
+
+  if (element_size > placeholder_size)
+    return false;
+
+  // An EbmlVoid element needs at least two bytes. A single byte left
+  // over is absorbed by coding the cues' size with one byte more.
+  auto remaining = placeholder_size - element_size;
+  if (1 == remaining) {
+    if (8 == coded_size)
+      return false;
+
+    ++coded_size;
+    remaining = 0;
+  }
+
+  out.save_pos(placeholder_position);
+
+  write_points(out, seek_head, coded_size);
+
+  if (remaining) {
+    auto void_coded_size = 1;
+    while (CodedSizeLength(remaining - 1 - void_coded_size, void_coded_size) != void_coded_size)
+      ++void_coded_size;
+
+    write_ebml_element_head(out, EBML_ID(EbmlVoid), remaining - 1 - void_coded_size, void_coded_size);
+  }
+
+  out.restore_pos();
+
+  return true;
+}
+
+void
+cues_c::write_points(mm_io_c &out,
+                     KaxSeekHead &seek_head,
+                     int min_coded_size) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::cues)};
+
   // auto start = mtx::sys::get_current_time_millis();
   sort();
   // auto end_sort = mtx::sys::get_current_time_millis();
@@ -98,7 +160,7 @@ cues_c::write(mm_io_c &out,
   // Forcefully write the correct head and copy its content from the
   // temporary storage location.
   auto total_size = calculate_total_size();
-  write_ebml_element_head(out, EBML_ID(KaxCues), total_size);
+  write_ebml_element_head(out, EBML_ID(KaxCues), total_size, min_coded_size);
 
   for (auto &point : m_points) {
     KaxCuePoint kc_point;
@@ -177,6 +239,8 @@ cues_c::calculate_block_positions(KaxCluster &cluster)
 void
 cues_c::postprocess_cues(KaxCues &cues,
                          KaxCluster &cluster) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::cues)};
+
   add(cues);
 
   if (m_no_cue_duration && m_no_cue_relative_position)
@@ -246,6 +310,59 @@ cues_c::calculate_total_size()
   return boost::accumulate(m_points, 0ull, [this](uint64_t sum, cue_point_t const &point) { return sum + calculate_point_size(point); });
 }
 
+uint64_t
+cues_c::get_element_size()
+  const {
+  auto content_size = calculate_total_size();
+  return EBML_ID_LENGTH(EBML_ID(KaxCues)) + CodedSizeLength(content_size, 0) + content_size;
+}
+
+/** \brief Estimates the size of the cues for a file of the given duration
+
+   The number of cue points is derived from each track's cue
+   strategy. Their sizes are calculated for the widest values that can
+   occur in a file of this duration whose clusters start no later than
+   \c max_cluster_position. Returns 0 if no cues will be created.
+*/
+uint64_t
+cues_c::estimate_element_size(int64_t duration,
+                              uint64_t max_cluster_position)
+  const {
+  auto num_seconds  = static_cast<uint64_t>(std::max<int64_t>(duration, 0) / 1000000000ll) + 1;
+  auto content_size = 0ull;
+
+  for (auto const &ptzr : g_packetizers) {
+    auto source = ptzr.packetizer;
+    if (!source)
+      continue;
+
+    auto strategy   = source->get_cue_creation();
+    auto track_type = source->get_track_type();
+
+    // Mirrors cluster_helper_c::add_to_cues_maybe() with generous
+    // assumptions about key frame and subtitle frequencies.
+    auto num_points = CUE_STRATEGY_ALL     == strategy                                                           ? num_seconds * 60
+                    : CUE_STRATEGY_IFRAMES == strategy                                                           ? num_seconds * (track_video == track_type ? 2 : 1)
+                    : (CUE_STRATEGY_SPARSE == strategy) && (track_audio == track_type) && !g_video_packetizer ? num_seconds / 2 + 1
+                    :                                                                                              0;
+
+    if (!num_points)
+      continue;
+
+    auto point = cue_point_t{ num_seconds * 1000000000ull, source->wants_cue_duration() ? num_seconds * 1000000000ull : 0, max_cluster_position, static_cast<uint32_t>(source->get_track_num()),
+                              m_no_cue_relative_position ? 0 : std::numeric_limits<uint32_t>::max() };
+
+    content_size += num_points * calculate_point_size(point);
+  }
+
+  if (!content_size)
+    return 0;
+
+  content_size += content_size / 8;
+
+  return EBML_ID_LENGTH(EBML_ID(KaxCues)) + CodedSizeLength(content_size, 0) + content_size;
+}
+
 uint64_t
 cues_c::calculate_bytes_for_uint(uint64_t value)
   const {
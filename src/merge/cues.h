@@ -51,6 +51,9 @@ public:
   void add(KaxCues &cues);
   void add(KaxCuePoint &point);
   void write(mm_io_c &out, KaxSeekHead &seek_head);
+  bool write_into_placeholder(mm_io_c &out, KaxSeekHead &seek_head, uint64_t placeholder_position, uint64_t placeholder_size);
+  uint64_t get_element_size() const;
+  uint64_t estimate_element_size(int64_t duration, uint64_t max_cluster_position) const;
   void postprocess_cues(KaxCues &cues, KaxCluster &cluster);
   void set_duration_for_id_timecode(uint64_t id, uint64_t timecode, uint64_t duration);
   void adjust_positions(uint64_t old_position, uint64_t delta);
@@ -60,6 +63,7 @@ public:
 
 protected:
   void sort();
+  void write_points(mm_io_c &out, KaxSeekHead &seek_head, int min_coded_size);
   std::multimap<id_timecode_t, uint64_t> calculate_block_positions(KaxCluster &cluster) const;
   uint64_t calculate_total_size() const;
   uint64_t calculate_point_size(cue_point_t const &point) const;
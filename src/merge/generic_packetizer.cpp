@@ -29,6 +29,7 @@
 #include "common/ebml.h"
 #include "common/hacks.h"
 #include "common/strings/formatting.h"
+#include "common/thread_pool.h"
 #include "common/unique_numbers.h"
 #include "common/xml/ebml_tags_converter.h"
 #include "merge/cluster_helper.h"
@@ -85,6 +86,7 @@ generic_packetizer_c::generic_packetizer_c(generic_reader_c *reader,
   , m_hvideo_display_width{-1}
   , m_hvideo_display_height{-1}
   , m_hcompression{COMPRESSION_UNSPECIFIED}
+  , m_compress_in_background{}
   , m_timestamp_factory_application_mode{TFA_AUTOMATIC}
   , m_last_cue_timecode{-1}
   , m_has_been_flushed{}
@@ -765,6 +767,10 @@ generic_packetizer_c::set_headers() {
 
     m_compressor = compressor_c::create(m_hcompression);
     m_compressor->set_track_headers(c_encoding);
+
+    // Deflating is expensive enough to be worth farming out to other
+    // cores; the other methods only copy a couple of bytes.
+    m_compress_in_background = (COMPRESSION_ZLIB == m_hcompression) && (1 < thread_pool_c::get().get_num_threads());
   }
 
   if (g_no_lacing)
@@ -802,17 +808,8 @@ generic_packetizer_c::add_packet(packet_cptr pack) {
       && (pack->data_adds.size()  > static_cast<size_t>(m_htrack_max_add_block_ids)))
     pack->data_adds.resize(m_htrack_max_add_block_ids);
 
-  if (m_compressor) {
-    try {
-      pack->data = m_compressor->compress(pack->data);
-      size_t i;
-      for (i = 0; pack->data_adds.size() > i; ++i)
-        pack->data_adds[i] = m_compressor->compress(pack->data_adds[i]);
-
-    } catch (mtx::compression_x &e) {
-      mxerror_tid(m_ti.m_fname, m_ti.m_id, boost::format(Y("Compression failed: %1%\n")) % e.error());
-    }
-  }
+  if (m_compressor && !m_compress_in_background)
+    compress_packet(*pack);
 
   pack->data->grab();
   for (auto &data_add : pack->data_adds)
@@ -822,6 +819,9 @@ generic_packetizer_c::add_packet(packet_cptr pack) {
 
   m_enqueued_bytes += pack->data->get_size();
 
+  if (m_compressor && m_compress_in_background)
+    compress_packet_in_background(pack);
+
   if ((0 > pack->bref) && (0 <= pack->fref))
     std::swap(pack->bref, pack->fref);
 
@@ -909,11 +909,95 @@ generic_packetizer_c::process_deferred_packets() {
   m_deferred_packets.clear();
 }
 
+void
+generic_packetizer_c::compress_packet(packet_t &packet) {
+  try {
+    packet.data = m_compressor->compress(packet.data);
+    size_t i;
+    for (i = 0; packet.data_adds.size() > i; ++i)
+      packet.data_adds[i] = m_compressor->compress(packet.data_adds[i]);
+
+  } catch (mtx::compression_x &e) {
+    mxerror_tid(m_ti.m_fname, m_ti.m_id, boost::format(Y("Compression failed: %1%\n")) % e.error());
+  }
+}
+
+// The packet's buffers have already been grabbed, so the reader is free
+// to re-use its own buffers while a worker compresses the packet. The
+// packet isn't handed out by get_packet() before its job has finished.
+void
+generic_packetizer_c::compress_packet_in_background(packet_cptr const &packet) {
+  auto compressor        = m_compressor;
+  auto uncompressed_size = static_cast<int64_t>(packet->data->get_size());
+  auto result            = thread_pool_c::get().submit([packet, compressor]() {
+    packet->data = compressor->compress(packet->data);
+    for (auto &data_add : packet->data_adds)
+      data_add = compressor->compress(data_add);
+  });
+
+  m_compression_jobs.push_back({ packet, std::move(result), uncompressed_size });
+}
+
+// Finishes the compression jobs in the order they were submitted up to
+// and including the one for 'packet'. Returns false if 'wait' is false
+// and one of them is still running.
+bool
+generic_packetizer_c::finish_compression_jobs(packet_cptr const &packet,
+                                              bool wait) {
+  if (brng::find_if(m_compression_jobs, [&packet](compression_job_t const &job) { return job.m_packet == packet; }) == m_compression_jobs.end())
+    return true;
+
+  while (!m_compression_jobs.empty()) {
+    auto &job = m_compression_jobs.front();
+
+    if (!wait && (std::future_status::ready != job.m_result.wait_for(std::chrono::seconds{0})))
+      return false;
+
+    try {
+      job.m_result.get();
+    } catch (mtx::compression_x &e) {
+      mxerror_tid(m_ti.m_fname, m_ti.m_id, boost::format(Y("Compression failed: %1%\n")) % e.error());
+    } catch (mtx::exit_x &ex) {
+      // The error message has already been output by the worker.
+      mxexit(ex.code());
+    }
+
+    m_enqueued_bytes += static_cast<int64_t>(job.m_packet->data->get_size()) - job.m_uncompressed_size;
+
+    auto done = job.m_packet == packet;
+    m_compression_jobs.pop_front();
+
+    if (done)
+      break;
+  }
+
+  return true;
+}
+
+// The first packet is only reported as available once it has been
+// compressed so that the caller keeps on reading and the workers get
+// more packets to compress. Only when enough jobs are queued or the
+// packetizer has been flushed will the caller have to wait.
+bool
+generic_packetizer_c::packet_available() {
+  if (m_packet_queue.empty() || !m_packet_queue.front()->factory_applied)
+    return false;
+
+  if (m_compression_jobs.empty())
+    return true;
+
+  auto wait = m_has_been_flushed || (m_compression_jobs.size() >= (2 * thread_pool_c::get().get_num_threads()));
+
+  return finish_compression_jobs(m_packet_queue.front(), wait);
+}
+
 packet_cptr
 generic_packetizer_c::get_packet() {
   if (m_packet_queue.empty() || !m_packet_queue.front()->factory_applied)
     return packet_cptr{};
 
+  finish_compression_jobs(m_packet_queue.front(), true);
+
   packet_cptr pack = m_packet_queue.front();
   m_packet_queue.pop_front();
 
@@ -995,26 +1079,8 @@ generic_packetizer_c::apply_factory_short_queueing(packet_cptr_di &p_start) {
   }
 }
 
-struct packet_sorter_t {
-  int m_index;
-  static std::deque<packet_cptr> *m_packet_queue;
-
-  packet_sorter_t(int index)
-    : m_index(index)
-  {
-  }
-
-  bool operator <(const packet_sorter_t &cmp) const {
-    return (*m_packet_queue)[m_index]->timecode < (*m_packet_queue)[cmp.m_index]->timecode;
-  }
-};
-
-std::deque<packet_cptr> *packet_sorter_t::m_packet_queue = nullptr;
-
 void
 generic_packetizer_c::apply_factory_full_queueing(packet_cptr_di &p_start) {
-  packet_sorter_t::m_packet_queue = &m_packet_queue;
-
   while (m_packet_queue.end() != p_start) {
     // Find the next I frame packet.
     packet_cptr_di p_end = p_start + 1;
@@ -1028,25 +1094,25 @@ generic_packetizer_c::apply_factory_full_queueing(packet_cptr_di &p_start) {
 
     // Now sort the frames by their timecode as the factory has to be
     // applied to the packets in the same order as they're timestamped.
-    std::vector<packet_sorter_t> sorter;
+    std::vector<size_t> sorter;
     bool needs_sorting        = false;
     int64_t previous_timecode = 0;
     size_t i                  = distance(m_packet_queue.begin(), p_start);
 
     packet_cptr_di p_current;
     for (p_current = p_start; p_current != p_end; ++i, ++p_current) {
-      sorter.push_back(packet_sorter_t(i));
+      sorter.push_back(i);
       if (m_packet_queue[i]->timecode < previous_timecode)
         needs_sorting = true;
       previous_timecode = m_packet_queue[i]->timecode;
     }
 
     if (needs_sorting)
-      std::sort(sorter.begin(), sorter.end());
+      std::sort(sorter.begin(), sorter.end(), [this](size_t a, size_t b) { return m_packet_queue[a]->timecode < m_packet_queue[b]->timecode; });
 
     // Finally apply the factory.
-    for (i = 0; sorter.size() > i; ++i)
-      apply_factory_once(m_packet_queue[sorter[i].m_index]);
+    for (auto idx : sorter)
+      apply_factory_once(m_packet_queue[idx]);
 
     p_start = p_end;
   }
@@ -1089,6 +1155,7 @@ generic_packetizer_c::connect(generic_packetizer_c *src,
   m_huid                       = src->m_huid;
   m_hcompression               = src->m_hcompression;
   m_compressor                 = compressor_c::create(m_hcompression);
+  m_compress_in_background     = src->m_compress_in_background;
   m_last_cue_timecode          = src->m_last_cue_timecode;
   m_timestamp_factory          = src->m_timestamp_factory;
   m_correction_timecode_offset = 0;
@@ -1116,6 +1183,14 @@ generic_packetizer_c::contains_gap() {
   return m_timestamp_factory ? m_timestamp_factory->contains_gap() : false;
 }
 
+int
+generic_packetizer_c::process(packet_cptr packet) {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::packetizer_process, m_process_timing_counter, [this]() { return get_format_name().get_untranslated(); })};
+  timing.add_bytes(packet->data ? packet->data->get_size() : 0);
+
+  return process_impl(packet);
+}
+
 void
 generic_packetizer_c::flush() {
   flush_impl();
@@ -1137,6 +1212,7 @@ generic_packetizer_c::is_compatible_with(output_compatibility_e compatibility) {
 void
 generic_packetizer_c::discard_queued_packets() {
   m_packet_queue.clear();
+  m_compression_jobs.clear();
 }
 
 bool
@@ -1200,6 +1276,8 @@ generic_packetizer_c::create_track_number() {
 
 file_status_e
 generic_packetizer_c::read() {
+  mtx::timing::scope_c timing{mtx::timing::counter_for(mtx::timing::stage_e::reader_read, m_read_timing_counter, [this]() { return m_reader->get_format_name().get_untranslated(); })};
+
   return m_reader->read(this);
 }
 
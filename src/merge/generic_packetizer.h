@@ -17,8 +17,10 @@
 #include "common/common_pch.h"
 
 #include <deque>
+#include <future>
 
 #include "common/option_with_source.h"
+#include "common/timing.h"
 #include "common/timestamp.h"
 #include "common/translation.h"
 #include "merge/file_status.h"
@@ -46,6 +48,12 @@ using packet_cptr_di = std::deque<packet_cptr>::iterator;
 
 class generic_packetizer_c {
 protected:
+  struct compression_job_t {
+    packet_cptr m_packet;
+    std::future<void> m_result;
+    int64_t m_uncompressed_size;
+  };
+
   int m_num_packets;
   std::deque<packet_cptr> m_packet_queue, m_deferred_packets;
   int m_next_packet_wo_assigned_timecode;
@@ -75,6 +83,8 @@ protected:
 
   compression_method_e m_hcompression;
   compressor_ptr m_compressor;
+  bool m_compress_in_background;
+  std::deque<compression_job_t> m_compression_jobs;
 
   timestamp_factory_cptr m_timestamp_factory;
   timestamp_factory_application_e m_timestamp_factory_application_mode;
@@ -86,6 +96,8 @@ protected:
   bool m_prevent_lacing;
   generic_packetizer_c *m_connected_successor;
 
+  mtx::timing::counter_t *m_process_timing_counter{}, *m_read_timing_counter{};
+
 protected:                      // static
   static int ms_track_number;
 
@@ -113,9 +125,7 @@ public:
   virtual void process_deferred_packets();
 
   virtual packet_cptr get_packet();
-  inline bool packet_available() {
-    return !m_packet_queue.empty() && m_packet_queue.front()->factory_applied;
-  }
+  bool packet_available();
   void discard_queued_packets();
   void flush();
   virtual int64_t get_smallest_timecode() const {
@@ -137,7 +147,7 @@ public:
   inline int process(packet_t *packet) {
     return process(packet_cptr(packet));
   }
-  virtual int process(packet_cptr packet) = 0;
+  int process(packet_cptr packet);
 
   virtual void set_cue_creation(cue_strategy_e create_cue_data) {
     m_ti.m_cues = create_cue_data;
@@ -263,6 +273,11 @@ public:
 protected:
   virtual void flush_impl() {
   };
+  virtual int process_impl(packet_cptr packet) = 0;
+
+  void compress_packet(packet_t &packet);
+  void compress_packet_in_background(packet_cptr const &packet);
+  bool finish_compression_jobs(packet_cptr const &packet, bool wait);
 
   virtual void show_experimental_status_version(std::string const &codec_id);
 };
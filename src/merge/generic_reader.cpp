@@ -411,8 +411,8 @@ generic_reader_c::display_identification_results_as_text() {
   }
 }
 
-void
-generic_reader_c::display_identification_results_as_json() {
+nlohmann::json
+generic_reader_c::get_identification_results_as_json() {
   auto verbose_info_to_object = [](mtx::id::verbose_info_t const &verbose_info) -> nlohmann::json {
     auto object = nlohmann::json{};
     for (auto const &property : verbose_info)
@@ -472,7 +472,12 @@ generic_reader_c::display_identification_results_as_json() {
       };
   }
 
-  display_json_output(json);
+  return json;
+}
+
+void
+generic_reader_c::display_identification_results_as_json() {
+  display_json_output(get_identification_results_as_json());
 }
 
 std::string
@@ -111,6 +111,10 @@ public:
   virtual int64_t get_file_size() {
     return m_in->get_size();
   }
+  // The total duration in ns if the container states it, -1 otherwise.
+  virtual int64_t get_duration() const {
+    return -1;
+  }
   virtual int64_t get_queued_bytes() const;
   virtual bool is_simple_subtitle_container() {
     return false;
@@ -123,6 +127,7 @@ public:
   virtual attach_mode_e attachment_requested(int64_t id);
 
   virtual void display_identification_results();
+  virtual nlohmann::json get_identification_results_as_json();
 
 protected:
   virtual bool demuxing_requested(char type, int64_t id, std::string const &language = "");
@@ -0,0 +1,251 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   on-disk cache of identification results
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#if !defined(SYS_WINDOWS)
+# include <sys/stat.h>
+# include <sys/types.h>
+#endif
+
+#include "common/checksums/base.h"
+#include "common/json.h"
+#include "common/mm_io_x.h"
+#include "merge/id_cache.h"
+
+id_cache_c::id_cache_c(bfs::path const &directory,
+                       std::string const &version,
+                       uint64_t max_size)
+  : m_directory{directory}
+  , m_version{version}
+  , m_max_size{max_size}
+  , m_debug{"id_cache"}
+{
+}
+
+boost::optional<nlohmann::json>
+id_cache_c::make_key(std::string const &file_name,
+                     bool disable_multi_file)
+  const {
+  boost::system::error_code ec;
+
+  auto path = bfs::canonical(bfs::path{file_name}, ec);
+  if (ec || !bfs::is_regular_file(path, ec))
+    return boost::none;
+
+  auto size  = bfs::file_size(path, ec);
+  auto mtime = !ec ? bfs::last_write_time(path, ec) : 0;
+  if (ec)
+    return boost::none;
+
+  auto key = nlohmann::json{
+    { "path",               path.string()                    },
+    { "size",               size                             },
+    { "mtime",              static_cast<int64_t>(mtime)      },
+    { "version",            m_version                        },
+    { "disable_multi_file", disable_multi_file               },
+  };
+
+#if !defined(SYS_WINDOWS)
+  // last_write_time() only has a resolution of one second. A file
+  // rewritten within the same second with the same size must not hit.
+  struct stat st;
+  if (0 != ::stat(path.string().c_str(), &st))
+    return boost::none;
+
+# if defined(SYS_APPLE)
+  auto const &mtime_spec = st.st_mtimespec, &ctime_spec = st.st_ctimespec;
+# else
+  auto const &mtime_spec = st.st_mtim,      &ctime_spec = st.st_ctim;
+# endif
+
+  key["mtime_ns"] = static_cast<int64_t>(mtime_spec.tv_sec) * 1000000000ll + mtime_spec.tv_nsec;
+  key["ctime_ns"] = static_cast<int64_t>(ctime_spec.tv_sec) * 1000000000ll + ctime_spec.tv_nsec;
+  key["device"]   = static_cast<uint64_t>(st.st_dev);
+  key["inode"]    = static_cast<uint64_t>(st.st_ino);
+#endif
+
+  return key;
+}
+
+bfs::path
+id_cache_c::get_entry_path(std::string const &canonical_path)
+  const {
+  auto hash = mtx::checksum::calculate(mtx::checksum::algorithm_e::md5, canonical_path.c_str(), canonical_path.length());
+  auto name = std::string{};
+
+  for (auto idx = 0u; idx < hash->get_size(); ++idx)
+    name += (boost::format("%|1$02x|") % static_cast<unsigned int>(hash->get_buffer()[idx])).str();
+
+  return m_directory / (name + ".json");
+}
+
+boost::optional<nlohmann::json>
+id_cache_c::lookup(std::string const &file_name,
+                   bool disable_multi_file) {
+  auto key = make_key(file_name, disable_multi_file);
+  if (!key)
+    return boost::none;
+
+  auto entry_path = get_entry_path((*key)["path"].get<std::string>());
+
+  try {
+    auto content = mm_file_io_c::slurp(entry_path.string());
+    auto entry   = mtx::json::parse(std::string{reinterpret_cast<char const *>(content->get_buffer()), content->get_size()});
+
+    if (mtx::json::dump(entry["key"], -1) != mtx::json::dump(*key, -1)) {
+      mxdebug_if(m_debug, boost::format("id_cache: stale entry for %1%\n") % file_name);
+      return boost::none;
+    }
+
+    // Keep track of when the entry was used last for expiring the
+    // least recently used ones.
+    boost::system::error_code ec;
+    bfs::last_write_time(entry_path, std::time(nullptr), ec);
+
+    mxdebug_if(m_debug, boost::format("id_cache: hit for %1%\n") % file_name);
+
+    return entry["result"];
+
+  } catch (mtx::mm_io::exception &) {
+  } catch (std::invalid_argument &) {
+  } catch (std::domain_error &) {
+  }
+
+  mxdebug_if(m_debug, boost::format("id_cache: miss for %1%\n") % file_name);
+
+  return boost::none;
+}
+
+void
+id_cache_c::store(std::string const &file_name,
+                  bool disable_multi_file,
+                  nlohmann::json const &result) {
+  auto key = make_key(file_name, disable_multi_file);
+  if (!key)
+    return;
+
+  auto entry_path = get_entry_path((*key)["path"].get<std::string>());
+  auto entry      = nlohmann::json{
+    { "key",    *key   },
+    { "result", result },
+  };
+
+  boost::system::error_code ec;
+  bfs::create_directories(m_directory, ec);
+
+  // Write to a temporary file first so that concurrent readers never
+  // see partially written entries.
+  auto temp_path = m_directory / bfs::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+
+  try {
+    auto content = mtx::json::dump(entry, -1);
+    mm_file_io_c out{temp_path.string(), MODE_CREATE};
+    out.write(content.c_str(), content.length());
+
+  } catch (mtx::mm_io::exception &) {
+    mxdebug_if(m_debug, boost::format("id_cache: could not write %1%\n") % temp_path.string());
+    bfs::remove(temp_path, ec);
+    return;
+  }
+
+  auto old_entry_size = bfs::file_size(entry_path, ec);
+  if (ec)
+    old_entry_size = 0;
+
+  bfs::rename(temp_path, entry_path, ec);
+  if (ec) {
+    bfs::remove(temp_path, ec);
+    return;
+  }
+
+  if (m_max_size)
+    enforce_max_size(entry_path, old_entry_size, bfs::file_size(entry_path, ec));
+}
+
+void
+id_cache_c::invalidate(std::string const &file_name) {
+  boost::system::error_code ec;
+
+  auto path = bfs::canonical(bfs::path{file_name}, ec);
+  if (!ec)
+    bfs::remove(get_entry_path(path.string()), ec);
+}
+
+// The directory is only scanned for the first entry stored and whenever
+// the total size tracked since then exceeds the maximum. Pruning removes
+// more than necessary so that it isn't needed again for a while. The
+// entry that has just been stored is always kept.
+void
+id_cache_c::enforce_max_size(bfs::path const &stored_entry_path,
+                             uint64_t old_entry_size,
+                             uint64_t new_entry_size) {
+  struct entry_t {
+    bfs::path path;
+    uint64_t size;
+    std::time_t last_used;
+  };
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+
+  if (m_total_size_known) {
+    m_total_size = m_total_size - std::min(m_total_size, old_entry_size) + new_entry_size;
+    if (m_total_size <= m_max_size)
+      return;
+  }
+
+  boost::system::error_code ec;
+  auto entries    = std::vector<entry_t>{};
+  auto total_size = uint64_t{};
+
+  for (auto itr = bfs::directory_iterator{m_directory, ec}, end = bfs::directory_iterator{}; !ec && (itr != end); itr.increment(ec)) {
+    auto const &path = itr->path();
+    if (path.extension() != ".json")
+      continue;
+
+    auto size      = bfs::file_size(path, ec);
+    auto last_used = !ec ? bfs::last_write_time(path, ec) : 0;
+    if (ec) {
+      ec.clear();
+      continue;
+    }
+
+    entries.push_back({ path, size, last_used });
+    total_size += size;
+  }
+
+  m_total_size       = total_size;
+  m_total_size_known = true;
+
+  if (total_size <= m_max_size)
+    return;
+
+  brng::sort(entries, [](entry_t const &a, entry_t const &b) { return a.last_used < b.last_used; });
+
+  auto target_size = m_max_size / 4 * 3;
+
+  for (auto const &entry : entries) {
+    if (total_size <= target_size)
+      break;
+
+    if (entry.path == stored_entry_path)
+      continue;
+
+    bfs::remove(entry.path, ec);
+    total_size -= entry.size;
+
+    mxdebug_if(m_debug, boost::format("id_cache: removed %1%\n") % entry.path.string());
+  }
+
+  m_total_size = total_size;
+}
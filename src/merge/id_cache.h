@@ -0,0 +1,52 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   class definition for the on-disk cache of identification results
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_MERGE_ID_CACHE_H
+#define MTX_MERGE_ID_CACHE_H
+
+#include "common/common_pch.h"
+
+#include <mutex>
+
+#include "nlohmann-json/src/json.hpp"
+
+// Stores the JSON identification results of files in a directory, one
+// file per source file. An entry is only used if the source file's
+// canonical path, size, modification and change times (with nanosecond
+// resolution where available) and inode as well as the version of
+// mkvmerge that created the entry match. If a maximum size is set then
+// the least recently used entries are removed once the entries take up
+// more space than that.
+class id_cache_c {
+protected:
+  bfs::path m_directory;
+  std::string m_version;
+  uint64_t m_max_size, m_total_size{};
+  bool m_total_size_known{};
+  std::mutex m_mutex;
+  debugging_option_c m_debug;
+
+public:
+  id_cache_c(bfs::path const &directory, std::string const &version, uint64_t max_size = 0);
+
+  boost::optional<nlohmann::json> lookup(std::string const &file_name, bool disable_multi_file);
+  void store(std::string const &file_name, bool disable_multi_file, nlohmann::json const &result);
+  void invalidate(std::string const &file_name);
+
+protected:
+  boost::optional<nlohmann::json> make_key(std::string const &file_name, bool disable_multi_file) const;
+  bfs::path get_entry_path(std::string const &canonical_path) const;
+  void enforce_max_size(bfs::path const &stored_entry_path, uint64_t old_entry_size, uint64_t new_entry_size);
+};
+
+#endif  // MTX_MERGE_ID_CACHE_H
@@ -44,7 +44,7 @@ output_container_unsupported_json(std::string const &filename,
 
   display_json_output(json);
 
-  mxexit(0);
+  exit_after_json_output(0);
 }
 
 void
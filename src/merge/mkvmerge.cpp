@@ -54,7 +54,9 @@
 #include "common/split_arg_parsing.h"
 #include "common/strings/formatting.h"
 #include "common/strings/parsing.h"
+#include "common/timing.h"
 #include "common/unique_numbers.h"
+#include "common/thread_pool.h"
 #include "common/version.h"
 #include "common/webm.h"
 #include "common/xml/ebml_segmentinfo_converter.h"
@@ -62,13 +64,17 @@
 #include "merge/cluster_helper.h"
 #include "merge/filelist.h"
 #include "merge/generic_reader.h"
+#include "merge/id_cache.h"
 #include "merge/id_result.h"
 #include "merge/output_control.h"
 #include "merge/reader_detection_and_creation.h"
+#include "merge/reader_thread.h"
 #include "merge/track_info.h"
 
 using namespace libmatroska;
 
+static std::string s_timing_report_file_name;
+
 /** \brief Outputs usage information
 */
 #define S(x) std::string{x}
@@ -118,11 +124,27 @@ set_usage() {
                   "                           cluster.\n");
   usage_text += Y("  --no-cues                Do not write the cue data (the index).\n");
   usage_text += Y("  --clusters-in-meta-seek  Write meta seek data for clusters.\n");
+  usage_text += Y("  --cues-at-front          Reserve space for the cues in front of the\n"
+                  "                           clusters and write them there.\n");
   usage_text += Y("  --disable-lacing         Do not use lacing.\n");
   usage_text += Y("  --enable-durations       Enable block durations for all blocks.\n");
   usage_text += Y("  --timecode-scale <n>     Force the timecode scale factor to n.\n");
   usage_text += Y("  --disable-track-statistics-tags\n"
                   "                           Do not write tags with track statistics.\n");
+  usage_text += Y("  --threaded-reading       Demux suitable input files on separate threads.\n");
+  usage_text += Y("  --mmap-input             Map source files into memory instead of reading\n"
+                  "                           them into buffers.\n");
+  usage_text += Y("  --prefetch-input <window>[,<depth>]\n"
+                  "                           Read source files ahead on separate threads\n"
+                  "                           in blocks of 'window' KiB, keeping up to\n"
+                  "                           'depth' blocks ready (default: 4).\n");
+  usage_text += Y("  --preallocate-output     Reserve the space the output file is expected to\n"
+                  "                           need before writing it.\n");
+  usage_text += Y("  --direct-output-io       Write the output file bypassing the page cache.\n");
+  usage_text += Y("  --live                   Write a stream that never needs seeking, e.g. to\n"
+                  "                           a pipe. Implied if the output file name is '-'.\n");
+  usage_text += Y("  --timing-report <file>   Measure the time spent in the individual stages\n"
+                  "                           of muxing and write a report to 'file'.\n");
   usage_text +=   "\n";
   usage_text += Y(" File splitting, linking, appending and concatenating (more global options):\n");
   usage_text += Y("  --split <d[K,M,G]|HH:MM:SS|s>\n"
@@ -277,6 +299,20 @@ set_usage() {
   usage_text += Y("  -F, --identification-format <format>\n"
                   "                           Set the identification results format\n"
                   "                           ('text', 'verbose-text', 'json').\n");
+  usage_text += Y("  --identify-batch <file1> [<file2> ...]\n"
+                  "                           Identify several files concurrently and\n"
+                  "                           output one line of JSON per file. A file\n"
+                  "                           name of '-' reads file names from stdin.\n");
+  usage_text += Y("  --identification-cache <directory>\n"
+                  "                           Cache JSON identification results in this\n"
+                  "                           directory and re-use them for unchanged\n"
+                  "                           files.\n");
+  usage_text += Y("  --identification-cache-max-size <n>\n"
+                  "                           Remove the least recently used entries once\n"
+                  "                           the cache is bigger than n MiB.\n");
+  usage_text += Y("  --identification-cache-invalidate\n"
+                  "                           Ignore and replace the cached entries of the\n"
+                  "                           files being identified.\n");
   usage_text += Y("  -l, --list-types         Lists supported input file types.\n");
   usage_text += Y("  --list-languages         Lists all ISO639 languages and their\n"
                   "                           ISO639-2 codes.\n");
@@ -385,7 +421,7 @@ display_unsupported_file_type_json(filelist_t const &file) {
 
   display_json_output(json);
 
-  mxexit(0);
+  exit_after_json_output(0);
 }
 
 static void
@@ -398,6 +434,46 @@ display_unsupported_file_type(filelist_t const &file) {
           % file.name);
 }
 
+static std::unique_ptr<id_cache_c> s_id_cache;
+static bool s_id_cache_invalidate = false;
+
+static bool
+display_cached_identification_results(filelist_t const &file) {
+  if (!s_id_cache)
+    return false;
+
+  if (s_id_cache_invalidate) {
+    s_id_cache->invalidate(file.name);
+    return false;
+  }
+
+  auto result = s_id_cache->lookup(file.name, file.ti->m_disable_multi_file);
+  if (!result)
+    return false;
+
+  // The cached result already contains the warnings emitted while
+  // identifying the file originally. Its file name is the one that
+  // was used for storing it, which may be spelled differently, e.g.
+  // relative instead of absolute or via a symbolic link.
+  (*result)["file_name"] = file.name;
+  display_completed_json_output(*result);
+
+  return true;
+}
+
+static void
+display_identification_results(filelist_t const &file) {
+  if (!s_id_cache) {
+    file.reader->display_identification_results();
+    return;
+  }
+
+  auto result = complete_json_output(file.reader->get_identification_results_as_json());
+  s_id_cache->store(file.name, file.ti->m_disable_multi_file, result);
+
+  display_completed_json_output(result);
+}
+
 /** \brief Identify a file type and its contents
 
    This function called for \c --identify. It sets up dummy track info
@@ -422,6 +498,11 @@ identify(std::string &filename) {
   file.name           = filename;
   file.all_names.push_back(filename);
 
+  if (display_cached_identification_results(file)) {
+    g_files.clear();
+    return;
+  }
+
   get_file_type(file);
 
   if (FILE_TYPE_IS_UNKNOWN == file.type)
@@ -430,11 +511,110 @@ identify(std::string &filename) {
   create_readers();
 
   file.reader->identify();
-  file.reader->display_identification_results();
+  display_identification_results(file);
 
   g_files.clear();
 }
 
+static void
+identify_in_batch(filelist_t &file) {
+  try {
+    if (display_cached_identification_results(file))
+      return;
+
+    get_file_type(file);
+
+    if (FILE_TYPE_IS_UNKNOWN == file.type)
+      display_unsupported_file_type_json(file);
+
+    create_reader(file);
+
+    file.reader->identify();
+    display_identification_results(file);
+
+  } catch (mtx::output::json_output_done_x &) {
+    throw;
+
+  } catch (mtx::exception &ex) {
+    mxerror(boost::format(Y("The file '%1%' could not be identified: %2%\n")) % file.name % ex.error());
+
+  } catch (std::exception &ex) {
+    mxerror(boost::format(Y("The file '%1%' could not be identified: %2%\n")) % file.name % ex.what());
+  }
+}
+
+/** \brief Identify many files at once
+
+   This function is called for \c --identify-batch. The files are
+   identified concurrently on the global thread pool. The results are
+   output in JSON, one line per file, in the order in which the files
+   have been identified, not in the order they were given in.
+
+   Errors only end the identification of the file they occurred for.
+
+   File type detection, reader creation and identify() run on several
+   threads at once. All readers have been checked for state shared
+   between instances: the charset converters serialize their iconv
+   handles, the string formatting helpers in common/strings use
+   per-thread formatters, and the OGM reader doesn't set the segment
+   title and the global FPS while identifying. The remaining
+   readers only use per-instance state, thread-safe static
+   initialization and the debugging options, which are safe to query
+   concurrently.
+*/
+static void
+identify_batch(std::vector<std::string> const &file_names) {
+  verbose             = 0;
+  g_suppress_warnings = true;
+  g_identifying       = true;
+
+  output_json_as_lines();
+
+  auto &pool = thread_pool_c::get();
+  auto jobs  = std::vector<std::future<void>>{};
+
+  for (auto const &file_name : file_names)
+    jobs.emplace_back(pool.submit([file_name]() {
+      filelist_t file;
+      file.ti                       = std::make_unique<track_info_c>();
+      file.ti->m_disable_multi_file = '=' == file_name[0];
+      file.name                     = file.ti->m_disable_multi_file ? file_name.substr(1) : file_name;
+      file.ti->m_fname              = file.name;
+      file.all_names.push_back(file.name);
+
+      start_json_batch_item(file.name);
+
+      try {
+        identify_in_batch(file);
+      } catch (mtx::output::json_output_done_x &) {
+      }
+    }));
+
+  // The pool's threads don't exit on errors themselves; the error
+  // message has already been output though.
+  for (auto &job : jobs)
+    try {
+      job.get();
+    } catch (mtx::exit_x &ex) {
+      mxexit(ex.code());
+    }
+}
+
+static std::vector<std::string>
+read_file_names_from_stdin() {
+  auto file_names = std::vector<std::string>{};
+  auto line       = std::string{};
+
+  while (std::getline(std::cin, line)) {
+    // Only remove the line ending; file names may start or end with spaces.
+    line = chomp(line);
+    if (!line.empty())
+      file_names.push_back(line);
+  }
+
+  return file_names;
+}
+
 /** \brief Parse a number postfixed with a time-based unit
 
    This function parsers a number that is postfixed with one of the
@@ -1767,15 +1947,10 @@ handle_file_name_arg(const std::string &this_arg,
   } else
     file_names.push_back(this_arg);
 
-  for (auto &file_name : file_names) {
+  for (auto &file_name : file_names)
     if (file_name.empty())
       mxerror(Y("An empty file name is not valid.\n"));
 
-    else if (g_outfile == file_name)
-      mxerror(boost::format(Y("The name of the output file '%1%' and of one of the input files is the same. This would cause mkvmerge to overwrite "
-                              "one of your input files. This is most likely not what you want.\n")) % g_outfile);
-  }
-
   if (!ti->m_atracks.empty() && ti->m_atracks.none())
     mxerror(Y("'-A' and '-a' used on the same source file.\n"));
 
@@ -1846,8 +2021,9 @@ handle_file_name_arg(const std::string &this_arg,
    '<tt>--identify</tt>'. The second pass handles options that only
    print some information and exit right afterwards
    (e.g. '<tt>--version</tt>' or '<tt>--list-types</tt>'). The third
-   pass looks for '<tt>--output-file</tt>'. The fourth pass handles
-   everything else.
+   pass looks for '<tt>--webm</tt>' and '<tt>--live</tt>'. The fourth
+   pass handles everything else including the output file name. Options
+   depending on the output file are resolved afterwards.
 */
 std::vector<std::string>
 parse_common_args(std::vector<std::string> args) {
@@ -1888,10 +2064,13 @@ parse_arg_identification_format(std::vector<std::string>::const_iterator &sit,
 static void
 handle_identification_args(std::vector<std::string> const &args) {
   auto identification_command = boost::optional<std::string>{};
-  auto file_to_identify       = boost::optional<std::string>{};
+  auto files_to_identify      = std::vector<std::string>{};
+  auto batch                  = false;
+  auto id_cache_directory     = std::string{};
+  auto id_cache_max_size      = uint64_t{};
 
   for (auto const &this_arg : args) {
-    if (!mtx::included_in(this_arg, "-i", "--identify", "-I", "--identify-verbose", "--identify-for-mmg", "--identify-for-gui", "-J"))
+    if (!mtx::included_in(this_arg, "-i", "--identify", "-I", "--identify-verbose", "--identify-for-mmg", "--identify-for-gui", "-J", "--identify-batch"))
       continue;
 
     identification_command = this_arg;
@@ -1902,8 +2081,9 @@ handle_identification_args(std::vector<std::string> const &args) {
     else if (mtx::included_in(this_arg, "--identify-for-mmg", "--identify-for-gui"))
       g_identification_output_format = identification_output_format_e::gui;
 
-    else if (this_arg == "-J") {
+    else if (mtx::included_in(this_arg, "-J", "--identify-batch")) {
       g_identification_output_format = identification_output_format_e::json;
+      batch                          = this_arg == "--identify-batch";
       redirect_warnings_and_errors_to_json();
     }
   }
@@ -1914,23 +2094,56 @@ handle_identification_args(std::vector<std::string> const &args) {
   for (auto sit = args.cbegin(), sit_end = args.cend(); sit != sit_end; sit++) {
     auto const &this_arg = *sit;
 
-    if (mtx::included_in(this_arg, "-i", "--identify", "-I", "--identify-verbose", "--identify-for-mmg", "--identify-for-gui", "-J"))
+    if (mtx::included_in(this_arg, "-i", "--identify", "-I", "--identify-verbose", "--identify-for-mmg", "--identify-for-gui", "-J", "--identify-batch"))
       continue;
 
     if (mtx::included_in(this_arg, "-F", "--identification-format"))
       parse_arg_identification_format(sit, sit_end);
 
-    else if (file_to_identify)
+    else if (mtx::included_in(this_arg, "--identification-cache", "--identification-cache-max-size")) {
+      if ((sit + 1) == sit_end)
+        mxerror(boost::format(Y("'%1%' lacks its argument.\n")) % this_arg);
+
+      ++sit;
+
+      if (this_arg == "--identification-cache")
+        id_cache_directory = *sit;
+
+      else if (!parse_number(*sit, id_cache_max_size))
+        mxerror(boost::format(Y("Invalid cache size in '%1% %2%'.\n")) % this_arg % *sit);
+
+    } else if (this_arg == "--identification-cache-invalidate")
+      s_id_cache_invalidate = true;
+
+    else if (!files_to_identify.empty() && !batch)
       mxerror(boost::format(Y("The argument '%1%' is not allowed in identification mode.\n")) % this_arg);
 
-    else
-      file_to_identify = this_arg;
+    else if (batch && (this_arg == "-")) {
+      auto file_names = read_file_names_from_stdin();
+      files_to_identify.insert(files_to_identify.end(), file_names.begin(), file_names.end());
+
+    } else
+      files_to_identify.push_back(this_arg);
   }
 
-  if (!file_to_identify)
+  if (batch && (identification_output_format_e::json != g_identification_output_format))
+    mxerror(boost::format(Y("'%1%' only supports the JSON identification format.\n")) % *identification_command);
+
+  if (files_to_identify.empty() && !batch)
     mxerror(boost::format(Y("'%1%' lacks its argument.\n")) % *identification_command);
 
-  identify(*file_to_identify);
+  if (!id_cache_directory.empty()) {
+    if (identification_output_format_e::json != g_identification_output_format)
+      mxerror(Y("'--identification-cache' only supports the JSON identification format.\n"));
+
+    s_id_cache = std::make_unique<id_cache_c>(bfs::path{id_cache_directory}, get_version_info("mkvmerge", vif_full), id_cache_max_size * 1024 * 1024);
+  }
+
+  if (batch)
+    identify_batch(files_to_identify);
+  else
+    identify(files_to_identify.front());
+
   mxexit();
 }
 
@@ -1963,61 +2176,66 @@ parse_args(std::vector<std::string> args) {
 
   }
 
+  // The messages must not end up in the stream if it is written to
+  // the standard output.
+  for (auto sit = args.cbegin(), sit_end = args.cend(); sit != sit_end; sit++)
+    if (   (   (*sit == "--output=-")
+            || (   ((*sit == "-o") || (*sit == "--output"))
+                && ((sit + 1) != sit_end)
+                && (*(sit + 1) == "-")))
+        && !stdio_redirected())
+      redirect_stdio(std::make_shared<mm_stdio_c>(stderr));
+
   mxinfo(boost::format("%1%\n") % get_version_info("mkvmerge", vif_full));
 
   // Now parse options that are needed right at the beginning.
+  for (auto const &this_arg : args) {
+    if ((this_arg == "-w") || (this_arg == "--webm"))
+      set_output_compatibility(OC_WEBM);
+
+    else if (this_arg == "--live")
+      g_live_output = true;
+  }
+
+  auto ti                              = std::make_unique<track_info_c>();
+  bool inputs_found                    = false;
+  bool append_next_file                = false;
+  auto attachment                      = std::make_shared<attachment_t>();
+  auto cues_at_front_requested         = false;
+  auto clusters_in_meta_seek_requested = false;
+
   for (auto sit = args.cbegin(), sit_end = args.cend(); sit != sit_end; sit++) {
     auto const &this_arg = *sit;
     auto sit_next        = sit + 1;
     auto no_next_arg     = sit_next == sit_end;
     auto next_arg        = !no_next_arg ? *sit_next : "";
 
-    if ((this_arg == "-o") || (this_arg == "--output")) {
-      if (no_next_arg)
+    if ((this_arg == "-o") || (this_arg == "--output") || balg::starts_with(this_arg, "--output=")) {
+      auto has_inline_name = balg::starts_with(this_arg, "--output=");
+
+      if (!has_inline_name && no_next_arg)
         mxerror(boost::format(Y("'%1%' lacks a file name.\n")) % this_arg);
 
       if (g_outfile != "")
         mxerror(Y("Only one output file allowed.\n"));
 
-      g_outfile = next_arg;
-      sit++;
+      g_outfile = has_inline_name ? this_arg.substr(9) : next_arg;
+      if (!has_inline_name)
+        sit++;
 
-    } else if ((this_arg == "-w") || (this_arg == "--webm"))
-      set_output_compatibility(OC_WEBM);
-  }
-
-  if (g_outfile.empty()) {
-    mxinfo(Y("Error: no output file name was given.\n\n"));
-    usage(2);
-  }
-
-  if (!outputting_webm() && is_webm_file_name(g_outfile)) {
-    set_output_compatibility(OC_WEBM);
-    mxinfo(boost::format(Y("Automatically enabling WebM compliance mode due to output file name extension.\n")));
-  }
-
-  auto ti               = std::make_unique<track_info_c>();
-  bool inputs_found     = false;
-  bool append_next_file = false;
-  auto attachment       = std::make_shared<attachment_t>();
-
-  for (auto sit = args.cbegin(), sit_end = args.cend(); sit != sit_end; sit++) {
-    auto const &this_arg = *sit;
-    auto sit_next        = sit + 1;
-    auto no_next_arg     = sit_next == sit_end;
-    auto next_arg        = !no_next_arg ? *sit_next : "";
+      continue;
+    }
 
     // Ignore the options we took care of in the first step.
-    if (   (this_arg == "-o")
-        || (this_arg == "--output")
-        || (this_arg == "--command-line-charset")
+    if (   (this_arg == "--command-line-charset")
         || (this_arg == "--engage")) {
       sit++;
       continue;
     }
 
     if (   (this_arg == "-w")
-        || (this_arg == "--webm"))
+        || (this_arg == "--webm")
+        || (this_arg == "--live"))
       continue;
 
     // Global options
@@ -2093,7 +2311,10 @@ parse_args(std::vector<std::string> args) {
       g_write_cues = false;
 
     else if (this_arg == "--clusters-in-meta-seek")
-      g_write_meta_seek_for_clusters = true;
+      clusters_in_meta_seek_requested = true;
+
+    else if (this_arg == "--cues-at-front")
+      cues_at_front_requested = true;
 
     else if (this_arg == "--disable-lacing")
       g_no_lacing = true;
@@ -2104,7 +2325,40 @@ parse_args(std::vector<std::string> args) {
     else if (this_arg == "--disable-track-statistics-tags")
       g_no_track_statistics_tags = true;
 
-    else if (this_arg == "--attachment-description") {
+    else if (this_arg == "--threaded-reading")
+      g_threaded_reading = true;
+
+    else if (this_arg == "--mmap-input")
+      g_mmap_input = true;
+
+    else if (this_arg == "--preallocate-output")
+      g_preallocate_output = true;
+
+    else if (this_arg == "--direct-output-io")
+      g_direct_output_io = true;
+
+    else if (this_arg == "--prefetch-input") {
+      if (no_next_arg)
+        mxerror(Y("'--prefetch-input' lacks the window size.\n"));
+
+      auto parts = split(next_arg, ",", 2);
+      if (   !parse_number(parts[0], g_prefetch_window_size)
+          || !g_prefetch_window_size
+          || ((parts.size() == 2) && (!parse_number(parts[1], g_prefetch_queue_depth) || !g_prefetch_queue_depth)))
+        mxerror(boost::format(Y("Invalid window size or queue depth in '--prefetch-input %1%'.\n")) % next_arg);
+
+      g_prefetch_window_size *= 1024;
+      sit++;
+
+    } else if (this_arg == "--timing-report") {
+      if (no_next_arg)
+        mxerror(Y("'--timing-report' lacks the file name.\n"));
+
+      s_timing_report_file_name = next_arg;
+      mtx::timing::enable();
+      sit++;
+
+    } else if (this_arg == "--attachment-description") {
       if (no_next_arg)
         mxerror(Y("'--attachment-description' lacks the description.\n"));
 
@@ -2485,9 +2739,48 @@ parse_args(std::vector<std::string> args) {
     }
   }
 
+  if (g_outfile.empty()) {
+    mxinfo(Y("Error: no output file name was given.\n\n"));
+    usage(2);
+  }
+
+  for (auto const &file : g_files)
+    if (brng::find(file->all_names, g_outfile) != file->all_names.end())
+      mxerror(boost::format(Y("The name of the output file '%1%' and of one of the input files is the same. This would cause mkvmerge to overwrite "
+                              "one of your input files. This is most likely not what you want.\n")) % g_outfile);
+
+  auto ec = boost::system::error_code{};
+  if (!g_live_output && ((g_outfile == "-") || (bfs::status(bfs::path{g_outfile}, ec).type() == bfs::fifo_file))) {
+    g_live_output = true;
+    mxinfo(boost::format(Y("Automatically enabling live mode as the output is not seekable.\n")));
+  }
+
+  // Live output cannot be indexed as there's no way to write the
+  // seek head pointing to the cues.
+  if (g_live_output)
+    g_write_cues = false;
+
+  if (g_live_output && clusters_in_meta_seek_requested)
+    mxwarn(Y("'--clusters-in-meta-seek' is ignored in live mode as no meta seek element can be written.\n"));
+  else
+    g_write_meta_seek_for_clusters = g_write_meta_seek_for_clusters || clusters_in_meta_seek_requested;
+
+  if (g_live_output && cues_at_front_requested)
+    mxwarn(Y("'--cues-at-front' is ignored in live mode as no cues can be written.\n"));
+  else
+    g_write_cues_at_front = g_write_cues_at_front || cues_at_front_requested;
+
+  if (!outputting_webm() && is_webm_file_name(g_outfile)) {
+    set_output_compatibility(OC_WEBM);
+    mxinfo(boost::format(Y("Automatically enabling WebM compliance mode due to output file name extension.\n")));
+  }
+
   if (!g_cluster_helper->splitting() && !g_no_linking)
     mxwarn(Y("'--link' is only useful in combination with '--split'.\n"));
 
+  if (g_live_output && g_cluster_helper->splitting())
+    mxerror(Y("Splitting is not possible in live mode, e.g. when writing to a pipe or to the standard output.\n"));
+
   if (!inputs_found && g_files.empty())
     mxerror(Y("No input files were given. No output will be created.\n"));
 }
@@ -2637,6 +2930,7 @@ setup(int argc,
   clear_list_of_unique_numbers(UNIQUE_ALL_IDS);
 
   mtx_common_init("mkvmerge", argv[0]);
+  mxexit_add_cleanup_handler(reader_thread_c::stop_all);
   g_kax_tracks = std::make_unique<KaxTracks>();
 
 #if defined(SYS_UNIX) || defined(SYS_APPLE)
@@ -2701,6 +2995,9 @@ main(int argc,
 
   mxinfo(boost::format(Y("Muxing took %1%.\n")) % create_minutes_seconds_time_string((mtx::sys::get_current_time_millis() - start + 500) / 1000, true));
 
+  if (!s_timing_report_file_name.empty())
+    mtx::timing::write_report(s_timing_report_file_name);
+
   cleanup();
 
   mxexit();
@@ -17,6 +17,7 @@
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <cmath>
+#include <csignal>
 #include <iostream>
 #include <typeinfo>
 
@@ -55,7 +56,8 @@
 #include "common/ebml.h"
 #include "common/fs_sys_helpers.h"
 #include "common/hacks.h"
-#include "common/mm_write_buffer_io.h"
+#include "common/mm_async_write_buffer_io.h"
+#include "common/mm_stream_write_io.h"
 #include "common/strings/formatting.h"
 #include "common/tags/tags.h"
 #include "common/translation.h"
@@ -67,6 +69,8 @@
 #include "merge/generic_packetizer.h"
 #include "merge/generic_reader.h"
 #include "merge/output_control.h"
+#include "merge/packet_interleaver.h"
+#include "merge/reader_thread.h"
 #include "merge/webm.h"
 
 using namespace libmatroska;
@@ -97,7 +101,7 @@ kax_info_cptr g_kax_info_chap;
 
 // Variables set by the command line parser.
 std::string g_outfile;
-int64_t g_file_sizes                        = 0;
+std::atomic<int64_t> g_file_sizes{0};
 int g_max_blocks_per_cluster                = 65535;
 int64_t g_max_ns_per_cluster                = 5000000000ll;
 bool g_write_cues                           = true;
@@ -108,6 +112,15 @@ bool g_no_lacing                            = false;
 bool g_no_linking                           = true;
 bool g_use_durations                        = false;
 bool g_no_track_statistics_tags             = false;
+bool g_threaded_reading                     = false;
+bool g_mmap_input                           = false;
+size_t g_prefetch_window_size               = 0;
+size_t g_prefetch_queue_depth               = 4;
+bool g_live_output                          = false;
+bool g_write_cues_at_front                  = false;
+bool g_null_output                          = false;
+bool g_preallocate_output                   = false;
+bool g_direct_output_io                     = false;
 
 double g_timecode_scale                     = TIMECODE_SCALE;
 timecode_scale_mode_e g_timecode_scale_mode = TIMECODE_SCALE_MODE_NORMAL;
@@ -150,6 +163,7 @@ append_mode_e g_append_mode                 = APPEND_MODE_FILE_BASED;
 bool s_appending_files                      = false;
 auto s_debug_appending                      = debugging_option_c{"append|appending"};
 auto s_debug_rerender_track_headers         = debugging_option_c{"rerender|rerender_track_headers"};
+auto s_debug_cues_at_front                  = debugging_option_c{"cues|cues_at_front"};
 
 std::string g_default_language              = "und";
 
@@ -162,6 +176,7 @@ static KaxMyDuration *s_kax_duration;
 
 static std::unique_ptr<KaxTags> s_kax_tags;
 static kax_chapters_cptr s_chapters_in_this_file;
+static bool s_chapters_rendered_up_front = false;
 
 static std::unique_ptr<KaxAttachments> s_kax_as;
 
@@ -169,10 +184,14 @@ static std::unique_ptr<EbmlVoid> s_kax_sh_void;
 static std::unique_ptr<EbmlVoid> s_kax_chapters_void;
 static int64_t s_max_chapter_size           = 0;
 static std::unique_ptr<EbmlVoid> s_void_after_track_headers;
+static std::unique_ptr<EbmlVoid> s_kax_cues_void;
+static unsigned int s_num_cues_placeholders_filled = 0, s_num_cues_placeholder_overflows = 0;
 
 static std::vector<std::tuple<timestamp_c, std::string, std::string>> s_additional_chapter_atoms;
 
 static mm_io_cptr s_out;
+static bool s_out_preallocated = false;
+static volatile std::sig_atomic_t s_live_output_interrupted = 0;
 
 static bitvalue_c s_seguid_prev(128), s_seguid_current(128), s_seguid_next(128);
 
@@ -182,6 +201,10 @@ static generic_reader_c *s_display_reader = nullptr;
 
 static std::unique_ptr<EbmlHead> s_head;
 
+static packet_interleaver_c s_interleaver;
+static std::vector<size_t> s_ptzrs_to_pull;
+static size_t s_num_ptzrs_seen            = 0;
+
 static std::string s_muxing_app, s_writing_app;
 static boost::posix_time::ptime s_writing_date;
 
@@ -222,10 +245,23 @@ calculate_file_duration() {
    On \c SIGINT mkvmerge will try to sanitize the current output file
    by writing the cues, the meta seek information and by updating the
    segment duration and the segment length.
+
+   Nothing can be fixed in a live stream that has already been
+   written. In live mode only a flag is set, and the main loop stops
+   after the current packet. A second \c SIGINT ends mkvmerge
+   immediately.
 */
 #if defined(SYS_UNIX) || defined(SYS_APPLE)
 void
 sighandler(int /* signum */) {
+  if (g_live_output) {
+    if (s_live_output_interrupted)
+      std::_Exit(2);
+
+    s_live_output_interrupted = 1;
+    return;
+  }
+
   if (!s_out)
     mxerror(Y("mkvmerge was interrupted by a SIGINT (Ctrl+C?)\n"));
 
@@ -311,8 +347,13 @@ display_progress(bool is_100percent = false) {
   if (!s_display_reader)
     s_display_reader = determine_display_reader();
 
+  // The reader of a file demuxed on its own thread must not be queried
+  // directly; its thread publishes the progress after each read instead.
+  auto display_file      = brng::find_if(g_files, [](filelist_cptr const &file) { return file->reader.get() == s_display_reader; });
+  auto reader_progress   = (display_file != g_files.end()) && (*display_file)->reader_thread ? (*display_file)->reader_thread->get_progress() : s_display_reader->get_progress();
+
   bool display_progress  = false;
-  int current_percentage = (s_display_reader->get_progress() + s_display_files_done * 100) / s_display_path_length;
+  int current_percentage = (reader_progress + s_display_files_done * 100) / s_display_path_length;
   int64_t current_time   = mtx::sys::get_current_time_millis();
 
   if (   (-1 == s_previous_percentage)
@@ -488,13 +529,38 @@ render_ebml_head(mm_io_c *out) {
   s_head->Render(*out, true);
 }
 
+/** \brief Checks whether or not the headers can still be changed
+
+   Returns \c false for live output once the first cluster has been
+   written. Warns the first time a change has to be dropped.
+*/
+static bool
+headers_can_be_rewritten() {
+  static auto s_warning_printed = false;
+
+  auto stream_out = dynamic_cast<mm_stream_write_io_c *>(s_out.get());
+  if (!stream_out || !stream_out->is_committed())
+    return true;
+
+  if (!s_warning_printed)
+    mxwarn(Y("The headers have to be changed after they have already been written to the live output. The changes cannot be applied.\n"));
+  s_warning_printed = true;
+
+  return false;
+}
+
 void
 rerender_ebml_head() {
+  if (reader_thread_c::defer_if_threaded(rerender_ebml_head))
+    return;
+
   mm_io_c *out = g_cluster_helper->get_output();
 
-  if (!out || !s_head)
+  if (!out || !s_head || !headers_can_be_rewritten())
     return;
 
+  reader_thread_c::pause_c pause;
+
   out->save_pos(s_head->GetElementPosition());
   render_ebml_head(out);
   out->restore_pos();
@@ -549,10 +615,16 @@ render_headers(mm_io_c *out) {
 
     s_kax_infos = std::make_unique<KaxInfo>();
 
-    s_kax_duration = new KaxMyDuration{ !g_video_packetizer || (TIMECODE_SCALE_MODE_AUTO == g_timecode_scale_mode) ? EbmlFloat::FLOAT_64 : EbmlFloat::FLOAT_32};
+    // The duration isn't known until the end, and a live stream cannot
+    // be updated afterwards.
+    s_kax_duration = nullptr;
 
-    s_kax_duration->SetValue(0.0);
-    s_kax_infos->PushElement(*s_kax_duration);
+    if (!g_live_output) {
+      s_kax_duration = new KaxMyDuration{ !g_video_packetizer || (TIMECODE_SCALE_MODE_AUTO == g_timecode_scale_mode) ? EbmlFloat::FLOAT_64 : EbmlFloat::FLOAT_32};
+
+      s_kax_duration->SetValue(0.0);
+      s_kax_infos->PushElement(*s_kax_duration);
+    }
 
     if (s_muxing_app.empty()) {
       if (!hack_engaged(ENGAGE_NO_VARIABLE_DATA)) {
@@ -629,13 +701,19 @@ render_headers(mm_io_c *out) {
       g_previous_segment_filename.clear();
     }
 
+    if (g_live_output)
+      g_kax_segment->SetSizeInfinite(true);
+
     g_kax_segment->WriteHead(*out, 8);
 
     // Reserve some space for the meta seek stuff.
     g_kax_sh_main = std::make_unique<KaxSeekHead>();
-    s_kax_sh_void = std::make_unique<EbmlVoid>();
-    s_kax_sh_void->SetSize(4096);
-    s_kax_sh_void->Render(*out);
+
+    if (!g_live_output) {
+      s_kax_sh_void = std::make_unique<EbmlVoid>();
+      s_kax_sh_void->SetSize(4096);
+      s_kax_sh_void->Render(*out);
+    }
 
     if (g_write_meta_seek_for_clusters)
       g_kax_sh_cues = std::make_unique<KaxSeekHead>();
@@ -765,18 +843,30 @@ relocate_written_data(uint64_t data_start_pos,
     relocated += to_copy;
   }
 
-  if (s_kax_as) {
+  if (s_kax_as && (s_kax_as->GetElementPosition() >= data_start_pos)) {
     mxdebug_if(s_debug_rerender_track_headers, boost::format("[rerender]  re-writing attachments; old position %1% new %2%\n") % s_kax_as->GetElementPosition() % (s_kax_as->GetElementPosition() + delta));
     s_out->setFilePointer(s_kax_as->GetElementPosition() + delta);
     s_kax_as->Render(*s_out);
   }
 
-  if (s_kax_chapters_void) {
+  if (s_chapters_rendered_up_front && s_chapters_in_this_file && (s_chapters_in_this_file->GetElementPosition() >= data_start_pos)) {
+    mxdebug_if(s_debug_rerender_track_headers, boost::format("[rerender]  re-writing chapters; old position %1% new %2%\n") % s_chapters_in_this_file->GetElementPosition() % (s_chapters_in_this_file->GetElementPosition() + delta));
+    s_out->setFilePointer(s_chapters_in_this_file->GetElementPosition() + delta);
+    s_chapters_in_this_file->Render(*s_out);
+  }
+
+  if (s_kax_chapters_void && (s_kax_chapters_void->GetElementPosition() >= data_start_pos)) {
     mxdebug_if(s_debug_rerender_track_headers, boost::format("[rerender]  re-writing chapter placeholder; old position %1% new %2%\n") % s_kax_chapters_void->GetElementPosition() % (s_kax_chapters_void->GetElementPosition() + delta));
     s_out->setFilePointer(s_kax_chapters_void->GetElementPosition() + delta);
     s_kax_chapters_void->Render(*s_out);
   }
 
+  if (s_kax_cues_void && (s_kax_cues_void->GetElementPosition() >= data_start_pos)) {
+    mxdebug_if(s_debug_rerender_track_headers, boost::format("[rerender]  re-writing cues placeholder; old position %1% new %2%\n") % s_kax_cues_void->GetElementPosition() % (s_kax_cues_void->GetElementPosition() + delta));
+    s_out->setFilePointer(s_kax_cues_void->GetElementPosition() + delta);
+    s_kax_cues_void->Render(*s_out);
+  }
+
   s_out->setFilePointer(rel_pos_from_end, seek_end);
 
   adjust_cue_and_seekhead_positions(data_start_pos, delta);
@@ -833,6 +923,15 @@ shrink_void_and_rerender_track_headers(int64_t new_void_size) {
 */
 void
 rerender_track_headers() {
+  if (reader_thread_c::defer_if_threaded(rerender_track_headers))
+    return;
+
+  if (!headers_can_be_rewritten())
+    return;
+
+  // Reader threads modify their own track entries while reading.
+  reader_thread_c::pause_c pause;
+
   g_kax_tracks->UpdateSize(false);
 
   auto position_before    = s_out->getFilePointer();
@@ -1290,12 +1389,105 @@ render_chapter_void_placeholder() {
     return;
   }
 
+  // Chapters are written right after the headers or appended after
+  // the clusters in live mode, see render_chapters_for_live_output().
+  if (g_live_output)
+    return;
+
   auto size           = s_max_chapter_size + (chapter_generation_mode_e::none == g_cluster_helper->get_chapter_generation_mode() ? 100 : 1000);
   s_kax_chapters_void = std::make_unique<EbmlVoid>();
   s_kax_chapters_void->SetSize(size);
   s_kax_chapters_void->Render(*s_out);
 }
 
+/** \brief Estimate the duration of the output file
+
+   Appended files add their durations to the file they're appended
+   to. Returns -1 if any source file doesn't know its duration.
+*/
+static int64_t
+estimate_output_duration() {
+  auto duration       = static_cast<int64_t>(0);
+  auto chain_duration = static_cast<int64_t>(0);
+
+  for (auto const &file : g_files) {
+    auto file_duration = file->reader->get_duration();
+    if (0 > file_duration)
+      return -1;
+
+    chain_duration = file->appending ? chain_duration + file_duration : file_duration;
+    duration       = std::max(duration, chain_duration);
+  }
+
+  return duration;
+}
+
+/** \brief Reserve space for the cues in front of the clusters
+
+   The size is estimated from the tracks' cue strategies and the
+   estimated duration of the output file. One hour is assumed if the
+   duration cannot be estimated.
+*/
+static void
+render_cues_void_placeholder() {
+  if (!g_write_cues_at_front || !g_write_cues || g_live_output)
+    return;
+
+  auto duration = estimate_output_duration();
+
+  if (0 > duration) {
+    duration = 3600ll * 1000000000ll;
+    mxwarn(Y("The duration of at least one source file is unknown. The space reserved for the cues in front of the clusters assumes a duration of one hour. "
+             "The clusters will be moved if the space turns out to be too small.\n"));
+  }
+
+  auto max_cluster_position = static_cast<uint64_t>(std::max<int64_t>(g_file_sizes, 0)) * 2 + s_out->getFilePointer();
+  auto size                 = cues_c::get().estimate_element_size(duration, max_cluster_position);
+
+  mxdebug_if(s_debug_cues_at_front, boost::format("cues_at_front: duration %1% max_cluster_position %2% reserving %3% bytes\n") % duration % max_cluster_position % size);
+
+  if (!size)
+    return;
+
+  s_kax_cues_void = std::make_unique<EbmlVoid>();
+  s_kax_cues_void->SetSize(size);
+  s_kax_cues_void->Render(*s_out);
+}
+
+/** \brief Fill the space reserved for the cues
+
+   Moves the clusters back if the estimate was too small. This is
+   repeated until the cues fit, as moving the clusters may make the
+   cluster positions in the cues wider.
+*/
+static void
+write_cues_into_placeholder() {
+  auto position = s_kax_cues_void->GetElementPosition();
+  auto size     = s_kax_cues_void->ElementSize(true);
+  auto &cues    = cues_c::get();
+
+  ++s_num_cues_placeholders_filled;
+
+  if (cues.write_into_placeholder(*s_out, *g_kax_sh_main, position, size)) {
+    mxdebug_if(s_debug_cues_at_front, boost::format("cues_at_front: cues fit into %1% bytes at %2%\n") % size % position);
+    return;
+  }
+
+  ++s_num_cues_placeholder_overflows;
+
+  auto needed = cues.get_element_size();
+  mxinfo(boost::format(Y("The space reserved for the cues was too small (%1% bytes instead of %2%). The clusters have to be moved.\n")) % size % needed);
+
+  while (!cues.write_into_placeholder(*s_out, *g_kax_sh_main, position, size)) {
+    auto delta = std::max<uint64_t>(cues.get_element_size(), size + 2) - size;
+
+    mxdebug_if(s_debug_cues_at_front, boost::format("cues_at_front: relocating data behind %1% by %2%\n") % (position + size) % delta);
+
+    relocate_written_data(position + size, delta);
+    size += delta;
+  }
+}
+
 /** \brief Prepare tag elements for rendering
 
     Adds missing mandatory elements to the tag structures and sorts
@@ -1322,6 +1514,59 @@ prepare_tags_for_rendering() {
   g_tags_size = s_kax_tags->ElementSize();
 }
 
+static mm_file_io_c *
+get_output_file() {
+  auto proxy_out = dynamic_cast<mm_proxy_io_c *>(s_out.get());
+  return dynamic_cast<mm_file_io_c *>(proxy_out ? proxy_out->get_proxied() : s_out.get());
+}
+
+static void
+set_up_output_file_io() {
+  static auto s_debug                      = debugging_option_c{"output_file_io"};
+  static auto s_warned_about_direct_io     = false;
+  static auto s_warned_about_preallocation = false;
+
+  s_out_preallocated = false;
+
+  if (g_live_output || g_null_output || g_cluster_helper->discarding())
+    return;
+
+  if (g_direct_output_io) {
+    auto wb_out = dynamic_cast<mm_write_buffer_io_c *>(s_out.get());
+    if ((!wb_out || !wb_out->enable_direct_io()) && !s_warned_about_direct_io) {
+      mxwarn(boost::format(Y("The file '%1%' cannot be written bypassing the page cache. It will be written normally.\n")) % s_out->get_file_name());
+      s_warned_about_direct_io = true;
+    }
+  }
+
+  auto file          = get_output_file();
+  auto expected_size = g_cluster_helper->get_expected_file_size();
+
+  if (!g_preallocate_output || !file || (0 >= expected_size))
+    return;
+
+  s_out_preallocated = file->preallocate(expected_size);
+
+  mxdebug_if(s_debug, boost::format("output_file_io: preallocating %1% bytes for %2%: %3%\n") % expected_size % file->get_file_name() % (s_out_preallocated ? "OK" : "failed"));
+
+  if (!s_out_preallocated && !s_warned_about_preallocation) {
+    mxwarn(boost::format(Y("Space for the file '%1%' cannot be reserved in advance.\n")) % s_out->get_file_name());
+    s_warned_about_preallocation = true;
+  }
+}
+
+static void
+release_preallocated_space() {
+  // The space reserved beyond the file's actual end is given back.
+  s_out->flush();
+
+  auto file = get_output_file();
+  if (file)
+    file->truncate(s_out->get_size());
+}
+
+static void render_chapters_for_live_output();
+
 /** \brief Creates the next output file
 
    Creates a new file name depending on the split settings. Opens that
@@ -1338,7 +1583,9 @@ create_next_output_file() {
 
   // Open the output file.
   try {
-    s_out = !g_cluster_helper->discarding() ? mm_write_buffer_io_c::open(this_outfile, 20 * 1024 * 1024) : mm_io_cptr{ new mm_null_io_c{this_outfile} };
+    s_out = g_cluster_helper->discarding() || g_null_output ? mm_io_cptr{ new mm_null_io_c{this_outfile} }
+          : g_live_output                                   ? mm_stream_write_io_c::open(this_outfile)
+          :                                                   mm_async_write_buffer_io_c::open(this_outfile, 20 * 1024 * 1024);
   } catch (mtx::mm_io::exception &ex) {
     mxerror(boost::format(Y("The file '%1%' could not be opened for writing: %2%.\n")) % this_outfile % ex);
   }
@@ -1346,11 +1593,14 @@ create_next_output_file() {
   if (verbose && !g_cluster_helper->discarding())
     mxinfo(boost::format(Y("The file '%1%' has been opened for writing.\n")) % this_outfile);
 
+  set_up_output_file_io();
+
   g_cluster_helper->set_output(s_out.get());
 
   render_headers(s_out.get());
   render_attachments(s_out.get());
   render_chapter_void_placeholder();
+  render_cues_void_placeholder();
   add_tags_from_cue_chapters();
   prepare_tags_for_rendering();
 
@@ -1358,6 +1608,10 @@ create_next_output_file() {
     return;
 
   s_chapters_in_this_file.reset();
+  s_chapters_rendered_up_front = false;
+
+  if (g_live_output)
+    render_chapters_for_live_output();
 
   run_after_file_created_packetizer_hooks();
 
@@ -1461,6 +1715,29 @@ render_chapters() {
   s_kax_chapters_void.reset();
 }
 
+/** \brief Render the chapters in front of the clusters in live mode
+
+   A live stream cannot be updated once the clusters have been
+   written. If all chapters are known before muxing starts then they
+   are written right away. Chapters from appended files and generated
+   chapters are only known while muxing; in that case all chapters are
+   appended after the clusters in \c finish_file().
+*/
+static void
+render_chapters_for_live_output() {
+  if (!g_kax_chapters || (chapter_generation_mode_e::none != g_cluster_helper->get_chapter_generation_mode()))
+    return;
+
+  for (auto const &file : g_files)
+    if (file->reader->m_chapters)
+      return;
+
+  add_chapters_for_current_part();
+  render_chapters();
+
+  s_chapters_rendered_up_front = true;
+}
+
 static KaxTags *
 set_track_statistics_tags(KaxTags *tags) {
   if (g_no_track_statistics_tags || outputting_webm())
@@ -1474,44 +1751,13 @@ set_track_statistics_tags(KaxTags *tags) {
   return tags;
 }
 
-/** \brief Finishes and closes the current file
+/** \brief Updates the segment information at the start of the file
 
-   Renders the data that is generated during the muxing run. The cues
-   and meta seek information are rendered at the end. If splitting is
-   active the chapters are stripped to those that actually lie in this
-   file and rendered at the front.  The segment duration and the
-   segment size are set to their actual values.
+   Fills in the file's duration and adds or removes the "next segment
+   UID" depending on whether or not this is the last file.
 */
-void
-finish_file(bool last_file,
-            bool create_new_file,
-            bool previously_discarding) {
-  if (g_kax_chapters && !previously_discarding)
-    add_chapters_for_current_part();
-
-  if (!last_file && !create_new_file)
-    return;
-
-  run_before_file_finished_packetizer_hooks();
-
-  bool do_output = verbose && !dynamic_cast<mm_null_io_c *>(s_out.get());
-  if (do_output)
-    mxinfo("\n");
-
-  // Render the track headers a second time if the user has requested that.
-  if (hack_engaged(ENGAGE_WRITE_HEADERS_TWICE)) {
-    auto second_tracks = clone(g_kax_tracks);
-    second_tracks->Render(*s_out);
-    g_kax_sh_main->IndexThis(*second_tracks, *g_kax_segment);
-  }
-
-  // Render the cues.
-  if (g_write_cues && g_cue_writing_requested) {
-    if (do_output)
-      mxinfo(Y("The cue entries (the index) are being written...\n"));
-    cues_c::get().write(*s_out, *g_kax_sh_main);
-  }
-
+static void
+update_segment_info(bool last_file) {
   // Now re-render the s_kax_duration and fill in the biggest timecode
   // as the file's duration.
   s_out->save_pos(s_kax_duration->GetElementPosition());
@@ -1562,6 +1808,57 @@ finish_file(bool last_file,
     }
   }
   s_out->restore_pos();
+}
+
+/** \brief Finishes and closes the current file
+
+   Renders the data that is generated during the muxing run. The cues
+   and meta seek information are rendered at the end. If splitting is
+   active the chapters are stripped to those that actually lie in this
+   file and rendered at the front.  The segment duration and the
+   segment size are set to their actual values.
+*/
+void
+finish_file(bool last_file,
+            bool create_new_file,
+            bool previously_discarding) {
+  if (g_kax_chapters && !previously_discarding && !s_chapters_rendered_up_front)
+    add_chapters_for_current_part();
+
+  if (!last_file && !create_new_file)
+    return;
+
+  run_before_file_finished_packetizer_hooks();
+
+  bool do_output = verbose && !dynamic_cast<mm_null_io_c *>(s_out.get());
+  if (do_output)
+    mxinfo("\n");
+
+  // Fill the space reserved for the cues before anything else is
+  // appended so that as little data as possible has to be moved if
+  // that space is too small.
+  if (s_kax_cues_void && g_write_cues && g_cue_writing_requested) {
+    if (do_output)
+      mxinfo(Y("The cue entries (the index) are being written...\n"));
+    write_cues_into_placeholder();
+  }
+
+  // Render the track headers a second time if the user has requested that.
+  if (hack_engaged(ENGAGE_WRITE_HEADERS_TWICE)) {
+    auto second_tracks = clone(g_kax_tracks);
+    second_tracks->Render(*s_out);
+    g_kax_sh_main->IndexThis(*second_tracks, *g_kax_segment);
+  }
+
+  // Render the cues.
+  if (!s_kax_cues_void && g_write_cues && g_cue_writing_requested) {
+    if (do_output)
+      mxinfo(Y("The cue entries (the index) are being written...\n"));
+    cues_c::get().write(*s_out, *g_kax_sh_main);
+  }
+
+  if (!g_live_output)
+    update_segment_info(last_file);
 
   // Render the segment info a second time if the user has requested that.
   if (hack_engaged(ENGAGE_WRITE_HEADERS_TWICE)) {
@@ -1569,7 +1866,8 @@ finish_file(bool last_file,
     g_kax_sh_main->IndexThis(*s_kax_infos, *g_kax_segment);
   }
 
-  render_chapters();
+  if (!s_chapters_rendered_up_front)
+    render_chapters();
 
   // Render the meta seek information with the cues
   if (g_write_meta_seek_for_clusters && (g_kax_sh_cues->ListSize() > 0) && !hack_engaged(ENGAGE_NO_META_SEEK)) {
@@ -1616,24 +1914,32 @@ finish_file(bool last_file,
     s_kax_as.reset();
   }
 
-  if ((g_kax_sh_main->ListSize() > 0) && !hack_engaged(ENGAGE_NO_META_SEEK)) {
+  if (s_kax_sh_void && (g_kax_sh_main->ListSize() > 0) && !hack_engaged(ENGAGE_NO_META_SEEK)) {
     g_kax_sh_main->UpdateSize();
     if (s_kax_sh_void->ReplaceWith(*g_kax_sh_main, *s_out, true) == INVALID_FILEPOS_T)
       mxwarn(boost::format(Y("This should REALLY not have happened. The space reserved for the first meta seek element was too small. Size needed: %1%. %2%\n"))
              % g_kax_sh_main->ElementSize() % BUGMSG);
   }
 
-  // Set the correct size for the segment.
+  // Set the correct size for the segment. A live stream keeps the
+  // unknown size.
   int64_t final_file_size = s_out->getFilePointer();
-  if (g_kax_segment->ForceSize(final_file_size - g_kax_segment->GetElementPosition() - g_kax_segment->HeadSize()))
+  if (!g_live_output && g_kax_segment->ForceSize(final_file_size - g_kax_segment->GetElementPosition() - g_kax_segment->HeadSize()))
     g_kax_segment->OverwriteHead(*s_out);
 
+  if (s_out_preallocated)
+    release_preallocated_space();
+
+  // Closing explicitly lets errors writing the last buffers reach the
+  // caller; the destructor would have to discard them.
+  s_out->close();
   s_out.reset();
 
   g_kax_segment.reset();
   s_kax_sh_void.reset();
   g_kax_sh_main.reset();
   s_void_after_track_headers.reset();
+  s_kax_cues_void.reset();
   g_kax_sh_cues.reset();
   s_head.reset();
 }
@@ -1917,25 +2223,50 @@ establish_deferred_connections(filelist_t &file) {
   // \todo Select a new file that the subs will defer to.
 }
 
+static void
+pull_packetizer_for_packet(packetizer_t &ptzr) {
+  while (   !ptzr.pack
+         && (FILE_STATUS_MOREDATA == ptzr.status)
+         && !ptzr.packetizer->packet_available())
+    ptzr.status = ptzr.packetizer->read();
+
+  if (   (FILE_STATUS_MOREDATA != ptzr.status)
+         && (FILE_STATUS_MOREDATA == ptzr.old_status))
+    ptzr.packetizer->force_duration_on_last_packet();
+
+  if (!ptzr.pack)
+    ptzr.pack = ptzr.packetizer->get_packet();
+}
+
+/** \brief Fill empty packet slots
+
+   Only packetizers that don't hold a packet are asked for one; for all
+   others pulling would not change anything. They're visited in the order
+   of \c g_packetizers. Slots that receive a packet are handed over to the
+   interleaver.
+*/
 static void
 pull_packetizers_for_packets() {
-  for (auto &ptzr : g_packetizers) {
+  for (; s_num_ptzrs_seen < g_packetizers.size(); ++s_num_ptzrs_seen)
+    s_ptzrs_to_pull.push_back(s_num_ptzrs_seen);
+
+  auto ptzrs_to_pull = std::move(s_ptzrs_to_pull);
+  s_ptzrs_to_pull.clear();
+
+  for (auto idx : ptzrs_to_pull) {
+    auto &ptzr          = g_packetizers[idx];
+    auto &reader_thread = g_files[ptzr.file]->reader_thread;
+
     if (FILE_STATUS_HOLDING == ptzr.status)
       ptzr.status = FILE_STATUS_MOREDATA;
 
     ptzr.old_status = ptzr.status;
 
-    while (   !ptzr.pack
-           && (FILE_STATUS_MOREDATA == ptzr.status)
-           && !ptzr.packetizer->packet_available())
-      ptzr.status = ptzr.packetizer->read();
-
-    if (   (FILE_STATUS_MOREDATA != ptzr.status)
-           && (FILE_STATUS_MOREDATA == ptzr.old_status))
-      ptzr.packetizer->force_duration_on_last_packet();
+    if (!reader_thread)
+      pull_packetizer_for_packet(ptzr);
 
-    if (!ptzr.pack)
-      ptzr.pack = ptzr.packetizer->get_packet();
+    else if (!ptzr.pack && (FILE_STATUS_DONE_AND_DRY != ptzr.status))
+      reader_thread->pull(ptzr);
 
     if (!ptzr.pack && (FILE_STATUS_DONE == ptzr.status))
       ptzr.status = FILE_STATUS_DONE_AND_DRY;
@@ -1956,25 +2287,39 @@ pull_packetizers_for_packets() {
       }
       file.old_num_unfinished_packetizers = file.num_unfinished_packetizers;
     }
+
+    if (ptzr.pack)
+      s_interleaver.add(idx, ptzr.pack->output_order_timecode.to_ns(std::numeric_limits<int64_t>::min()));
+
+    // Finished packetizers may still receive packets from other tracks
+    // in the same file or be revived by appending.
+    else if (   (FILE_STATUS_DONE_AND_DRY != ptzr.status)
+             || !g_files[ptzr.file]->done
+             || s_appending_files)
+      s_ptzrs_to_pull.push_back(idx);
   }
 }
 
-static packetizer_t *
-select_winning_packetizer() {
-  packetizer_t *winner = nullptr;
-
-  for (auto &ptzr : g_packetizers) {
-    if (!ptzr.pack)
-      continue;
+static void
+mark_packetizer_for_pulling(size_t idx) {
+  s_ptzrs_to_pull.insert(std::lower_bound(s_ptzrs_to_pull.begin(), s_ptzrs_to_pull.end(), idx), idx);
+}
 
-    if (!winner || !winner->pack)
-      winner = &ptzr;
+/** \brief Forget the packets and pull requests of a previous run
 
-    else if (ptzr.pack && (ptzr.pack->output_order_timecode < winner->pack->output_order_timecode))
-      winner = &ptzr;
-  }
+   The main loop may run more than once in the same process, e.g. in
+   the mux benchmark.
+*/
+static void
+reset_packet_selection() {
+  s_interleaver.clear();
+  s_ptzrs_to_pull.clear();
+  s_num_ptzrs_seen = 0;
+}
 
-  return winner;
+static packetizer_t *
+select_winning_packetizer() {
+  return s_interleaver.empty() ? nullptr : &g_packetizers[s_interleaver.get_winner()];
 }
 
 static void
@@ -1985,6 +2330,44 @@ discard_queued_packets() {
   g_cluster_helper->discard_queued_packets();
 }
 
+/** \brief Move demuxing of suitable files onto their own threads
+
+   Only files that are neither appended nor appended to, that are not
+   playlists and that provide exactly one track are demuxed
+   concurrently. Everything else stays on the main thread. The option is
+   ignored entirely if files are appended or if splitting is active.
+*/
+static void
+start_reader_threads() {
+  if (!g_threaded_reading || s_appending_files || g_cluster_helper->splitting())
+    return;
+
+  std::vector<int> num_packetizers(g_files.size(), 0);
+  for (auto &ptzr : g_packetizers)
+    ++num_packetizers[ptzr.file];
+
+  for (auto &ptzr : g_packetizers) {
+    auto &file = *g_files[ptzr.file];
+
+    if (   file.appending
+        || file.appended_to
+        || file.is_playlist
+        || ptzr.deferred
+        || (1 != num_packetizers[ptzr.file])
+        || (FILE_STATUS_MOREDATA != ptzr.status))
+      continue;
+
+    file.reader_thread = std::make_shared<reader_thread_c>(file.reader.get(), ptzr.packetizer);
+    file.reader_thread->start();
+  }
+}
+
+static void
+stop_reader_threads() {
+  for (auto &file : g_files)
+    file->reader_thread.reset();
+}
+
 /** \brief Request packets and handle the next one
 
    Requests packets from each packetizer, selects the packet with the
@@ -1993,8 +2376,11 @@ discard_queued_packets() {
 */
 void
 main_loop() {
+  reset_packet_selection();
+  start_reader_threads();
+
   // Let's go!
-  while (1) {
+  while (!s_live_output_interrupted) {
     // Step 1: Make sure a packet is available for each output
     // as long we haven't already processed the last one.
     pull_packetizers_for_packets();
@@ -2014,6 +2400,8 @@ main_loop() {
       g_cluster_helper->add_packet(pack);
 
       winner->pack.reset();
+      s_interleaver.remove_winner();
+      mark_packetizer_for_pulling(winner - &g_packetizers[0]);
 
       // If splitting by parts is active and the last part has been
       // processed fully then we can finish up.
@@ -2030,10 +2418,18 @@ main_loop() {
       break;
   }
 
+  stop_reader_threads();
+
   // Render all remaining packets (if there are any).
   if (g_cluster_helper && (0 < g_cluster_helper->get_packet_count()))
     g_cluster_helper->render();
 
+  if (s_live_output_interrupted) {
+    // The stream written so far ends with a complete cluster.
+    s_out.reset();
+    mxerror(Y("mkvmerge was interrupted by a SIGINT (Ctrl+C?)\n"));
+  }
+
   if (1 <= verbose)
     display_progress(true);
 }
@@ -2064,4 +2460,9 @@ cleanup() {
   g_kax_info_chap.reset();
   g_forced_seguids.clear();
   g_kax_tracks.reset();
+
+  mxdebug_if(s_debug_cues_at_front && s_num_cues_placeholders_filled,
+             boost::format("cues_at_front: %1% of %2% reserved cue areas were too small\n") % s_num_cues_placeholder_overflows % s_num_cues_placeholders_filled);
+
+  memory_pool_c::get().dump_statistics();
 }
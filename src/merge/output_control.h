@@ -17,6 +17,7 @@
 
 #include "common/common_pch.h"
 
+#include <atomic>
 #include <deque>
 #include <unordered_map>
 
@@ -174,12 +175,22 @@ extern generic_packetizer_c *g_video_packetizer;
 
 extern bool g_write_cues, g_cue_writing_requested;
 extern bool g_no_lacing, g_no_linking, g_use_durations, g_no_track_statistics_tags;
+extern bool g_threaded_reading, g_mmap_input;
+// Read-ahead for source files; disabled if the window size is 0.
+extern size_t g_prefetch_window_size, g_prefetch_queue_depth;
+extern bool g_live_output;
+extern bool g_write_cues_at_front;
+// Discards the output instead of writing it. Used by the benchmarks.
+extern bool g_null_output;
+// Reserve the output file's space up front; write bypassing the page cache.
+extern bool g_preallocate_output, g_direct_output_io;
 
 extern bool g_identifying;
 extern identification_output_format_e g_identification_output_format;
 
 extern int g_file_num;
-extern int64_t g_file_sizes;
+// Updated by file type detection running on several threads.
+extern std::atomic<int64_t> g_file_sizes;
 
 extern int64_t g_max_ns_per_cluster;
 extern int g_max_blocks_per_cluster;
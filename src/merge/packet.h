@@ -148,6 +148,17 @@ struct packet_t {
   ~packet_t() {
   }
 
+  static void *
+  operator new(size_t size) {
+    return memory_pool_c::get().allocate_object(size);
+  }
+
+  static void
+  operator delete(void *p,
+                  size_t size) {
+    memory_pool_c::get().release_object(p, size);
+  }
+
   bool
   has_timecode()
     const {
@@ -0,0 +1,56 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   the packet interleaver
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include "merge/packet_interleaver.h"
+
+void
+packet_interleaver_c::add(size_t slot,
+                          int64_t output_order_timecode) {
+  m_heap.emplace_back(output_order_timecode, slot);
+  std::push_heap(m_heap.begin(), m_heap.end(), std::greater<entry_t>{});
+}
+
+void
+packet_interleaver_c::remove_winner() {
+  assert(!m_heap.empty());
+
+  std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<entry_t>{});
+  m_heap.pop_back();
+}
+
+void
+packet_interleaver_c::clear() {
+  m_heap.clear();
+}
+
+size_t
+packet_interleaver_c::get_winner()
+  const {
+  assert(!m_heap.empty());
+
+  return m_heap.front().second;
+}
+
+bool
+packet_interleaver_c::empty()
+  const {
+  return m_heap.empty();
+}
+
+size_t
+packet_interleaver_c::size()
+  const {
+  return m_heap.size();
+}
@@ -0,0 +1,40 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   class definition for the packet interleaver
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_MERGE_PACKET_INTERLEAVER_H
+#define MTX_MERGE_PACKET_INTERLEAVER_H
+
+#include "common/common_pch.h"
+
+// Keeps track of which packetizer slot holds the packet that has to be
+// output next. Slots are identified by their index. The winner is the
+// slot with the smallest output order timecode; ties are resolved in
+// favor of the lower index. Filling a slot and removing the winner both
+// cost O(log n).
+class packet_interleaver_c {
+protected:
+  using entry_t = std::pair<int64_t, size_t>;
+
+  std::vector<entry_t> m_heap;
+
+public:
+  void add(size_t slot, int64_t output_order_timecode);
+  void remove_winner();
+  void clear();
+
+  size_t get_winner() const;
+  bool empty() const;
+  size_t size() const;
+};
+
+#endif  // MTX_MERGE_PACKET_INTERLEAVER_H
@@ -12,7 +12,10 @@
 
 #include "common/common_pch.h"
 
+#include "common/mm_head_buffer_io.h"
+#include "common/mm_mmap_io.h"
 #include "common/mm_mpls_multi_file_io.h"
+#include "common/mm_prefetch_io.h"
 #include "common/mm_read_buffer_io.h"
 #include "common/strings/formatting.h"
 #include "common/xml/xml.h"
@@ -66,16 +69,34 @@ file_names_to_paths(const std::vector<std::string> &file_names) {
 }
 
 static mm_io_cptr
-open_input_file(filelist_t &file) {
+open_input_file(filelist_t &file,
+                bool prefetch = false) {
   try {
+    if ((file.all_names.size() == 1) && g_mmap_input) {
+      // Mapping fails for e.g. pipes or for files too big for the
+      // address space. Those are read the usual way.
+      try {
+        return std::make_shared<mm_mmap_io_c>(file.name);
+      } catch (mtx::mm_io::open_x &) {
+      }
+    }
+
+    mm_io_c *in = nullptr;
     if (file.all_names.size() == 1)
-      return mm_io_cptr(new mm_read_buffer_io_c(new mm_file_io_c(file.name), 1 << 17));
+      in = new mm_file_io_c(file.name);
 
     else {
       std::vector<bfs::path> paths = file_names_to_paths(file.all_names);
-      return mm_io_cptr(new mm_read_buffer_io_c(new mm_multi_file_io_c(paths, file.name), 1 << 17));
+      in = new mm_multi_file_io_c(paths, file.name);
     }
 
+    // The background thread reads from the file itself. The windows it
+    // reads ahead make an additional read buffer unnecessary.
+    if (prefetch)
+      return std::make_shared<mm_prefetch_io_c>(in, g_prefetch_window_size, g_prefetch_queue_depth);
+
+    return mm_io_cptr(new mm_read_buffer_io_c(in, 1 << 17));
+
   } catch (mtx::mm_io::exception &ex) {
     mxerror(boost::format(Y("The file '%1%' could not be opened for reading: %2%.\n")) % file.name % ex);
     return mm_io_cptr{};
@@ -100,10 +121,11 @@ open_playlist_file(filelist_t &file,
 }
 
 static file_type_e
-detect_text_file_formats(filelist_t const &file) {
+detect_text_file_formats(filelist_t const &file,
+                         mm_io_c &in) {
   auto text_io = mm_text_io_cptr{};
   try {
-    text_io        = std::make_shared<mm_text_io_c>(new mm_file_io_c(file.name));
+    text_io        = std::make_shared<mm_text_io_c>(&in, false);
     auto text_size = text_io->get_size();
 
     if (srt_reader_c::probe_file(text_io.get(), text_size))
@@ -133,9 +155,16 @@ detect_text_file_formats(filelist_t const &file) {
 
    Opens the input file and calls the \c probe_file function for each known
    file reader class. Uses \c mm_text_io_c for subtitle probing.
+
+   The start of the file is read into memory once. All probes share that
+   buffer instead of re-reading the same data from the file over and over
+   again; they only hit the file when they look beyond it.
 */
 static std::pair<file_type_e, int64_t>
 get_file_type_internal(filelist_t &file) {
+  // Big enough for the largest window the MP3/AC3/AAC probes look at.
+  static const size_t s_probe_head_size = 2 * 1024 * 1024;
+
   mm_io_cptr af_io = open_input_file(file);
   mm_io_c *io      = af_io.get();
   int64_t size     = std::min(io->get_size(), static_cast<int64_t>(1 << 25));
@@ -144,6 +173,9 @@ get_file_type_internal(filelist_t &file) {
   if (is_playlist)
     io = file.playlist_mpls_in.get();
 
+  mm_head_buffer_io_c probe_io{io, s_probe_head_size, false};
+  io = &probe_io;
+
   file_type_e type = FILE_TYPE_IS_UNKNOWN;
 
   // File types that can be detected unambiguously but are not supported
@@ -190,7 +222,7 @@ get_file_type_internal(filelist_t &file) {
 
   // All text file types (subtitles).
   else
-    type = detect_text_file_formats(file);
+    type = detect_text_file_formats(file, *io);
 
   if (FILE_TYPE_IS_UNKNOWN != type)
     ;                           // intentional fall-through
@@ -275,143 +307,155 @@ get_file_type(filelist_t &file) {
   file.type     = result.first;
 }
 
-/** \brief Creates the file readers
+/** \brief Creates the file reader for a single file
 
-   For each file the appropriate file reader class is instantiated.
-   The newly created class must read all track information in its
-   constructor and throw an exception in case of an error. Otherwise
-   it is assumed that the file can be handled.
+   The reader for the file's type is instantiated, and its headers are
+   read.
 */
 void
-create_readers() {
+create_reader(filelist_t &file) {
   static auto s_debug_timecode_restrictions = debugging_option_c{"timecode_restrictions"};
 
-  for (auto &file : g_files) {
-    try {
-      mm_io_cptr input_file = file->playlist_mpls_in ? std::static_pointer_cast<mm_io_c>(file->playlist_mpls_in) : open_input_file(*file);
-
-      switch (file->type) {
-        case FILE_TYPE_AAC:
-          file->reader.reset(new aac_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_AC3:
-          file->reader.reset(new ac3_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_AVC_ES:
-          file->reader.reset(new avc_es_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_HEVC_ES:
-          file->reader.reset(new hevc_es_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_AVI:
-          file->reader.reset(new avi_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_COREAUDIO:
-          file->reader.reset(new coreaudio_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_DIRAC:
-          file->reader.reset(new dirac_es_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_DTS:
-          file->reader.reset(new dts_reader_c(*file->ti, input_file));
-          break;
+  try {
+    auto prefetch         = g_prefetch_window_size && !g_identifying;
+    mm_io_cptr input_file = !file.playlist_mpls_in ? open_input_file(file, prefetch)
+                          : prefetch               ? std::make_shared<mm_prefetch_io_c>(std::static_pointer_cast<mm_io_c>(file.playlist_mpls_in), g_prefetch_window_size, g_prefetch_queue_depth)
+                          :                          std::static_pointer_cast<mm_io_c>(file.playlist_mpls_in);
+
+    switch (file.type) {
+      case FILE_TYPE_AAC:
+        file.reader.reset(new aac_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_AC3:
+        file.reader.reset(new ac3_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_AVC_ES:
+        file.reader.reset(new avc_es_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_HEVC_ES:
+        file.reader.reset(new hevc_es_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_AVI:
+        file.reader.reset(new avi_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_COREAUDIO:
+        file.reader.reset(new coreaudio_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_DIRAC:
+        file.reader.reset(new dirac_es_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_DTS:
+        file.reader.reset(new dts_reader_c(*file.ti, input_file));
+        break;
 #if defined(HAVE_FLAC_FORMAT_H)
-        case FILE_TYPE_FLAC:
-          file->reader.reset(new flac_reader_c(*file->ti, input_file));
-          break;
+      case FILE_TYPE_FLAC:
+        file.reader.reset(new flac_reader_c(*file.ti, input_file));
+        break;
 #endif
-        case FILE_TYPE_FLV:
-          file->reader.reset(new flv_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_IVF:
-          file->reader.reset(new ivf_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_MATROSKA:
-          file->reader.reset(new kax_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_MP3:
-          file->reader.reset(new mp3_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_MPEG_ES:
-          file->reader.reset(new mpeg_es_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_MPEG_PS:
-          file->reader.reset(new mpeg_ps_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_MPEG_TS:
-          file->reader.reset(new mpeg_ts_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_OGM:
-          file->reader.reset(new ogm_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_PGSSUP:
-          file->reader.reset(new pgssup_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_QTMP4:
-          file->reader.reset(new qtmp4_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_REAL:
-          file->reader.reset(new real_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_SSA:
-          file->reader.reset(new ssa_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_SRT:
-          file->reader.reset(new srt_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_TRUEHD:
-          file->reader.reset(new truehd_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_TTA:
-          file->reader.reset(new tta_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_USF:
-          file->reader.reset(new usf_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_VC1:
-          file->reader.reset(new vc1_es_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_VOBBTN:
-          file->reader.reset(new vobbtn_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_VOBSUB:
-          file->reader.reset(new vobsub_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_WAV:
-          file->reader.reset(new wav_reader_c(*file->ti, input_file));
-          break;
-        case FILE_TYPE_WAVPACK4:
-          file->reader.reset(new wavpack_reader_c(*file->ti, input_file));
-          break;
-        default:
-          mxerror(boost::format(Y("EVIL internal bug! (unknown file type). %1%\n")) % BUGMSG);
-          break;
-      }
+      case FILE_TYPE_FLV:
+        file.reader.reset(new flv_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_IVF:
+        file.reader.reset(new ivf_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_MATROSKA:
+        file.reader.reset(new kax_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_MP3:
+        file.reader.reset(new mp3_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_MPEG_ES:
+        file.reader.reset(new mpeg_es_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_MPEG_PS:
+        file.reader.reset(new mpeg_ps_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_MPEG_TS:
+        file.reader.reset(new mpeg_ts_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_OGM:
+        file.reader.reset(new ogm_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_PGSSUP:
+        file.reader.reset(new pgssup_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_QTMP4:
+        file.reader.reset(new qtmp4_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_REAL:
+        file.reader.reset(new real_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_SSA:
+        file.reader.reset(new ssa_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_SRT:
+        file.reader.reset(new srt_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_TRUEHD:
+        file.reader.reset(new truehd_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_TTA:
+        file.reader.reset(new tta_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_USF:
+        file.reader.reset(new usf_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_VC1:
+        file.reader.reset(new vc1_es_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_VOBBTN:
+        file.reader.reset(new vobbtn_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_VOBSUB:
+        file.reader.reset(new vobsub_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_WAV:
+        file.reader.reset(new wav_reader_c(*file.ti, input_file));
+        break;
+      case FILE_TYPE_WAVPACK4:
+        file.reader.reset(new wavpack_reader_c(*file.ti, input_file));
+        break;
+      default:
+        mxerror(boost::format(Y("EVIL internal bug! (unknown file type). %1%\n")) % BUGMSG);
+        break;
+    }
 
-      file->reader->read_headers();
-      file->reader->set_timecode_restrictions(file->restricted_timecode_min, file->restricted_timecode_max);
+    file.reader->read_headers();
+    file.reader->set_timecode_restrictions(file.restricted_timecode_min, file.restricted_timecode_max);
 
-      // Re-calculate file size because the reader might switch to a
-      // multi I/O reader in read_headers().
-      file->size = file->reader->get_file_size();
+    // Re-calculate file size because the reader might switch to a
+    // multi I/O reader in read_headers().
+    file.size = file.reader->get_file_size();
 
-      mxdebug_if(s_debug_timecode_restrictions,
-                 boost::format("Timecode restrictions for %3%: min %1% max %2%\n") % file->restricted_timecode_min % file->restricted_timecode_max % file->ti->m_fname);
+    mxdebug_if(s_debug_timecode_restrictions,
+               boost::format("Timecode restrictions for %3%: min %1% max %2%\n") % file.restricted_timecode_min % file.restricted_timecode_max % file.ti->m_fname);
 
-    } catch (mtx::mm_io::open_x &error) {
-      mxerror(boost::format(Y("The demultiplexer for the file '%1%' failed to initialize:\n%2%\n")) % file->ti->m_fname % Y("The file could not be opened for reading, or there was not enough data to parse its headers."));
+  } catch (mtx::mm_io::open_x &error) {
+    mxerror(boost::format(Y("The demultiplexer for the file '%1%' failed to initialize:\n%2%\n")) % file.ti->m_fname % Y("The file could not be opened for reading, or there was not enough data to parse its headers."));
 
-    } catch (mtx::input::open_x &error) {
-      mxerror(boost::format(Y("The demultiplexer for the file '%1%' failed to initialize:\n%2%\n")) % file->ti->m_fname % Y("The file could not be opened for reading, or there was not enough data to parse its headers."));
+  } catch (mtx::input::open_x &error) {
+    mxerror(boost::format(Y("The demultiplexer for the file '%1%' failed to initialize:\n%2%\n")) % file.ti->m_fname % Y("The file could not be opened for reading, or there was not enough data to parse its headers."));
 
-    } catch (mtx::input::invalid_format_x &error) {
-      mxerror(boost::format(Y("The demultiplexer for the file '%1%' failed to initialize:\n%2%\n")) % file->ti->m_fname % Y("The file content does not match its format type and was not recognized."));
+  } catch (mtx::input::invalid_format_x &error) {
+    mxerror(boost::format(Y("The demultiplexer for the file '%1%' failed to initialize:\n%2%\n")) % file.ti->m_fname % Y("The file content does not match its format type and was not recognized."));
 
-    } catch (mtx::input::header_parsing_x &error) {
-      mxerror(boost::format(Y("The demultiplexer for the file '%1%' failed to initialize:\n%2%\n")) % file->ti->m_fname % Y("The file headers could not be parsed, e.g. because they're incomplete, invalid or damaged."));
+  } catch (mtx::input::header_parsing_x &error) {
+    mxerror(boost::format(Y("The demultiplexer for the file '%1%' failed to initialize:\n%2%\n")) % file.ti->m_fname % Y("The file headers could not be parsed, e.g. because they're incomplete, invalid or damaged."));
 
-    } catch (mtx::input::exception &error) {
-      mxerror(boost::format(Y("The demultiplexer for the file '%1%' failed to initialize:\n%2%\n")) % file->ti->m_fname % error.error());
-    }
+  } catch (mtx::input::exception &error) {
+    mxerror(boost::format(Y("The demultiplexer for the file '%1%' failed to initialize:\n%2%\n")) % file.ti->m_fname % error.error());
   }
 }
+
+/** \brief Creates the file readers
+
+   For each file the appropriate file reader class is instantiated.
+   The newly created class must read all track information in its
+   constructor and throw an exception in case of an error. Otherwise
+   it is assumed that the file can be handled.
+*/
+void
+create_readers() {
+  for (auto &file : g_files)
+    create_reader(*file);
+}
@@ -0,0 +1,287 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   per-file reader threads
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include "merge/generic_packetizer.h"
+#include "merge/generic_reader.h"
+#include "merge/output_control.h"
+#include "merge/reader_thread.h"
+
+std::vector<reader_thread_c *> reader_thread_c::ms_threads, reader_thread_c::ms_paused_threads;
+std::mutex reader_thread_c::ms_threads_mutex;
+int reader_thread_c::ms_pause_depth                    = 0;
+thread_local reader_thread_c *reader_thread_c::ms_current = nullptr;
+
+reader_thread_c::reader_thread_c(generic_reader_c *reader,
+                                 generic_packetizer_c *packetizer)
+  : m_reader{reader}
+  , m_packetizer{packetizer}
+{
+  std::lock_guard<std::mutex> lock{ms_threads_mutex};
+  ms_threads.push_back(this);
+}
+
+reader_thread_c::~reader_thread_c() {
+  stop();
+
+  std::lock_guard<std::mutex> lock{ms_threads_mutex};
+  ms_threads.erase(std::remove(ms_threads.begin(), ms_threads.end(), this), ms_threads.end());
+}
+
+void
+reader_thread_c::start() {
+  m_thread = std::thread{[this]() { run(); }};
+}
+
+void
+reader_thread_c::stop() {
+  if (!m_thread.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock{m_queue_mutex};
+    m_stop = true;
+  }
+  m_queue_cond.notify_all();
+
+  if (std::this_thread::get_id() == m_thread.get_id())
+    m_thread.detach();
+  else
+    m_thread.join();
+}
+
+void
+reader_thread_c::read_packets(file_status_e &status,
+                              std::deque<packet_cptr> &packets) {
+  std::lock_guard<std::mutex> lock{m_state_mutex};
+
+  m_read_cycle_start = m_num_packets_made_available;
+
+  if (FILE_STATUS_HOLDING == status)
+    status = FILE_STATUS_MOREDATA;
+
+  auto old_status = status;
+
+  while (   (FILE_STATUS_MOREDATA == status)
+         && !m_packetizer->packet_available())
+    status = m_packetizer->read();
+
+  if (   (FILE_STATUS_MOREDATA != status)
+      && (FILE_STATUS_MOREDATA == old_status))
+    m_packetizer->force_duration_on_last_packet();
+
+  packet_cptr packet;
+  while ((packet = m_packetizer->get_packet()))
+    packets.push_back(packet);
+
+  m_progress = m_reader->get_progress();
+}
+
+void
+reader_thread_c::run() {
+  ms_current  = this;
+  auto status = FILE_STATUS_MOREDATA;
+
+  // Errors must not end the program while the main thread is still
+  // writing. They are handed over with the packets instead.
+  mxexit_throws_on_this_thread(true);
+
+  try {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock{m_queue_mutex};
+        m_queue_cond.wait(lock, [this]() { return m_stop || (!m_holding && (m_packets.size() < ms_max_queued_packets)); });
+        if (m_stop)
+          break;
+      }
+
+      std::deque<packet_cptr> packets;
+      read_packets(status, packets);
+
+      std::lock_guard<std::mutex> lock{m_queue_mutex};
+
+      m_num_packets_made_available += packets.size();
+      m_packets.insert(m_packets.end(), packets.begin(), packets.end());
+
+      if (packets.empty() && (FILE_STATUS_DONE == status))
+        m_finished = true;
+
+      else if (packets.empty() && (FILE_STATUS_HOLDING == status))
+        m_holding = true;
+
+      m_queue_cond.notify_all();
+
+      if (m_finished)
+        break;
+    }
+
+  } catch (...) {
+    std::lock_guard<std::mutex> lock{m_queue_mutex};
+    m_exception = std::current_exception();
+    m_finished  = true;
+    m_queue_cond.notify_all();
+  }
+
+  ms_current = nullptr;
+}
+
+void
+reader_thread_c::execute_deferred_actions() {
+  std::vector<std::function<void()>> actions;
+
+  {
+    std::lock_guard<std::mutex> lock{m_queue_mutex};
+    while (!m_deferred_actions.empty() && (m_deferred_actions.front().m_num_packets_taken <= m_num_packets_taken)) {
+      actions.push_back(m_deferred_actions.front().m_action);
+      m_deferred_actions.pop_front();
+    }
+  }
+
+  if (actions.empty())
+    return;
+
+  pause_c pause;
+  for (auto const &action : actions)
+    action();
+}
+
+// Called from the main loop instead of reading from the packetizer
+// directly. Blocks until the worker has either provided a packet, has
+// finished or is holding.
+void
+reader_thread_c::pull(packetizer_t &ptzr) {
+  {
+    std::unique_lock<std::mutex> lock{m_queue_mutex};
+
+    if (m_holding) {
+      m_holding = false;
+      m_queue_cond.notify_all();
+    }
+
+    m_queue_cond.wait(lock, [this]() { return !m_packets.empty() || m_finished || m_holding || m_exception; });
+  }
+
+  execute_deferred_actions();
+
+  std::exception_ptr exception;
+
+  {
+    std::lock_guard<std::mutex> lock{m_queue_mutex};
+
+    if (!m_packets.empty()) {
+      ptzr.pack = m_packets.front();
+      m_packets.pop_front();
+      ++m_num_packets_taken;
+      m_queue_cond.notify_all();
+
+    } else if (m_exception) {
+      exception   = m_exception;
+      m_exception = nullptr;
+    }
+
+    ptzr.status = m_finished && m_packets.empty() ? FILE_STATUS_DONE
+                : m_holding                       ? FILE_STATUS_HOLDING
+                :                                   FILE_STATUS_MOREDATA;
+  }
+
+  if (!exception)
+    return;
+
+  // The error message has already been output by the worker. Exiting
+  // happens here on the main thread and without holding any lock. The
+  // other workers must not keep on reading while the program exits.
+  try {
+    std::rethrow_exception(exception);
+  } catch (mtx::exit_x &ex) {
+    stop_all();
+    mxexit(ex.code());
+  }
+}
+
+int
+reader_thread_c::get_progress() {
+  return m_progress;
+}
+
+bool
+reader_thread_c::defer_if_threaded(std::function<void()> const &action) {
+  auto self = ms_current;
+  if (!self)
+    return false;
+
+  std::lock_guard<std::mutex> lock{self->m_queue_mutex};
+  self->m_deferred_actions.push_back({ self->m_read_cycle_start, action });
+
+  return true;
+}
+
+bool
+reader_thread_c::is_active() {
+  std::lock_guard<std::mutex> lock{ms_threads_mutex};
+  return !ms_threads.empty();
+}
+
+// Stops and joins all workers, e.g. when the program exits due to an
+// error. Workers paused by the main thread are released first as they
+// could not finish their current read cycle otherwise.
+void
+reader_thread_c::stop_all() {
+  if (ms_current)
+    return;
+
+  std::vector<reader_thread_c *> threads;
+
+  {
+    std::lock_guard<std::mutex> lock{ms_threads_mutex};
+
+    if (ms_pause_depth) {
+      for (auto thread : ms_paused_threads)
+        thread->m_state_mutex.unlock();
+      ms_paused_threads.clear();
+      ms_pause_depth = 0;
+    }
+
+    threads = ms_threads;
+  }
+
+  for (auto thread : threads)
+    thread->stop();
+}
+
+reader_thread_c::pause_c::pause_c() {
+  if (ms_current)
+    return;
+
+  std::lock_guard<std::mutex> lock{ms_threads_mutex};
+  if (0 != ms_pause_depth++)
+    return;
+
+  ms_paused_threads = ms_threads;
+  for (auto thread : ms_paused_threads)
+    thread->m_state_mutex.lock();
+}
+
+reader_thread_c::pause_c::~pause_c() {
+  if (ms_current)
+    return;
+
+  // stop_all() may have released the workers already.
+  std::lock_guard<std::mutex> lock{ms_threads_mutex};
+  if (!ms_pause_depth || (0 != --ms_pause_depth))
+    return;
+
+  for (auto thread : ms_paused_threads)
+    thread->m_state_mutex.unlock();
+  ms_paused_threads.clear();
+}
@@ -0,0 +1,100 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL v2
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   class definition for the per-file reader threads
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_MERGE_READER_THREAD_H
+#define MTX_MERGE_READER_THREAD_H
+
+#include "common/common_pch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "merge/file_status.h"
+#include "merge/packet.h"
+
+class generic_packetizer_c;
+class generic_reader_c;
+struct packetizer_t;
+
+// Demuxes a single file with exactly one packetizer on its own
+// thread. The worker performs the same read/get_packet sequence the
+// main loop would perform and hands the resulting packets over through
+// a bounded queue. Actions that touch the output file (re-rendering
+// the track headers or the EBML head) are deferred to the main thread
+// and executed at the same position in the packet stream at which the
+// serial code would have executed them.
+class reader_thread_c {
+public:
+  class pause_c {
+  public:
+    pause_c();
+    ~pause_c();
+  };
+
+protected:
+  struct deferred_action_t {
+    int64_t m_num_packets_taken;
+    std::function<void()> m_action;
+  };
+
+  generic_reader_c *m_reader;
+  generic_packetizer_c *m_packetizer;
+  std::thread m_thread;
+
+  // Held by the worker while it is reading. Locking it from the main
+  // thread therefore pauses the worker at a safe point.
+  std::mutex m_state_mutex;
+
+  std::mutex m_queue_mutex;
+  std::condition_variable m_queue_cond;
+  std::deque<packet_cptr> m_packets;
+  std::deque<deferred_action_t> m_deferred_actions;
+  std::exception_ptr m_exception;
+  bool m_stop{}, m_finished{}, m_holding{};
+  int64_t m_num_packets_made_available{}, m_num_packets_taken{}, m_read_cycle_start{};
+  std::atomic<int> m_progress{};
+
+  static std::vector<reader_thread_c *> ms_threads, ms_paused_threads;
+  static std::mutex ms_threads_mutex;
+  static int ms_pause_depth;
+  static thread_local reader_thread_c *ms_current;
+
+  static size_t const ms_max_queued_packets = 64;
+
+public:
+  reader_thread_c(generic_reader_c *reader, generic_packetizer_c *packetizer);
+  ~reader_thread_c();
+
+  void start();
+  void stop();
+
+  void pull(packetizer_t &ptzr);
+  int get_progress();
+
+protected:
+  void run();
+  void read_packets(file_status_e &status, std::deque<packet_cptr> &packets);
+  void execute_deferred_actions();
+
+public:
+  static bool defer_if_threaded(std::function<void()> const &action);
+  static bool is_active();
+  static void stop_all();
+};
+using reader_thread_cptr = std::shared_ptr<reader_thread_c>;
+
+#endif  // MTX_MERGE_READER_THREAD_H
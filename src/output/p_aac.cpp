@@ -74,7 +74,7 @@ aac_packetizer_c::process_headerless(packet_cptr packet) {
 }
 
 int
-aac_packetizer_c::process(packet_cptr packet) {
+aac_packetizer_c::process_impl(packet_cptr packet) {
   m_timestamp_calculator.add_timecode(packet);
 
   if (m_headerless)
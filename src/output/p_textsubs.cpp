@@ -75,7 +75,7 @@ textsubs_packetizer_c::set_line_ending_style(line_ending_style_e line_ending_sty
 }
 
 int
-textsubs_packetizer_c::process(packet_cptr packet) {
+textsubs_packetizer_c::process_impl(packet_cptr packet) {
   ++m_packetno;
 
   if (0 > packet->duration) {
@@ -10,22 +10,42 @@
 
 #include "common/common_pch.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
 #include "common/bswap.h"
 #include "common/checksums/crc.h"
 #include "common/command_line.h"
 #include "common/endian.h"
 #include "common/mm_io_x.h"
 #include "common/strings/parsing.h"
+#include "common/thread_pool.h"
 
 class cli_options_c {
 public:
   std::string m_file_name;
   mtx::checksum::algorithm_e m_algorithm{mtx::checksum::algorithm_e::adler32};
-  size_t m_chunk_size{4096};
+  size_t m_chunk_size{4096}, m_block_size{4 * 1024 * 1024};
   uint64_t m_initial_value{}, m_xor_result{};
-  bool m_result_in_le{};
+  bool m_result_in_le{}, m_threaded{}, m_statistics{};
+  unsigned int m_num_threads{};
+};
+
+// Where the time went; used for telling whether reading or hashing
+// limits the throughput.
+struct statistics_t {
+  std::chrono::steady_clock::time_point m_start{std::chrono::steady_clock::now()};
+  double m_reading{}, m_waiting_for_hashing{};
+  uint64_t m_num_bytes{};
 };
 
+static double
+seconds_since(std::chrono::steady_clock::time_point const &start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
 static void
 show_help() {
   mxinfo("checksum [options] file_name\n"
@@ -58,6 +78,16 @@ show_help() {
          "  --result-in-le         Output the result in Little Endian (default:\n"
          "                         Big Endian)\n"
          "\n"
+         "Performance options:\n"
+         "\n"
+         "  --threads n            Read the file in one thread and hash it in blocks\n"
+         "                         on \"n\" others; 0 means one per CPU core. Only CRC\n"
+         "                         and Adler32 can be spread over several threads;\n"
+         "                         MD5 is calculated on one thread.\n"
+         "  --block-size size      Size of the blocks read and hashed when using\n"
+         "                         --threads (default: 4194304)\n"
+         "  --statistics           Output the time spent and the throughput\n"
+         "\n"
          "General options:\n"
          "\n"
          "  -h, --help             This help text\n"
@@ -143,6 +173,28 @@ parse_args(std::vector<std::string> &args) {
     } else if (arg == "--result-in-le")
       options.m_result_in_le = true;
 
+    else if (arg == "--threads") {
+      if (next_arg.empty())
+        mxerror(boost::format("Missing argument to %1%\n") % arg);
+
+      if (!parse_number(next_arg, options.m_num_threads))
+        mxerror(boost::format("Invalid argument to %1%: %2%\n") % arg % next_arg);
+
+      options.m_threaded = true;
+      ++current;
+
+    } else if (arg == "--block-size") {
+      if (next_arg.empty())
+        mxerror(boost::format("Missing argument to %1%\n") % arg);
+
+      if (!parse_number(next_arg, options.m_block_size) || !options.m_block_size)
+        mxerror(boost::format("Invalid argument to %1%: %2%\n") % arg % next_arg);
+
+      ++current;
+
+    } else if (arg == "--statistics")
+      options.m_statistics = true;
+
     else if (!options.m_file_name.empty())
       mxerror("More than one input file given\n");
 
@@ -156,13 +208,8 @@ parse_args(std::vector<std::string> &args) {
   return options;
 }
 
-static void
-parse_file(cli_options_c const &options) {
-  auto in         = mm_file_io_c{options.m_file_name};
-  auto file_size  = in.get_size();
-  auto chunk_size = !options.m_chunk_size ? file_size : std::min<int64_t>(file_size, options.m_chunk_size);
-  auto total_read = 0ll;
-  auto buffer     = memory_c::alloc(chunk_size);
+static mtx::checksum::base_uptr
+create_worker(cli_options_c const &options) {
   auto worker     = mtx::checksum::for_algorithm(options.m_algorithm);
   auto crc_worker = dynamic_cast<mtx::checksum::crc_base_c *>(worker.get());
 
@@ -172,12 +219,61 @@ parse_file(cli_options_c const &options) {
     crc_worker->set_result_in_le(options.m_result_in_le);
   }
 
+  return worker;
+}
+
+static void
+add_in_chunks(cli_options_c const &options,
+              mtx::checksum::base_c &worker,
+              unsigned char const *buffer,
+              size_t size) {
+  auto chunk_size = !options.m_chunk_size ? size : options.m_chunk_size;
+
+  for (auto pos = size_t{}; pos < size; pos += chunk_size)
+    worker.add(buffer + pos, std::min(chunk_size, size - pos));
+}
+
+static void
+output_result(cli_options_c const &options,
+              mtx::checksum::base_c &worker) {
+  auto result   = worker.get_result();
+  auto ptr      = result->get_buffer();
+  auto res_size = result->get_size();
+  std::string output;
+
+  for (auto idx = 0u; idx < res_size; idx++)
+    output += (boost::format("%|1$02x|") % static_cast<unsigned int>(ptr[idx])).str();
+
+  mxinfo(boost::format("%1%  %2%\n") % output % options.m_file_name);
+}
+
+static void
+output_statistics(statistics_t const &statistics) {
+  auto total = std::max(seconds_since(statistics.m_start), 1e-9);
+
+  mxinfo(boost::format("%1% bytes in %|2$.3f|s: %|3$.3f| GB/s; %|4$.3f|s reading, %|5$.3f|s waiting for hashing\n")
+         % statistics.m_num_bytes % total % (statistics.m_num_bytes / total / 1000000000.0) % statistics.m_reading % statistics.m_waiting_for_hashing);
+}
+
+static void
+parse_file(cli_options_c const &options) {
+  auto in         = mm_file_io_c{options.m_file_name};
+  auto file_size  = in.get_size();
+  auto chunk_size = !options.m_chunk_size ? file_size : std::min<int64_t>(file_size, options.m_chunk_size);
+  auto total_read = 0ll;
+  auto buffer     = memory_c::alloc(chunk_size);
+  auto worker     = create_worker(options);
+  auto statistics = statistics_t{};
+
   while (total_read < file_size) {
     auto remaining = file_size - total_read;
     chunk_size     = std::min<int64_t>(chunk_size, remaining);
+    auto start     = std::chrono::steady_clock::now();
     auto num_read  = in.read(buffer, chunk_size);
     total_read    += num_read;
 
+    statistics.m_reading += seconds_since(start);
+
     if (num_read != chunk_size)
       mxerror("Could not read the file.\n");
 
@@ -186,15 +282,113 @@ parse_file(cli_options_c const &options) {
 
   worker->finish();
 
-  auto result   = worker->get_result();
-  auto ptr      = result->get_buffer();
-  auto res_size = result->get_size();
-  std::string output;
+  statistics.m_num_bytes = file_size;
 
-  for (auto idx = 0u; idx < res_size; idx++)
-    output += (boost::format("%|1$02x|") % static_cast<unsigned int>(ptr[idx])).str();
+  output_result(options, *worker);
+  if (options.m_statistics)
+    output_statistics(statistics);
+}
 
-  mxinfo(boost::format("%1%  %2%\n") % output % options.m_file_name);
+// The main thread reads blocks into a small set of buffers and hands
+// each one to the thread pool. Algorithms that can be combined hash
+// every block with a worker of its own; those partial results are
+// combined in file order. Other algorithms use a pool with a single
+// thread which adds the blocks to the one worker in order.
+static void
+parse_file_threaded(cli_options_c const &options) {
+  struct block_t {
+    std::future<void> m_done;
+    mtx::checksum::base_uptr m_worker;
+    uint64_t m_size;
+  };
+
+  auto in          = mm_file_io_c{options.m_file_name};
+  auto file_size   = static_cast<uint64_t>(in.get_size());
+  auto worker      = create_worker(options);
+  auto combinable  = dynamic_cast<mtx::checksum::combinable_c *>(worker.get());
+  auto num_threads = !combinable           ? 1u
+                   : options.m_num_threads ? options.m_num_threads
+                   :                         std::max(std::thread::hardware_concurrency(), 1u);
+  auto statistics  = statistics_t{};
+
+  // Enough buffers for every thread to have one block to hash and
+  // one waiting while the next one is being read.
+  std::vector<memory_cptr> free_buffers;
+  for (auto idx = 0u; idx < (2 * num_threads + 1); ++idx)
+    free_buffers.push_back(memory_c::alloc(options.m_block_size));
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<block_t> blocks;
+  thread_pool_c pool{num_threads};
+
+  auto combine_finished_blocks = [&blocks, combinable](bool wait) {
+    while (   !blocks.empty()
+           && (wait || (blocks.front().m_done.wait_for(std::chrono::seconds(0)) == std::future_status::ready))) {
+      auto &block = blocks.front();
+
+      block.m_done.get();
+      if (block.m_worker)
+        combinable->combine(*block.m_worker, block.m_size);
+
+      blocks.pop_front();
+    }
+  };
+
+  in.advise(mm_io_c::access_e::sequential);
+
+  for (auto pos = uint64_t{}; pos < file_size;) {
+    memory_cptr buffer;
+
+    {
+      auto start = std::chrono::steady_clock::now();
+      std::unique_lock<std::mutex> lock{mutex};
+
+      cond.wait(lock, [&free_buffers]() { return !free_buffers.empty(); });
+      buffer = free_buffers.back();
+      free_buffers.pop_back();
+
+      statistics.m_waiting_for_hashing += seconds_since(start);
+    }
+
+    auto size  = static_cast<size_t>(std::min<uint64_t>(options.m_block_size, file_size - pos));
+    auto start = std::chrono::steady_clock::now();
+
+    if (in.read(buffer->get_buffer(), size) != size)
+      mxerror("Could not read the file.\n");
+
+    statistics.m_reading += seconds_since(start);
+
+    auto block     = block_t{};
+    block.m_size   = size;
+    block.m_worker = combinable ? mtx::checksum::for_algorithm(options.m_algorithm) : nullptr;
+    auto target    = combinable ? block.m_worker.get()                              : worker.get();
+
+    block.m_done   = pool.submit([&options, &mutex, &cond, &free_buffers, buffer, size, target]() {
+      add_in_chunks(options, *target, buffer->get_buffer(), size);
+
+      {
+        std::lock_guard<std::mutex> lock{mutex};
+        free_buffers.push_back(buffer);
+      }
+      cond.notify_one();
+    });
+
+    blocks.push_back(std::move(block));
+    pos += size;
+
+    combine_finished_blocks(false);
+  }
+
+  combine_finished_blocks(true);
+
+  worker->finish();
+
+  statistics.m_num_bytes = file_size;
+
+  output_result(options, *worker);
+  if (options.m_statistics)
+    output_statistics(statistics);
 }
 
 int
@@ -209,7 +403,10 @@ main(int argc,
   auto options = parse_args(args);
 
   try {
-    parse_file(options);
+    if (options.m_threaded)
+      parse_file_threaded(options);
+    else
+      parse_file(options);
   } catch (mtx::mm_io::exception &) {
     mxerror("File not found\n");
   }
@@ -0,0 +1,222 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   mux benchmark: runs mkvmerge's main loop and cluster helper with
+   synthetic tracks and discards the output
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include <atomic>
+#include <chrono>
+#include <new>
+
+#include "common/command_line.h"
+#include "common/mm_io_x.h"
+#include "common/strings/parsing.h"
+#include "common/unique_numbers.h"
+#include "merge/cluster_helper.h"
+#include "merge/filelist.h"
+#include "merge/output_control.h"
+#include "tests/benchmark/mux/synthetic_reader.h"
+
+namespace {
+
+std::atomic<uint64_t> s_num_allocations{};
+
+void
+usage() {
+  mxinfo("Usage: mux [options]\n"
+         "\n"
+         "  --video-tracks <n>         Number of video tracks (default: 1).\n"
+         "  --audio-tracks <n>         Number of audio tracks (default: 2).\n"
+         "  --video-packet-size <n>    Size of each video packet in bytes (default: 32768).\n"
+         "  --audio-packet-size <n>    Size of each audio packet in bytes (default: 768).\n"
+         "  --key-frame-interval <n>   Number of video frames per key frame (default: 50).\n"
+         "  --duration <s>             Duration of all tracks in seconds (default: 600).\n"
+         "  --cues <strategy>          One of 'none', 'iframes', 'all' or 'sparse'.\n"
+         "                             Default: depends on the track type.\n"
+         "  --cues-at-front            Reserve space for the cues in front of the clusters.\n"
+         "  --disable-lacing           Do not use lacing.\n");
+  mxexit(0);
+}
+
+template<typename T>
+T
+parse_number_arg(std::string const &option,
+                 std::string const &value,
+                 T min_value = 1) {
+  T number{};
+  if (!parse_number(value, number) || (min_value > number))
+    mxerror(boost::format("Invalid argument to '%1%': %2%\n") % option % value);
+  return number;
+}
+
+cue_strategy_e
+parse_cue_strategy(std::string const &value) {
+  if (value == "none")
+    return CUE_STRATEGY_NONE;
+  if (value == "iframes")
+    return CUE_STRATEGY_IFRAMES;
+  if (value == "all")
+    return CUE_STRATEGY_ALL;
+  if (value == "sparse")
+    return CUE_STRATEGY_SPARSE;
+
+  mxerror(boost::format("Invalid argument to '--cues': %1%\n") % value);
+  return CUE_STRATEGY_UNSPECIFIED;
+}
+
+std::unique_ptr<track_info_c>
+parse_args(std::vector<std::string> const &args,
+           mtxbm::synthetic_parameters_t &parameters) {
+  auto ti = std::make_unique<track_info_c>();
+
+  for (auto idx = 0u; idx < args.size(); ++idx) {
+    auto const &arg = args[idx];
+
+    if ((arg == "-h") || (arg == "--help"))
+      usage();
+
+    else if (arg == "--disable-lacing")
+      g_no_lacing = true;
+
+    else if (arg == "--cues-at-front")
+      g_write_cues_at_front = true;
+
+    else if ((idx + 1) >= args.size())
+      mxerror(boost::format("Unknown option or missing argument: %1%\n") % arg);
+
+    else {
+      auto const &value = args[++idx];
+
+      if (arg == "--video-tracks")
+        parameters.m_num_video_tracks   = parse_number_arg<unsigned int>(arg, value, 0);
+
+      else if (arg == "--audio-tracks")
+        parameters.m_num_audio_tracks   = parse_number_arg<unsigned int>(arg, value, 0);
+
+      else if (arg == "--video-packet-size")
+        parameters.m_video_packet_size  = parse_number_arg<size_t>(arg, value);
+
+      else if (arg == "--audio-packet-size")
+        parameters.m_audio_packet_size  = parse_number_arg<size_t>(arg, value);
+
+      else if (arg == "--key-frame-interval")
+        parameters.m_key_frame_interval = parse_number_arg<unsigned int>(arg, value);
+
+      else if (arg == "--duration")
+        parameters.m_duration           = parse_number_arg<int64_t>(arg, value) * 1000000000ll;
+
+      else if (arg == "--cues")
+        ti->m_cue_creations[-1]         = parse_cue_strategy(value);
+
+      else
+        mxerror(boost::format("Unknown option: %1%\n") % arg);
+    }
+  }
+
+  if (!parameters.m_num_video_tracks && !parameters.m_num_audio_tracks)
+    mxerror("At least one track is needed.\n");
+
+  return ti;
+}
+
+}
+
+// Counts all allocations made through operator new, e.g. for the
+// libebml/libmatroska elements created for each block.
+void *
+operator new(size_t size) {
+  ++s_num_allocations;
+
+  auto memory = malloc(size ? size : 1);
+  if (!memory)
+    throw std::bad_alloc{};
+
+  return memory;
+}
+
+void
+operator delete(void *memory)
+  noexcept {
+  free(memory);
+}
+
+void
+operator delete(void *memory,
+                size_t)
+  noexcept {
+  free(memory);
+}
+
+int
+main(int argc,
+     char **argv) {
+  clear_list_of_unique_numbers(UNIQUE_ALL_IDS);
+
+  mtx_common_init("mux", argv[0]);
+
+  auto args = command_line_utf8(argc, argv);
+  while (handle_common_cli_args(args, ""))
+    ;
+
+  auto parameters = mtxbm::synthetic_parameters_t{};
+  auto ti         = parse_args(args, parameters);
+
+  verbose          = 0;
+  g_null_output    = true;
+  g_outfile        = "benchmark.mkv";
+  g_kax_tracks     = std::make_unique<KaxTracks>();
+  g_cluster_helper = std::make_unique<cluster_helper_c>();
+
+  ti->m_fname      = "synthetic";
+  auto file        = std::make_shared<filelist_t>();
+  file->name       = ti->m_fname;
+  file->all_names  = { file->name };
+  file->ti         = std::move(ti);
+  file->reader.reset(new mtxbm::synthetic_reader_c{*file->ti, std::make_shared<mm_null_io_c>(file->name), parameters});
+  file->reader->read_headers();
+  g_files.push_back(file);
+
+  auto reader = static_cast<mtxbm::synthetic_reader_c *>(file->reader.get());
+
+  create_packetizers();
+  check_track_id_validity();
+  calc_attachment_sizes();
+  calc_max_chapter_size();
+
+  auto num_allocations_before      = s_num_allocations.load();
+  auto num_heap_allocations_before = memory_pool_c::get().get_num_heap_allocations();
+  auto start                       = std::chrono::steady_clock::now();
+
+  try {
+    create_next_output_file();
+    main_loop();
+    finish_file(true);
+  } catch (mtx::mm_io::exception &ex) {
+    mxerror(boost::format("Writing failed: %1%\n") % ex.what());
+  }
+
+  auto seconds         = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  auto num_allocations = (s_num_allocations.load() - num_allocations_before) + (memory_pool_c::get().get_num_heap_allocations() - num_heap_allocations_before);
+  auto num_packets     = reader->get_num_packets();
+  auto num_bytes       = reader->get_num_bytes();
+
+  mxinfo(boost::format("packets: %1% bytes: %2% time: %3% s\n") % num_packets % num_bytes % seconds);
+  mxinfo(boost::format("packets/s: %1% MB/s: %2% allocations/packet: %3%\n")
+         % (seconds > 0 ? num_packets / seconds : 0.0)
+         % (seconds > 0 ? num_bytes / seconds / (1024.0 * 1024.0) : 0.0)
+         % (num_packets ? static_cast<double>(num_allocations) / num_packets : 0.0));
+
+  cleanup();
+
+  mxexit();
+}
@@ -0,0 +1,151 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   synthetic reader & packetizer used by the mux benchmark
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#include "common/common_pch.h"
+
+#include "common/codec.h"
+#include "merge/file_status.h"
+#include "tests/benchmark/mux/synthetic_reader.h"
+
+namespace mtxbm {
+
+synthetic_packetizer_c::synthetic_packetizer_c(generic_reader_c *p_reader,
+                                               track_info_c &p_ti,
+                                               synthetic_track_t const &track)
+  : generic_packetizer_c(p_reader, p_ti)
+{
+  set_track_type(track.m_type);
+  set_track_default_duration(track.m_frame_duration);
+
+  if (track_video == track.m_type) {
+    set_codec_id(MKV_V_VP8);
+    set_video_pixel_width(1920);
+    set_video_pixel_height(1080);
+
+  } else {
+    set_codec_id(MKV_A_AC3);
+    set_audio_sampling_freq(48000);
+    set_audio_channels(2);
+  }
+}
+
+void
+synthetic_packetizer_c::set_headers() {
+  generic_packetizer_c::set_headers();
+}
+
+int
+synthetic_packetizer_c::process_impl(packet_cptr packet) {
+  add_packet(packet);
+
+  return FILE_STATUS_MOREDATA;
+}
+
+connection_result_e
+synthetic_packetizer_c::can_connect_to(generic_packetizer_c *src,
+                                       std::string &) {
+  auto psrc = dynamic_cast<synthetic_packetizer_c *>(src);
+  if (!psrc)
+    return CAN_CONNECT_NO_FORMAT;
+
+  return m_htrack_type == psrc->m_htrack_type ? CAN_CONNECT_YES : CAN_CONNECT_NO_PARAMETERS;
+}
+
+// ------------------------------------------------------------
+
+synthetic_reader_c::synthetic_reader_c(track_info_c const &ti,
+                                       mm_io_cptr const &in,
+                                       synthetic_parameters_t const &parameters)
+  : generic_reader_c{ti, in}
+  , m_parameters{parameters}
+{
+}
+
+synthetic_reader_c::~synthetic_reader_c() {
+}
+
+void
+synthetic_reader_c::read_headers() {
+  for (auto idx = 0u; idx < m_parameters.m_num_video_tracks; ++idx)
+    m_tracks.push_back({ track_video, m_parameters.m_video_packet_size, 40000000, 0, -1, 0, nullptr });
+
+  for (auto idx = 0u; idx < m_parameters.m_num_audio_tracks; ++idx)
+    m_tracks.push_back({ track_audio, m_parameters.m_audio_packet_size, 32000000, 0, -1, 0, nullptr });
+}
+
+void
+synthetic_reader_c::identify() {
+}
+
+void
+synthetic_reader_c::add_available_track_ids() {
+  add_available_track_id_range(m_tracks.size());
+}
+
+void
+synthetic_reader_c::create_packetizers() {
+  for (auto idx = 0u; idx < m_tracks.size(); ++idx)
+    create_packetizer(idx);
+}
+
+void
+synthetic_reader_c::create_packetizer(int64_t id) {
+  auto &track = m_tracks[id];
+
+  if (!demuxing_requested(track_video == track.m_type ? 'v' : 'a', id))
+    return;
+
+  m_ti.m_id    = id;
+  track.m_ptzr = new synthetic_packetizer_c(this, m_ti, track);
+
+  add_packetizer(track.m_ptzr);
+}
+
+file_status_e
+synthetic_reader_c::read(generic_packetizer_c *ptzr,
+                         bool) {
+  auto track = brng::find_if(m_tracks, [ptzr](synthetic_track_t const &t) { return t.m_ptzr == ptzr; });
+  if ((m_tracks.end() == track) || (track->m_next_timestamp >= m_parameters.m_duration))
+    return flush_packetizer(ptzr);
+
+  auto key_frame = (track_video != track->m_type) || !(track->m_num_frames % m_parameters.m_key_frame_interval);
+
+  // The content is irrelevant for muxing; leaving the buffer
+  // uninitialized by default keeps its cost out of the numbers.
+  auto data = memory_c::alloc(track->m_packet_size);
+  if (m_parameters.m_fill_packets)
+    std::memset(data->get_buffer(), (track->m_num_frames + (track - m_tracks.begin())) & 0xff, track->m_packet_size);
+
+  ptzr->process(new packet_t(data, track->m_next_timestamp, track->m_frame_duration, key_frame ? -1 : track->m_previous_timestamp));
+
+  track->m_previous_timestamp  = track->m_next_timestamp;
+  track->m_next_timestamp     += track->m_frame_duration;
+  ++track->m_num_frames;
+
+  ++m_num_packets;
+  m_num_bytes += track->m_packet_size;
+
+  return FILE_STATUS_MOREDATA;
+}
+
+int
+synthetic_reader_c::get_progress() {
+  auto min_timestamp = m_parameters.m_duration;
+  for (auto const &track : m_tracks)
+    if (track.m_ptzr)
+      min_timestamp = std::min(min_timestamp, track.m_next_timestamp);
+
+  return m_parameters.m_duration ? 100 * min_timestamp / m_parameters.m_duration : 100;
+}
+
+}
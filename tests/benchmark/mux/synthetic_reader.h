@@ -0,0 +1,95 @@
+/*
+   mkvmerge -- utility for splicing together matroska files
+   from component media subtypes
+
+   Distributed under the GPL
+   see the file COPYING for details
+   or visit http://www.gnu.org/copyleft/gpl.html
+
+   class definitions for the synthetic reader & packetizer used by the
+   mux benchmark
+
+   Written by Moritz Bunkus <moritz@bunkus.org>.
+*/
+
+#ifndef MTX_TESTS_BENCHMARK_MUX_SYNTHETIC_READER_H
+#define MTX_TESTS_BENCHMARK_MUX_SYNTHETIC_READER_H
+
+#include "common/common_pch.h"
+
+#include "merge/generic_packetizer.h"
+#include "merge/generic_reader.h"
+
+namespace mtxbm {
+
+struct synthetic_parameters_t {
+  unsigned int m_num_video_tracks{1}, m_num_audio_tracks{2};
+  size_t m_video_packet_size{32 * 1024}, m_audio_packet_size{768};
+  int64_t m_duration{600ll * 1000000000ll};
+  unsigned int m_key_frame_interval{50};
+  // Fill the packets with a pattern instead of leaving them
+  // uninitialized, e.g. for comparing the output of two runs.
+  bool m_fill_packets{};
+};
+
+struct synthetic_track_t {
+  int m_type;
+  size_t m_packet_size;
+  int64_t m_frame_duration, m_next_timestamp, m_previous_timestamp;
+  unsigned int m_num_frames;
+  generic_packetizer_c *m_ptzr;
+};
+
+class synthetic_packetizer_c: public generic_packetizer_c {
+public:
+  synthetic_packetizer_c(generic_reader_c *p_reader, track_info_c &p_ti, synthetic_track_t const &track);
+
+  virtual int process_impl(packet_cptr packet);
+  virtual void set_headers();
+
+  virtual translatable_string_c get_format_name() const {
+    return YT("synthetic");
+  }
+  virtual connection_result_e can_connect_to(generic_packetizer_c *src, std::string &error_message);
+};
+
+// Produces packets of a fixed size for a number of video and audio
+// tracks without reading anything. Video tracks run at 25 frames per
+// second with a key frame every m_key_frame_interval frames, audio
+// tracks use 32 ms frames.
+class synthetic_reader_c: public generic_reader_c {
+protected:
+  synthetic_parameters_t m_parameters;
+  std::vector<synthetic_track_t> m_tracks;
+  uint64_t m_num_packets{}, m_num_bytes{};
+
+public:
+  synthetic_reader_c(track_info_c const &ti, mm_io_cptr const &in, synthetic_parameters_t const &parameters);
+  virtual ~synthetic_reader_c();
+
+  virtual file_type_e get_format_type() const {
+    return FILE_TYPE_IS_UNKNOWN;
+  }
+
+  virtual void read_headers();
+  virtual file_status_e read(generic_packetizer_c *ptzr, bool force = false);
+  virtual int get_progress();
+  virtual int64_t get_duration() const {
+    return m_parameters.m_duration;
+  }
+  virtual void identify();
+  virtual void create_packetizer(int64_t id);
+  virtual void create_packetizers();
+  virtual void add_available_track_ids();
+
+  uint64_t get_num_packets() const {
+    return m_num_packets;
+  }
+  uint64_t get_num_bytes() const {
+    return m_num_bytes;
+  }
+};
+
+}
+
+#endif  // MTX_TESTS_BENCHMARK_MUX_SYNTHETIC_READER_H
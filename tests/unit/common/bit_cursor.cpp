@@ -1,5 +1,7 @@
 #include "common/common_pch.h"
 
+#include <random>
+
 #include "common/bit_cursor.h"
 #include "common/endian.h"
 
@@ -304,4 +306,106 @@ TEST(BitReader, ExceptionOnReadingBeyondEOF) {
   EXPECT_THROW(b.get_bytes(target, 2), mtx::mm_io::end_of_file_x);
 }
 
+// Reads everything bit by bit straight from the buffer.
+class reference_reader_c {
+public:
+  std::vector<unsigned char> const &m_data;
+  std::size_t m_pos{};
+
+  reference_reader_c(std::vector<unsigned char> const &data)
+    : m_data(data)
+  {
+  }
+
+  std::size_t remaining() const {
+    return m_data.size() * 8 - m_pos;
+  }
+
+  uint64_t peek_bits(std::size_t n) const {
+    uint64_t value = 0;
+    for (auto idx = 0u; idx < n; ++idx)
+      value = (value << 1) | ((m_data[(m_pos + idx) / 8] >> (7 - ((m_pos + idx) % 8))) & 1);
+    return value;
+  }
+
+  uint64_t get_bits(std::size_t n) {
+    auto value  = peek_bits(n);
+    m_pos      += n;
+    return value;
+  }
+};
+
+TEST(BitReader, MatchesBitByBitReading) {
+  std::mt19937 generator{17};
+
+  for (auto round = 0; round < 2000; ++round) {
+    // Sparse data so that long Exp-Golomb codes occur, too.
+    auto data = std::vector<unsigned char>(generator() % 40);
+    for (auto &byte : data)
+      byte = generator() % 3 ? 0 : generator() % 0x100;
+
+    auto b   = bit_reader_c{data.data(), data.size()};
+    auto ref = reference_reader_c{data};
+
+    for (auto operation = 0; operation < 50; ++operation) {
+      auto n = static_cast<std::size_t>(generator() % 65);
+
+      switch (generator() % 6) {
+        case 0:
+          if (n > ref.remaining()) {
+            EXPECT_THROW(b.get_bits(n), mtx::mm_io::end_of_file_x);
+            EXPECT_TRUE(b.eof());
+            operation = 50;
+          } else
+            EXPECT_EQ(ref.get_bits(n), b.get_bits(n));
+          break;
+
+        case 1:
+          if (n > ref.remaining())
+            EXPECT_THROW(b.peek_bits(n), mtx::mm_io::end_of_file_x);
+          else
+            EXPECT_EQ(ref.peek_bits(n), b.peek_bits(n));
+          break;
+
+        case 2: {
+          auto num_zeros = 0u;
+          while ((ref.remaining() > num_zeros) && !ref.peek_bits(num_zeros + 1))
+            ++num_zeros;
+
+          if (((2 * num_zeros + 1) > ref.remaining()) || (num_zeros > 30)) {
+            operation = 50;
+            break;
+          }
+
+          ref.get_bits(num_zeros + 1);
+          EXPECT_EQ((1 << num_zeros) - 1 + ref.get_bits(num_zeros), b.get_unsigned_golomb());
+          break;
+        }
+
+        case 3:
+          if (n <= ref.remaining()) {
+            ref.m_pos += n;
+            b.skip_bits(n);
+          }
+          break;
+
+        case 4:
+          ref.m_pos = generator() % (data.size() * 8 + 1);
+          b.set_bit_position(ref.m_pos);
+          break;
+
+        case 5:
+          ref.m_pos = (ref.m_pos + 7) / 8 * 8;
+          b.byte_align();
+          break;
+      }
+
+      if (operation < 50) {
+        ASSERT_EQ(static_cast<int>(ref.m_pos),       b.get_bit_position());
+        ASSERT_EQ(static_cast<int>(ref.remaining()), b.get_remaining_bits());
+      }
+    }
+  }
+}
+
 }
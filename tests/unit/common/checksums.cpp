@@ -1,5 +1,8 @@
 #include "common/common_pch.h"
 
+#include <chrono>
+#include <random>
+
 #include "gtest/gtest.h"
 
 #include "common/checksums/base.h"
@@ -134,4 +137,89 @@ TEST_F(ChecksumTest, FileChunked1000) {
   EXPECT_EQ(*m_data_md5, *calculate_bin(mtx::checksum::algorithm_e::md5,                       1000));
 }
 
+std::vector<mtx::checksum::algorithm_e> const s_crc_algorithms{
+  mtx::checksum::algorithm_e::crc8_atm,
+  mtx::checksum::algorithm_e::crc16_ansi,
+  mtx::checksum::algorithm_e::crc16_ccitt,
+  mtx::checksum::algorithm_e::crc32_ieee,
+  mtx::checksum::algorithm_e::crc32_ieee_le,
+};
+
+uint64_t
+calculate_byte_by_byte(mtx::checksum::algorithm_e algorithm,
+                       unsigned char const *buffer,
+                       size_t size) {
+  auto worker = mtx::checksum::for_algorithm(algorithm, 0xffffffff);
+
+  for (auto idx = 0u; idx < size; ++idx)
+    worker->add(&buffer[idx], 1);
+
+  worker->finish();
+
+  return dynamic_cast<mtx::checksum::uint_result_c &>(*worker).get_result_as_uint();
+}
+
+TEST(Checksum, CrcBulkMatchesByteByByte) {
+  // Feeding single bytes only ever uses the one-table lookup. Bigger
+  // buffers go through slicing-by-8 and, for crc32_ieee_le on CPUs
+  // supporting it, carry-less multiplication.
+  std::mt19937 generator{4711};
+  auto data = std::vector<unsigned char>(5000);
+  for (auto &byte : data)
+    byte = generator();
+
+  for (auto algorithm : s_crc_algorithms)
+    for (auto offset = 0u; offset < 16; ++offset)
+      for (auto size : std::vector<size_t>{ 0, 1, 7, 8, 9, 15, 16, 17, 63, 64, 65, 79, 80, 127, 128, 129, 200, 255, 256, 1000, 4096, 4984 }) {
+        auto expected = calculate_byte_by_byte(algorithm, &data[offset], size);
+        EXPECT_EQ(expected, mtx::checksum::calculate_as_uint(algorithm, &data[offset], size, 0xffffffff)) << "algorithm " << static_cast<int>(algorithm) << " offset " << offset << " size " << size;
+      }
+}
+
+TEST(Checksum, CombiningParts) {
+  std::mt19937 generator{815};
+  auto data = std::vector<unsigned char>(20000);
+  for (auto &byte : data)
+    byte = generator();
+
+  auto algorithms = s_crc_algorithms;
+  algorithms.push_back(mtx::checksum::algorithm_e::adler32);
+
+  for (auto algorithm : algorithms)
+    for (auto split : std::vector<size_t>{ 0, 1, 2, 3, 8, 100, 4096, 12345, 19999, 20000 }) {
+      auto expected = mtx::checksum::calculate_as_uint(algorithm, data.data(), data.size());
+      auto first    = mtx::checksum::for_algorithm(algorithm);
+      auto second   = mtx::checksum::for_algorithm(algorithm);
+
+      first->add(data.data(), split);
+      second->add(data.data() + split, data.size() - split);
+      dynamic_cast<mtx::checksum::combinable_c &>(*first).combine(*second, data.size() - split);
+
+      EXPECT_EQ(expected, dynamic_cast<mtx::checksum::uint_result_c &>(*first).get_result_as_uint()) << "algorithm " << static_cast<int>(algorithm) << " split " << split;
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests for numbers.
+TEST(Checksum, DISABLED_CrcThroughput) {
+  auto const size       = size_t{64} * 1024 * 1024;
+  auto const chunk_size = size_t{64} * 1024;
+  auto data             = std::vector<unsigned char>(size);
+
+  std::mt19937 generator{42};
+  for (auto &byte : data)
+    byte = generator();
+
+  for (auto algorithm : s_crc_algorithms) {
+    auto worker = mtx::checksum::for_algorithm(algorithm);
+    auto start  = std::chrono::steady_clock::now();
+
+    for (auto pos = size_t{}; pos < size; pos += chunk_size)
+      worker->add(&data[pos], chunk_size);
+
+    auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << boost::format("algorithm %1%: %|2$.0f| MB/s\n") % static_cast<int>(algorithm) % (size / std::max(duration, 1e-9) / 1024 / 1024);
+  }
+}
+
 }
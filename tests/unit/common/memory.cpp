@@ -0,0 +1,164 @@
+#include "common/common_pch.h"
+
+#include <thread>
+
+#include "common/memory.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(Memory, CloneAndAlloc) {
+  unsigned char const data[5] = { 1, 2, 3, 4, 5 };
+
+  auto mem = memory_c::clone(data, 5);
+  ASSERT_EQ(5u, mem->get_size());
+  EXPECT_TRUE(mem->is_free());
+  EXPECT_EQ(0, memcmp(mem->get_buffer(), data, 5));
+
+  EXPECT_EQ(12345u, memory_c::alloc(12345)->get_size());
+  EXPECT_FALSE(memory_c::clone(nullptr, 5)->is_allocated());
+}
+
+TEST(Memory, ResizeKeepsContent) {
+  auto mem = memory_c::clone(std::string{"0123456789"});
+
+  mem->add(reinterpret_cast<unsigned char const *>("abcdef"), 6);
+  ASSERT_EQ(16u, mem->get_size());
+  EXPECT_EQ(std::string{"0123456789abcdef"}, std::string(reinterpret_cast<char *>(mem->get_buffer()), 16));
+
+  mem->set_offset(4);
+  mem->resize(100000);
+  ASSERT_EQ(100000u, mem->get_size());
+  EXPECT_EQ(std::string{"456789abcdef"}, std::string(reinterpret_cast<char *>(mem->get_buffer()), 12));
+
+  mem->resize(3);
+  ASSERT_EQ(3u, mem->get_size());
+  EXPECT_EQ(std::string{"456"}, std::string(reinterpret_cast<char *>(mem->get_buffer()), 3));
+}
+
+TEST(Memory, ResizeNotOwnedBuffer) {
+  char data[] = "0123456789";
+  memory_c mem{data, 10, false};
+
+  mem.resize(20);
+  ASSERT_EQ(20u, mem.get_size());
+  EXPECT_TRUE(mem.is_free());
+  EXPECT_EQ(std::string{"0123456789"}, std::string(reinterpret_cast<char *>(mem.get_buffer()), 10));
+  EXPECT_NE(reinterpret_cast<unsigned char *>(data), mem.get_buffer());
+}
+
+TEST(Memory, LockHandsOverOwnership) {
+  auto mem = memory_c::alloc(100);
+  auto ptr = mem->get_buffer();
+
+  mem->lock();
+  EXPECT_FALSE(mem->is_free());
+  mem.reset();
+
+  free(ptr);
+}
+
+TEST(Memory, SliceKeepsParentAlive) {
+  auto parent = memory_c::clone(std::string{"0123456789"});
+  auto weak   = std::weak_ptr<memory_c>{parent};
+  auto slice  = memory_c::slice(parent, 3, 4);
+
+  EXPECT_EQ(parent->get_buffer() + 3, slice->get_buffer());
+  EXPECT_EQ(4u, slice->get_size());
+  EXPECT_FALSE(slice->is_free());
+
+  parent.reset();
+  EXPECT_FALSE(weak.expired());
+  EXPECT_EQ(std::string{"3456"}, std::string(reinterpret_cast<char *>(slice->get_buffer()), 4));
+
+  slice->resize(5);
+  EXPECT_TRUE(weak.expired());
+  EXPECT_EQ(std::string{"3456"}, std::string(reinterpret_cast<char *>(slice->get_buffer()), 4));
+}
+
+TEST(Memory, GrabLeavesSlicesAlone) {
+  auto parent = memory_c::clone(std::string{"0123456789"});
+  auto slice  = memory_c::slice(parent, 3, 4);
+
+  slice->grab();
+  EXPECT_EQ(parent->get_buffer() + 3, slice->get_buffer());
+  EXPECT_FALSE(slice->is_free());
+
+  auto unowned = std::string{"0123"};
+  auto pointer = memory_c::point_to(unowned);
+
+  pointer->grab();
+  EXPECT_NE(reinterpret_cast<unsigned char *>(&unowned[0]), pointer->get_buffer());
+  EXPECT_TRUE(pointer->is_free());
+}
+
+TEST(Memory, PoolRecyclesBuffers) {
+  auto &pool    = memory_pool_c::get();
+  auto capacity = size_t{};
+
+  auto block = pool.allocate(1000, capacity);
+  ASSERT_GE(capacity, 1000u);
+  EXPECT_LE(capacity, 1500u);
+  pool.release(block, capacity);
+
+  auto other_capacity = size_t{};
+  EXPECT_EQ(block, pool.allocate(900, other_capacity));
+  EXPECT_EQ(capacity, other_capacity);
+  pool.release(block, other_capacity);
+
+  EXPECT_EQ(block, memory_c::alloc(capacity)->get_buffer());
+}
+
+TEST(Memory, PoolHandsOutHugeBlocksDirectly) {
+  auto capacity = size_t{};
+  auto block    = memory_pool_c::get().allocate(64 * 1024 * 1024, capacity);
+
+  EXPECT_EQ(0u, capacity);
+  free(block);
+}
+
+TEST(Memory, PoolNeverHandsOutABlockTwice) {
+  auto num_threads = 4u;
+  std::vector<std::thread> threads;
+  std::vector<unsigned int> num_corrupted(num_threads);
+
+  // Each thread fills its blocks with its own number and verifies them
+  // before giving them back; a block handed out to two threads at the
+  // same time would be overwritten by the other one.
+  for (auto thread_idx = 0u; thread_idx < num_threads; ++thread_idx)
+    threads.emplace_back([thread_idx, &num_corrupted]() {
+      auto &pool = memory_pool_c::get();
+      std::vector<std::tuple<unsigned char *, size_t, size_t>> blocks;
+
+      for (auto idx = 0u; idx < 20000; ++idx) {
+        auto size     = 16 + (idx * 37 + thread_idx * 11) % 3000;
+        auto capacity = size_t{};
+        auto block    = pool.allocate(size, capacity);
+
+        std::memset(block, thread_idx, size);
+        blocks.emplace_back(block, size, capacity);
+
+        if (blocks.size() < 8)
+          continue;
+
+        auto &oldest = blocks.front();
+        if (std::count(std::get<0>(oldest), std::get<0>(oldest) + std::get<1>(oldest), thread_idx) != static_cast<std::ptrdiff_t>(std::get<1>(oldest)))
+          ++num_corrupted[thread_idx];
+
+        pool.release(std::get<0>(oldest), std::get<2>(oldest));
+        blocks.erase(blocks.begin());
+      }
+
+      for (auto const &block : blocks)
+        pool.release(std::get<0>(block), std::get<2>(block));
+    });
+
+  for (auto &thread : threads)
+    thread.join();
+
+  for (auto thread_idx = 0u; thread_idx < num_threads; ++thread_idx)
+    EXPECT_EQ(0u, num_corrupted[thread_idx]) << "thread " << thread_idx;
+}
+
+}
@@ -0,0 +1,200 @@
+#include "common/common_pch.h"
+
+#include "common/mm_async_write_buffer_io.h"
+#include "common/mm_io_x.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Writes nothing once 'limit' bytes have been written.
+class full_mem_io_c: public mm_mem_io_c {
+protected:
+  size_t m_limit;
+
+public:
+  full_mem_io_c(size_t limit)
+    : mm_mem_io_c{nullptr, 0, 1024}
+    , m_limit{limit}
+  {
+  }
+
+protected:
+  virtual size_t
+  _write(const void *buffer,
+         size_t size) {
+    if ((getFilePointer() + size) > m_limit)
+      return 0;
+    return mm_mem_io_c::_write(buffer, size);
+  }
+};
+
+void
+write_and_rewrite(mm_io_c &out) {
+  std::string data{"0123456789abcdefghijklmnopqrstuvwxyz"};
+
+  out.write(std::string(100, '-'));
+
+  for (auto idx = 0u; idx < 200; ++idx) {
+    out.write(data.c_str(), idx % data.size());
+
+    if ((idx % 7) == 0) {
+      out.save_pos(idx);
+      out.write(std::string{"XY"});
+      out.restore_pos();
+    }
+
+    if ((idx % 11) == 0) {
+      auto buffer = std::string(5, ' ');
+      out.save_pos(idx / 2);
+      out.read(&buffer[0], buffer.size());
+      out.setFilePointer(-static_cast<int64>(buffer.size()), seek_current);
+      out.write(boost::to_upper_copy(buffer));
+      out.restore_pos();
+    }
+
+    if ((idx % 13) == 0)
+      out.setFilePointer(0, seek_end);
+  }
+}
+
+TEST(MmAsyncWriteBufferIo, SameResultAsUnbufferedWriting) {
+  mm_mem_io_c reference{nullptr, 0, 1024};
+  write_and_rewrite(reference);
+
+  for (auto buffer_size : std::vector<size_t>{ 1, 3, 16, 100, 10000 }) {
+    auto target = std::make_shared<mm_mem_io_c>(nullptr, 0, 1024);
+
+    {
+      mm_async_write_buffer_io_c out{target.get(), buffer_size, false};
+      write_and_rewrite(out);
+
+      EXPECT_EQ(reference.getFilePointer(), out.getFilePointer());
+      EXPECT_EQ(reference.get_size(),       out.get_size());
+    }
+
+    EXPECT_EQ(reference.get_content(), target->get_content()) << "buffer size " << buffer_size;
+  }
+}
+
+TEST(MmAsyncWriteBufferIo, FilePointerIncludesBufferedData) {
+  auto target = std::make_shared<mm_mem_io_c>(nullptr, 0, 1024);
+  mm_async_write_buffer_io_c out{target.get(), 8, false};
+
+  out.write(std::string{"abc"});
+  EXPECT_EQ(3u, out.getFilePointer());
+
+  out.write(std::string{"defghijklm"});
+  EXPECT_EQ(13u, out.getFilePointer());
+
+  out.flush();
+  EXPECT_EQ(std::string{"abcdefghijklm"}, target->get_content());
+}
+
+TEST(MmAsyncWriteBufferIo, ReferencedBuffersAreWrittenInOrder) {
+  auto payload = [](char c) { return memory_c::clone(std::string(20000, c)); };
+  auto first   = payload('a');
+  auto second  = payload('b');
+  auto third   = payload('c');
+
+  for (auto async : std::vector<bool>{ false, true }) {
+    auto target = std::make_shared<mm_mem_io_c>(nullptr, 0, 1024);
+
+    {
+      auto out = std::shared_ptr<mm_write_buffer_io_c>{async ? new mm_async_write_buffer_io_c{target.get(), 50000, false} : new mm_write_buffer_io_c{target.get(), 50000, false}};
+
+      out->add_referencable(first);
+      out->add_referencable(second);
+      out->add_referencable(third);
+
+      out->write(std::string{"head"});
+      out->write(first->get_buffer(), first->get_size());
+      out->write(std::string{"middle"});
+      out->write(second->get_buffer(), second->get_size());
+      EXPECT_EQ(40010u, out->getFilePointer());
+
+      // Exceeds the buffer size together with the data so far.
+      out->write(third->get_buffer(), third->get_size());
+      out->write(std::string{"tail"});
+      EXPECT_EQ(60014u, out->getFilePointer());
+
+      out->clear_referencable();
+    }
+
+    EXPECT_EQ(std::string{"head"} + std::string(20000, 'a') + "middle" + std::string(20000, 'b') + std::string(20000, 'c') + "tail", target->get_content()) << "async " << async;
+  }
+}
+
+TEST(MmAsyncWriteBufferIo, ReferencedBuffersBeforeUnbufferedWrites) {
+  auto payload = memory_c::clone(std::string(10000, 'x'));
+  auto target  = std::make_shared<mm_mem_io_c>(nullptr, 0, 1024);
+
+  {
+    mm_write_buffer_io_c out{target.get(), 16384, false};
+
+    out.add_referencable(payload);
+    out.write(payload->get_buffer(), payload->get_size());
+    out.write(std::string(40000, 'y'));
+  }
+
+  EXPECT_EQ(std::string(10000, 'x') + std::string(40000, 'y'), target->get_content());
+}
+
+TEST(MmAsyncWriteBufferIo, DirectIoGivesSameResult) {
+  mm_mem_io_c reference{nullptr, 0, 1024};
+  write_and_rewrite(reference);
+  reference.write(std::string(100000, 'z'));
+
+  auto file_name = (bfs::temp_directory_path() / bfs::unique_path("mtx-direct-io-test-%%%%-%%%%")).string();
+
+  {
+    // Direct I/O isn't available everywhere; the result must be the
+    // same either way.
+    mm_async_write_buffer_io_c out{new mm_file_io_c{file_name, MODE_CREATE}, 3 * mm_file_io_c::s_direct_io_alignment};
+    out.enable_direct_io();
+
+    write_and_rewrite(out);
+    out.write(std::string(100000, 'z'));
+
+    EXPECT_EQ(reference.getFilePointer(), out.getFilePointer());
+  }
+
+  auto content = mm_file_io_c::slurp(file_name);
+  EXPECT_EQ(reference.get_content(), std::string(reinterpret_cast<char *>(content->get_buffer()), content->get_size()));
+
+  boost::system::error_code ec;
+  bfs::remove(file_name, ec);
+}
+
+TEST(MmAsyncWriteBufferIo, CloseReportsWriteErrors) {
+  auto target = std::make_shared<full_mem_io_c>(10);
+  mm_async_write_buffer_io_c out{target.get(), 8, false};
+
+  out.write(std::string(20, 'x'));
+
+  EXPECT_THROW(out.close(), mtx::mm_io::exception);
+  EXPECT_NO_THROW(out.close());
+}
+
+TEST(MmAsyncWriteBufferIo, DestructorDiscardsWriteErrors) {
+  auto target           = std::make_shared<full_mem_io_c>(10);
+  auto write_and_destroy = [&target]() {
+    mm_async_write_buffer_io_c out{target.get(), 8, false};
+    out.write(std::string(20, 'x'));
+  };
+
+  EXPECT_NO_THROW(write_and_destroy());
+}
+
+TEST(MmAsyncWriteBufferIo, DiscardBufferDropsPendingDataAndErrors) {
+  auto target = std::make_shared<full_mem_io_c>(10);
+  mm_async_write_buffer_io_c out{target.get(), 8, false};
+
+  out.write(std::string(20, 'x'));
+  out.discard_buffer();
+
+  EXPECT_NO_THROW(out.close());
+  EXPECT_EQ(8u, target->get_size());
+}
+
+}
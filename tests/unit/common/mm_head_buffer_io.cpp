@@ -0,0 +1,65 @@
+#include "common/common_pch.h"
+
+#include "common/mm_head_buffer_io.h"
+#include "common/mm_io_x.h"
+
+#include "tests/unit/util.h"
+
+namespace {
+
+using namespace mtxut;
+
+TEST(MmHeadBufferIo, ServesTheHeadFromMemory) {
+  std::string content{"0123456789abcdef"};
+  counting_mem_io_c in{content};
+  mm_head_buffer_io_c head{&in, 8, false};
+
+  EXPECT_EQ(1u, in.m_num_reads);
+  EXPECT_EQ(16, head.get_size());
+
+  auto buffer = std::string(4, ' ');
+  for (auto idx = 0; idx < 10; ++idx) {
+    head.setFilePointer(2);
+    EXPECT_EQ(4u, head.read(&buffer[0], 4));
+    EXPECT_EQ(std::string{"2345"}, buffer);
+    EXPECT_EQ(6u, head.getFilePointer());
+  }
+
+  EXPECT_EQ(1u, in.m_num_reads);
+}
+
+TEST(MmHeadBufferIo, ReadsBeyondTheHeadFromTheFile) {
+  std::string content{"0123456789abcdef"};
+  counting_mem_io_c in{content};
+  mm_head_buffer_io_c head{&in, 8, false};
+
+  auto buffer = std::string(6, ' ');
+  head.setFilePointer(5);
+  EXPECT_EQ(6u, head.read(&buffer[0], 6));
+  EXPECT_EQ(std::string{"56789a"}, buffer);
+  EXPECT_EQ(11u, head.getFilePointer());
+
+  head.setFilePointer(-2, seek_end);
+  EXPECT_EQ(0x6566u, head.read_uint16_be());
+  EXPECT_FALSE(head.eof());
+
+  EXPECT_EQ(0u, head.read(&buffer[0], 1));
+  EXPECT_TRUE(head.eof());
+
+  head.setFilePointer(3);
+  EXPECT_FALSE(head.eof());
+  EXPECT_EQ('3', head.getch());
+}
+
+TEST(MmHeadBufferIo, HeadBiggerThanTheFile) {
+  std::string content{"0123"};
+  counting_mem_io_c in{content};
+  mm_head_buffer_io_c head{&in, 1024, false};
+
+  auto buffer = std::string(8, ' ');
+  EXPECT_EQ(4u, head.read(&buffer[0], 8));
+  EXPECT_TRUE(head.eof());
+  EXPECT_THROW(head.write(std::string{"x"}), mtx::mm_io::wrong_read_write_access_x);
+}
+
+}
@@ -0,0 +1,122 @@
+#include "common/common_pch.h"
+
+#include "common/mm_io_x.h"
+#include "common/mm_mmap_io.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class MmMmapIo: public ::testing::Test {
+protected:
+  std::string m_file_name;
+
+  virtual void
+  SetUp() {
+    m_file_name = (bfs::temp_directory_path() / bfs::unique_path("mtx-mmap-test-%%%%-%%%%")).string();
+  }
+
+  virtual void
+  TearDown() {
+    boost::system::error_code ec;
+    bfs::remove(m_file_name, ec);
+  }
+
+  void
+  create_file(std::string const &content) {
+    mm_file_io_c out{m_file_name, MODE_CREATE};
+    out.write(content);
+  }
+};
+
+TEST_F(MmMmapIo, ReadsLikeAFile) {
+  create_file("0123456789abcdef");
+
+  mm_mmap_io_c in{m_file_name};
+  EXPECT_EQ(16, in.get_size());
+
+  auto buffer = std::string(4, ' ');
+  EXPECT_EQ(4u, in.read(&buffer[0], 4));
+  EXPECT_EQ(std::string{"0123"}, buffer);
+  EXPECT_EQ(4u, in.getFilePointer());
+  EXPECT_FALSE(in.eof());
+
+  in.setFilePointer(-2, seek_end);
+  EXPECT_EQ(0x6566u, in.read_uint16_be());
+  EXPECT_FALSE(in.eof());
+
+  in.setFilePointer(14);
+  EXPECT_EQ(2u, in.read(&buffer[0], 4));
+  EXPECT_TRUE(in.eof());
+
+  in.setFilePointer(100);
+  EXPECT_EQ(16u, in.getFilePointer());
+  EXPECT_FALSE(in.eof());
+  EXPECT_EQ(0u, in.read(&buffer[0], 4));
+  EXPECT_TRUE(in.eof());
+
+  EXPECT_THROW(in.setFilePointer(-1), mtx::mm_io::seek_x);
+  EXPECT_THROW(in.write(std::string{"x"}), mtx::mm_io::wrong_read_write_access_x);
+}
+
+TEST_F(MmMmapIo, ReadingBuffersDoesNotCopy) {
+  create_file("0123456789abcdef");
+
+  mm_mmap_io_c in{m_file_name};
+
+  in.setFilePointer(4);
+  auto first = in.read(4);
+  EXPECT_EQ(8u, in.getFilePointer());
+  EXPECT_EQ(std::string{"4567"}, std::string(reinterpret_cast<char *>(first->get_buffer()), first->get_size()));
+
+  auto second = in.slice(4, 4);
+  EXPECT_EQ(first->get_buffer(), second->get_buffer());
+  EXPECT_EQ(8u, in.getFilePointer());
+
+  EXPECT_THROW(in.read(9), mtx::mm_io::end_of_file_x);
+  EXPECT_THROW(in.slice(10, 7), mtx::mm_io::end_of_file_x);
+}
+
+TEST_F(MmMmapIo, BuffersKeepTheMappingAlive) {
+  create_file("0123456789abcdef");
+
+  auto in     = std::make_unique<mm_mmap_io_c>(m_file_name);
+  auto buffer = in->read(4);
+
+  buffer->grab();
+  EXPECT_FALSE(buffer->is_free());
+
+  in.reset();
+  EXPECT_EQ(std::string{"0123"}, std::string(reinterpret_cast<char *>(buffer->get_buffer()), buffer->get_size()));
+}
+
+TEST_F(MmMmapIo, ModifyingBuffersLeavesFileUntouched) {
+  create_file("0123456789abcdef");
+
+  {
+    mm_mmap_io_c in{m_file_name};
+    auto buffer = in.read(4);
+    memcpy(buffer->get_buffer(), "XXXX", 4);
+
+    buffer->resize(8);
+    EXPECT_EQ(std::string{"XXXX"}, std::string(reinterpret_cast<char *>(buffer->get_buffer()), 4));
+  }
+
+  auto content = mm_file_io_c::slurp(m_file_name);
+  EXPECT_EQ(std::string{"0123456789abcdef"}, std::string(reinterpret_cast<char *>(content->get_buffer()), content->get_size()));
+}
+
+TEST_F(MmMmapIo, EmptyFile) {
+  create_file("");
+
+  mm_mmap_io_c in{m_file_name};
+  EXPECT_EQ(0, in.get_size());
+  EXPECT_EQ(-1, in.getch());
+  EXPECT_TRUE(in.eof());
+}
+
+TEST_F(MmMmapIo, NonExistingFile) {
+  EXPECT_THROW(mm_mmap_io_c{m_file_name}, mtx::mm_io::open_x);
+}
+
+}
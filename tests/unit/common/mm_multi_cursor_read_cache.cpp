@@ -0,0 +1,54 @@
+#include "common/common_pch.h"
+
+#include "common/mm_io_x.h"
+#include "common/mm_multi_cursor_read_cache.h"
+
+#include "tests/unit/util.h"
+
+namespace {
+
+using namespace mtxut;
+
+std::string
+to_string(memory_cptr const &mem) {
+  return std::string(reinterpret_cast<char const *>(mem->get_buffer()), mem->get_size());
+}
+
+TEST(MmMultiCursorReadCache, KeepsOneWindowPerCursor) {
+  std::string content;
+  for (auto idx = 0; idx < 1000; ++idx)
+    content += (boost::format("%|1$03d|") % idx).str();
+
+  counting_mem_io_c in{content};
+  mm_multi_cursor_read_cache_c cache{in, 2, 30};
+
+  // Alternate between two cursors far apart; each one's window is
+  // refilled only once its own data has been consumed.
+  for (auto idx = 0; idx < 20; ++idx) {
+    EXPECT_EQ((boost::format("%|1$03d|") % idx).str(),         to_string(cache.read(0, idx * 3, 3)));
+    EXPECT_EQ((boost::format("%|1$03d|") % (500 + idx)).str(), to_string(cache.read(1, 1500 + idx * 3, 3)));
+  }
+
+  EXPECT_EQ(4u, in.m_num_reads);
+}
+
+TEST(MmMultiCursorReadCache, ReadsBiggerThanTheWindowGoDirectly) {
+  auto content = std::string(100, 'x');
+  counting_mem_io_c in{content};
+  mm_multi_cursor_read_cache_c cache{in, 1, 10};
+
+  EXPECT_EQ(std::string(50, 'x'), to_string(cache.read(0, 20, 50)));
+  EXPECT_EQ(std::string(5, 'x'),  to_string(cache.read(5, 0, 5)));
+}
+
+TEST(MmMultiCursorReadCache, ThrowsAtTheEnd) {
+  auto content = std::string(100, 'x');
+  counting_mem_io_c in{content};
+  mm_multi_cursor_read_cache_c cache{in, 1, 16};
+
+  EXPECT_EQ(std::string(4, 'x'), to_string(cache.read(0, 96, 4)));
+  EXPECT_THROW(cache.read(0, 98, 4), mtx::mm_io::end_of_file_x);
+  EXPECT_THROW(cache.read(0, 90, 20), mtx::mm_io::end_of_file_x);
+}
+
+}
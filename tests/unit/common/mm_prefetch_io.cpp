@@ -0,0 +1,88 @@
+#include "common/common_pch.h"
+
+#include "common/mm_io_x.h"
+#include "common/mm_prefetch_io.h"
+
+#include "tests/unit/util.h"
+
+namespace {
+
+using namespace mtxut;
+
+std::string
+read_string(mm_io_c &in,
+            size_t size) {
+  auto buffer   = std::string(size, ' ');
+  auto num_read = in.read(&buffer[0], size);
+  buffer.resize(num_read);
+
+  return buffer;
+}
+
+TEST(MmPrefetchIo, ReadsSequentially) {
+  auto content = create_content(100000);
+  mm_mem_io_c mem{reinterpret_cast<unsigned char const *>(content.c_str()), content.size()};
+  mm_prefetch_io_c in{&mem, 1000, 3, false};
+
+  EXPECT_EQ(100000, in.get_size());
+
+  std::string result;
+  while (!in.eof())
+    result += read_string(in, 777);
+
+  EXPECT_EQ(content, result);
+  EXPECT_EQ(100000u, in.getFilePointer());
+}
+
+TEST(MmPrefetchIo, Seeks) {
+  auto content = create_content(10000);
+  mm_mem_io_c mem{reinterpret_cast<unsigned char const *>(content.c_str()), content.size()};
+  mm_prefetch_io_c in{&mem, 1000, 2, false};
+
+  EXPECT_EQ(content.substr(0, 10), read_string(in, 10));
+
+  in.setFilePointer(5500);
+  EXPECT_EQ(content.substr(5500, 1000), read_string(in, 1000));
+
+  in.setFilePointer(200);
+  EXPECT_EQ(content.substr(200, 50), read_string(in, 50));
+  EXPECT_EQ(250u, in.getFilePointer());
+
+  in.setFilePointer(-10, seek_end);
+  EXPECT_EQ(content.substr(9990), read_string(in, 100));
+  EXPECT_TRUE(in.eof());
+
+  in.setFilePointer(20000);
+  EXPECT_EQ(std::string{}, read_string(in, 10));
+  EXPECT_TRUE(in.eof());
+
+  in.setFilePointer(-5, seek_current);
+  EXPECT_FALSE(in.eof());
+  EXPECT_THROW(in.setFilePointer(-1), mtx::mm_io::seek_x);
+}
+
+TEST(MmPrefetchIo, EmptyFile) {
+  mm_mem_io_c mem{nullptr, 0, 100};
+  mm_prefetch_io_c in{&mem, 1000, 2, false};
+
+  EXPECT_EQ(-1, in.getch());
+  EXPECT_TRUE(in.eof());
+}
+
+TEST(MmPrefetchIo, CloseReleasesTheUnderlyingFile) {
+  auto content = create_content(10000);
+  auto mem     = std::make_shared<mm_mem_io_c>(reinterpret_cast<unsigned char const *>(content.c_str()), content.size());
+  auto weak    = std::weak_ptr<mm_mem_io_c>{mem};
+  mm_prefetch_io_c in{mem, 1000, 4};
+
+  mem.reset();
+
+  EXPECT_EQ(content.substr(0, 10), read_string(in, 10));
+
+  in.close();
+
+  EXPECT_TRUE(weak.expired());
+  EXPECT_EQ(std::string{}, read_string(in, 10));
+}
+
+}
@@ -0,0 +1,69 @@
+#include "common/common_pch.h"
+
+#include "common/mm_io_x.h"
+#include "common/mm_read_buffer_io.h"
+
+#include "tests/unit/util.h"
+
+namespace {
+
+using namespace mtxut;
+
+TEST(MmReadBufferIo, GrowsForSequentialReads) {
+  auto content = create_content(1 << 20);
+  auto in      = new counting_mem_io_c{content};
+  mm_read_buffer_io_c buffer{in, 4096};
+
+  auto result = std::string(content.size(), ' ');
+  for (auto pos = 0u; pos < content.size(); pos += 100)
+    buffer.read(&result[pos], std::min<size_t>(100, content.size() - pos));
+
+  EXPECT_EQ(content, result);
+  EXPECT_EQ(4096u * 8, buffer.get_buffer_size());
+  EXPECT_LT(in->m_num_reads, (1u << 20) / 4096);
+  ASSERT_EQ(1u, in->m_advice.size());
+  EXPECT_EQ(mm_io_c::access_e::sequential, in->m_advice[0]);
+}
+
+TEST(MmReadBufferIo, ShrinksForRandomSeeks) {
+  auto content = create_content(1 << 20);
+  auto in      = new counting_mem_io_c{content};
+  mm_read_buffer_io_c buffer{in, 1 << 17};
+
+  auto result = std::string(10, ' ');
+  for (auto idx = 0u; idx < 20; ++idx) {
+    auto pos = (idx * 7919u * 97u) % (content.size() - 10);
+    buffer.setFilePointer(pos);
+    EXPECT_EQ(10u, buffer.read(&result[0], 10));
+    EXPECT_EQ(content.substr(pos, 10), result);
+  }
+
+  EXPECT_EQ(1u << 14, buffer.get_buffer_size());
+  ASSERT_FALSE(in->m_advice.empty());
+  EXPECT_EQ(mm_io_c::access_e::random, in->m_advice.back());
+}
+
+TEST(MmReadBufferIo, BigReadsBypassTheBuffer) {
+  auto content = create_content(100000);
+  auto in      = new counting_mem_io_c{content};
+  mm_read_buffer_io_c buffer{in, 4096};
+
+  auto result = std::string(10, ' ');
+  EXPECT_EQ(10u, buffer.read(&result[0], 10));
+  EXPECT_EQ(1u, in->m_num_reads);
+
+  // The rest of the buffer is used up first, the remainder is read
+  // into the destination in one go.
+  result = std::string(50000, ' ');
+  EXPECT_EQ(50000u, buffer.read(&result[0], 50000));
+  EXPECT_EQ(content.substr(10, 50000), result);
+  EXPECT_EQ(2u, in->m_num_reads);
+  EXPECT_EQ(50010u, buffer.getFilePointer());
+
+  result = std::string(60000, ' ');
+  EXPECT_EQ(49990u, buffer.read(&result[0], 60000));
+  EXPECT_EQ(content.substr(50010), result.substr(0, 49990));
+  EXPECT_TRUE(buffer.eof());
+}
+
+}
@@ -0,0 +1,62 @@
+#include "common/common_pch.h"
+
+#include "common/mm_io_x.h"
+#include "common/mm_stream_write_io.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(MmStreamWriteIo, HoldsDataUntilCommitted) {
+  mm_mem_io_c target{nullptr, 0, 1024};
+  mm_stream_write_io_c out{&target, false};
+
+  out.write(std::string{"0123456789"});
+  EXPECT_EQ(0u, target.getFilePointer());
+  EXPECT_EQ(10, out.get_size());
+
+  out.setFilePointer(2);
+  out.write(std::string{"ab"});
+  EXPECT_EQ(4u, out.getFilePointer());
+
+  auto buffer = std::string(3, ' ');
+  EXPECT_EQ(3u, out.read(&buffer[0], 3));
+  EXPECT_EQ(std::string{"456"}, buffer);
+
+  out.setFilePointer(0, seek_end);
+  out.write(std::string{"XY"});
+
+  out.commit();
+  EXPECT_TRUE(out.is_committed());
+  EXPECT_EQ(std::string{"01ab456789XY"}, target.get_content());
+
+  out.write(std::string{"more"});
+  EXPECT_EQ(16u, out.getFilePointer());
+  EXPECT_EQ(std::string{"01ab456789XYmore"}, target.get_content());
+}
+
+TEST(MmStreamWriteIo, RefusesToSeekBackAfterCommitting) {
+  mm_mem_io_c target{nullptr, 0, 1024};
+  mm_stream_write_io_c out{&target, false};
+
+  out.write(std::string{"0123456789"});
+  out.commit();
+
+  EXPECT_THROW(out.setFilePointer(5), mtx::mm_io::seek_x);
+  EXPECT_THROW(out.setFilePointer(1, seek_end), mtx::mm_io::seek_x);
+  EXPECT_NO_THROW(out.setFilePointer(0, seek_end));
+  EXPECT_EQ(10u, out.getFilePointer());
+}
+
+TEST(MmStreamWriteIo, CommitsWhenClosed) {
+  mm_mem_io_c target{nullptr, 0, 1024};
+
+  {
+    mm_stream_write_io_c out{&target, false};
+    out.write(std::string{"data"});
+  }
+
+  EXPECT_EQ(std::string{"data"}, target.get_content());
+}
+
+}
@@ -0,0 +1,210 @@
+#include "common/common_pch.h"
+
+#include <chrono>
+#include <random>
+
+#include "common/mpeg.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// The byte-by-byte implementations the optimized ones replace.
+std::string
+nalu_to_rbsp_naive(std::string const &nalu) {
+  std::string rbsp;
+
+  for (auto pos = size_t{}; pos < nalu.size(); ++pos) {
+    if (((pos + 2) < nalu.size()) && !nalu[pos] && !nalu[pos + 1] && (3 == nalu[pos + 2])) {
+      rbsp += std::string(2, '\0');
+      pos  += 2;
+
+    } else
+      rbsp += nalu[pos];
+  }
+
+  return rbsp;
+}
+
+std::string
+rbsp_to_nalu_naive(std::string const &rbsp) {
+  std::string nalu;
+
+  for (auto pos = size_t{}; pos < rbsp.size(); ++pos) {
+    if (((pos + 2) < rbsp.size()) && !rbsp[pos] && !rbsp[pos + 1] && (3 >= static_cast<unsigned char>(rbsp[pos + 2]))) {
+      nalu += std::string("\0\0\3", 3);
+      ++pos;
+
+    } else
+      nalu += rbsp[pos];
+  }
+
+  return nalu;
+}
+
+std::string
+to_string(memory_cptr const &mem) {
+  return std::string(reinterpret_cast<char const *>(mem->get_buffer()), mem->get_size());
+}
+
+memory_cptr
+to_memory(std::string const &data) {
+  return memory_c::clone(data);
+}
+
+// Mostly zeros, ones and threes so that all kinds of prefixes and
+// near misses occur at all positions relative to the vector width.
+std::string
+make_escapable_data(std::mt19937 &generator,
+                    size_t size) {
+  std::uniform_int_distribution<int> distribution{0, 9};
+  std::string data;
+
+  for (auto idx = 0u; idx < size; ++idx) {
+    auto value = distribution(generator);
+    data      += static_cast<char>(value < 5 ? 0 : value < 7 ? 3 : value < 8 ? 1 : 0x42);
+  }
+
+  return data;
+}
+
+size_t
+find_start_code_naive(unsigned char const *buffer,
+                      size_t size) {
+  for (auto pos = size_t{}; (pos + 2) < size; ++pos)
+    if (!buffer[pos] && !buffer[pos + 1] && (1 == buffer[pos + 2]))
+      return pos;
+
+  return size;
+}
+
+TEST(Mpeg, FindStartCodeSimple) {
+  unsigned char const buffer[] = { 0x42, 0x00, 0x00, 0x00, 0x01, 0x65, 0x00, 0x00, 0x01 };
+
+  EXPECT_EQ(2u, mpeg::find_start_code(buffer,     sizeof(buffer)));
+  EXPECT_EQ(3u, mpeg::find_start_code(buffer + 3, sizeof(buffer) - 3));
+  EXPECT_EQ(2u, mpeg::find_start_code(buffer,     5));
+  EXPECT_EQ(4u, mpeg::find_start_code(buffer,     4));
+  EXPECT_EQ(0u, mpeg::find_start_code(buffer,     0));
+  EXPECT_EQ(2u, mpeg::find_start_code(buffer + 6, 2));
+}
+
+TEST(Mpeg, FindStartCodeMatchesNaiveSearch) {
+  // Sparse random data with lots of zero bytes so that start codes
+  // and near misses turn up at all positions relative to the vector
+  // width.
+  std::mt19937 generator{42};
+  std::uniform_int_distribution<int> distribution{0, 7};
+
+  for (auto size = 0u; size < 200; ++size) {
+    auto buffer = std::vector<unsigned char>(size + 1);
+
+    for (auto round = 0; round < 20; ++round) {
+      for (auto &byte : buffer) {
+        auto value = distribution(generator);
+        byte       = value < 5 ? 0 : value == 5 ? 1 : 0x42;
+      }
+
+      for (auto offset = 0u; offset < std::min(size, 3u); ++offset)
+        EXPECT_EQ(find_start_code_naive(&buffer[offset], size - offset), mpeg::find_start_code(&buffer[offset], size - offset));
+    }
+  }
+}
+
+TEST(Mpeg, FindStartCodeWithoutMatch) {
+  auto buffer = std::vector<unsigned char>(1000, 0);
+  EXPECT_EQ(1000u, mpeg::find_start_code(&buffer[0], buffer.size()));
+
+  buffer[997] = 1;
+  EXPECT_EQ(995u, mpeg::find_start_code(&buffer[0], buffer.size()));
+  EXPECT_EQ(995u, mpeg::find_start_code(&buffer[0], 998));
+  EXPECT_EQ(997u, mpeg::find_start_code(&buffer[0], 997));
+}
+
+TEST(Mpeg, NaluToRbsp) {
+  EXPECT_EQ(std::string("\x65\0\0\0\0\x01\0\0", 8), to_string(mpeg::nalu_to_rbsp(to_memory(std::string("\x65\0\0\3\0\0\3\x01\0\0\3", 11)))));
+  EXPECT_EQ(std::string("\0\0\3\0\0", 5),           to_string(mpeg::nalu_to_rbsp(to_memory(std::string("\0\0\3\3\0\0\3", 7)))));
+  EXPECT_EQ(std::string{},                          to_string(mpeg::nalu_to_rbsp(to_memory(std::string{}))));
+}
+
+TEST(Mpeg, RbspToNalu) {
+  EXPECT_EQ(std::string("\x65\0\0\3\0\0\3\x01\0\0", 10), to_string(mpeg::rbsp_to_nalu(to_memory(std::string("\x65\0\0\0\0\x01\0\0", 8)))));
+  EXPECT_EQ(std::string("\0\0\3\3\0\0\x04", 7),          to_string(mpeg::rbsp_to_nalu(to_memory(std::string("\0\0\3\0\0\x04", 6)))));
+  EXPECT_EQ(std::string{},                               to_string(mpeg::rbsp_to_nalu(to_memory(std::string{}))));
+}
+
+TEST(Mpeg, EscapingMatchesNaiveImplementation) {
+  std::mt19937 generator{23};
+
+  for (auto size = 0u; size < 300; ++size) {
+    for (auto round = 0; round < 10; ++round) {
+      auto data = make_escapable_data(generator, size);
+      auto nalu = to_string(mpeg::rbsp_to_nalu(to_memory(data)));
+
+      EXPECT_EQ(rbsp_to_nalu_naive(data), nalu);
+      EXPECT_EQ(nalu_to_rbsp_naive(data), to_string(mpeg::nalu_to_rbsp(to_memory(data))));
+      EXPECT_EQ(data,                     to_string(mpeg::nalu_to_rbsp(to_memory(nalu))));
+    }
+  }
+}
+
+TEST(Mpeg, NaluToRbspOnlyTheFirstBytes) {
+  std::mt19937 generator{5};
+
+  for (auto round = 0; round < 200; ++round) {
+    auto data = make_escapable_data(generator, 500);
+    auto rbsp = nalu_to_rbsp_naive(data);
+
+    for (auto max_size : std::vector<size_t>{ 0, 1, 2, 3, 15, 16, 17, 64, 256, rbsp.size(), rbsp.size() + 1 })
+      EXPECT_EQ(rbsp.substr(0, max_size), to_string(mpeg::nalu_to_rbsp(to_memory(data), max_size)));
+  }
+}
+
+// Run with --gtest_also_run_disabled_tests for numbers.
+TEST(Mpeg, DISABLED_EscapingBenchmark) {
+  auto const num_bytes = size_t{256} * 1024 * 1024;
+  auto const nalu_size = size_t{64} * 1024;
+
+  // Random slice data with an emulation prevention byte about every
+  // 2 KB like in real streams.
+  std::mt19937 generator{42};
+  auto nalus = std::vector<memory_cptr>{};
+  for (auto idx = 0u; idx < 16; ++idx) {
+    auto data = std::string(nalu_size, ' ');
+    for (auto &byte : data)
+      byte = static_cast<char>(generator() % 0x100);
+    for (auto pos = size_t{}; (pos + 3) < nalu_size; pos += 2048)
+      data.replace(pos, 3, std::string("\0\0\3", 3));
+    nalus.push_back(to_memory(data));
+  }
+
+  auto mb_per_second = [num_bytes](std::function<void()> const &worker) -> double {
+    auto start = std::chrono::steady_clock::now();
+    worker();
+    auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return num_bytes / std::max(duration, 1e-9) / 1024 / 1024;
+  };
+
+  auto num_rounds   = num_bytes / nalu_size;
+  auto naive        = mb_per_second([&]() {
+    for (auto idx = 0u; idx < num_rounds; ++idx)
+      nalu_to_rbsp_naive(to_string(nalus[idx % nalus.size()]));
+  });
+  auto full         = mb_per_second([&]() {
+    for (auto idx = 0u; idx < num_rounds; ++idx)
+      mpeg::nalu_to_rbsp(nalus[idx % nalus.size()]);
+  });
+  auto slice_header = mb_per_second([&]() {
+    for (auto idx = 0u; idx < num_rounds; ++idx)
+      mpeg::nalu_to_rbsp(nalus[idx % nalus.size()], 256);
+  });
+  auto escape       = mb_per_second([&]() {
+    for (auto idx = 0u; idx < num_rounds; ++idx)
+      mpeg::rbsp_to_nalu(nalus[idx % nalus.size()]);
+  });
+
+  std::cout << boost::format("nalu_to_rbsp: byte by byte %|1$.0f| MB/s, complete %|2$.0f| MB/s, first 256 bytes %|3$.0f| MB/s; rbsp_to_nalu %|4$.0f| MB/s\n")
+    % naive % full % slice_header % escape;
+}
+
+}
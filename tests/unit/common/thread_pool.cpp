@@ -0,0 +1,49 @@
+#include "common/common_pch.h"
+
+#include <atomic>
+
+#include "common/thread_pool.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(ThreadPool, RunsAllJobs) {
+  thread_pool_c pool{4};
+  std::atomic<int> sum{0};
+  std::vector<std::future<void>> results;
+
+  for (auto idx = 1; idx <= 100; ++idx)
+    results.push_back(pool.submit([&sum, idx]() { sum += idx; }));
+
+  for (auto &result : results)
+    result.get();
+
+  EXPECT_EQ(5050, sum);
+}
+
+TEST(ThreadPool, ForwardsExceptions) {
+  thread_pool_c pool{2};
+
+  auto result = pool.submit([]() { throw std::runtime_error{"failed"}; });
+
+  EXPECT_THROW(result.get(), std::runtime_error);
+}
+
+TEST(ThreadPool, FinishesQueuedJobsOnDestruction) {
+  std::atomic<int> num_run{0};
+
+  {
+    thread_pool_c pool{1};
+    for (auto idx = 0; idx < 10; ++idx)
+      pool.submit([&num_run]() { ++num_run; });
+  }
+
+  EXPECT_EQ(10, num_run);
+}
+
+TEST(ThreadPool, GlobalPoolHasAtLeastOneThread) {
+  EXPECT_LE(1u, thread_pool_c::get().get_num_threads());
+}
+
+}
@@ -0,0 +1,126 @@
+#include "common/common_pch.h"
+
+#include "merge/id_cache.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class IdCache: public ::testing::Test {
+protected:
+  bfs::path m_directory, m_file_name;
+
+  virtual void
+  SetUp() {
+    auto base   = bfs::temp_directory_path() / bfs::unique_path("mtx-id-cache-test-%%%%-%%%%");
+    m_directory = base / "cache";
+    m_file_name = base / "source.bin";
+
+    bfs::create_directories(base);
+    create_file(m_file_name, "0123456789");
+  }
+
+  virtual void
+  TearDown() {
+    boost::system::error_code ec;
+    bfs::remove_all(m_directory.parent_path(), ec);
+  }
+
+  void
+  create_file(bfs::path const &file_name,
+              std::string const &content) {
+    mm_file_io_c out{file_name.string(), MODE_CREATE};
+    out.write(content);
+  }
+
+  unsigned int
+  num_entries() {
+    auto num = 0u;
+    for (auto itr = bfs::directory_iterator{m_directory}, end = bfs::directory_iterator{}; itr != end; ++itr)
+      ++num;
+    return num;
+  }
+};
+
+TEST_F(IdCache, StoresAndLooksUp) {
+  id_cache_c cache{m_directory, "v1"};
+  auto result = nlohmann::json{ { "container", { { "type", "Matroska" } } } };
+
+  EXPECT_FALSE(!!cache.lookup(m_file_name.string(), false));
+
+  cache.store(m_file_name.string(), false, result);
+
+  auto cached = cache.lookup(m_file_name.string(), false);
+  ASSERT_TRUE(!!cached);
+  EXPECT_EQ(result, *cached);
+
+  EXPECT_FALSE(!!cache.lookup(m_file_name.string(), true));
+  EXPECT_FALSE(!!id_cache_c(m_directory, "v2").lookup(m_file_name.string(), false));
+}
+
+TEST_F(IdCache, DifferentSpellingsOfTheSameFileAreFound) {
+  id_cache_c cache{m_directory, "v1"};
+  auto result = nlohmann::json{ { "file_name", m_file_name.string() } };
+
+  cache.store(m_file_name.string(), false, result);
+
+  auto other_spelling = (m_file_name.parent_path() / "." / m_file_name.filename()).string();
+  auto cached         = cache.lookup(other_spelling, false);
+  ASSERT_TRUE(!!cached);
+  EXPECT_EQ(result, *cached);
+
+#if !defined(SYS_WINDOWS)
+  auto link_name = m_file_name.parent_path() / "link.bin";
+  bfs::create_symlink(m_file_name, link_name);
+
+  EXPECT_TRUE(!!cache.lookup(link_name.string(), false));
+#endif
+}
+
+TEST_F(IdCache, ChangedFilesAreNotFound) {
+  id_cache_c cache{m_directory, "v1"};
+
+  cache.store(m_file_name.string(), false, nlohmann::json{ { "x", 1 } });
+  create_file(m_file_name, "01234567890123456789");
+
+  EXPECT_FALSE(!!cache.lookup(m_file_name.string(), false));
+}
+
+#if !defined(SYS_WINDOWS)
+TEST_F(IdCache, FilesRewrittenWithTheSameSizeAreNotFound) {
+  id_cache_c cache{m_directory, "v1"};
+
+  cache.store(m_file_name.string(), false, nlohmann::json{ { "x", 1 } });
+  create_file(m_file_name, "9876543210");
+
+  EXPECT_FALSE(!!cache.lookup(m_file_name.string(), false));
+}
+#endif
+
+TEST_F(IdCache, Invalidates) {
+  id_cache_c cache{m_directory, "v1"};
+
+  cache.store(m_file_name.string(), false, nlohmann::json{ { "x", 1 } });
+  EXPECT_EQ(1u, num_entries());
+
+  cache.invalidate(m_file_name.string());
+  EXPECT_EQ(0u, num_entries());
+  EXPECT_FALSE(!!cache.lookup(m_file_name.string(), false));
+}
+
+TEST_F(IdCache, EnforcesMaximumSize) {
+  id_cache_c cache{m_directory, "v1", 1500};
+  auto big = nlohmann::json{ { "data", std::string(1000, 'x') } };
+
+  auto other_file_name = m_directory.parent_path() / "other.bin";
+  create_file(other_file_name, "abc");
+
+  cache.store(m_file_name.string(), false, big);
+  EXPECT_EQ(1u, num_entries());
+
+  cache.store(other_file_name.string(), false, big);
+  EXPECT_EQ(1u, num_entries());
+  EXPECT_TRUE(!!cache.lookup(other_file_name.string(), false) || !!cache.lookup(m_file_name.string(), false));
+}
+
+}
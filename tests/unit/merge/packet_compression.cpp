@@ -0,0 +1,81 @@
+#include "common/common_pch.h"
+
+#include "common/compression.h"
+#include "merge/filelist.h"
+#include "tests/benchmark/mux/synthetic_reader.h"
+#include "tests/unit/util.h"
+
+namespace {
+
+class compressing_packetizer_c: public mtxbm::synthetic_packetizer_c {
+public:
+  compressing_packetizer_c(generic_reader_c *reader,
+                           track_info_c &ti,
+                           mtxbm::synthetic_track_t const &track,
+                           bool in_background)
+    : synthetic_packetizer_c{reader, ti, track}
+  {
+    m_compressor             = compressor_c::create(COMPRESSION_ZLIB);
+    m_compress_in_background = in_background;
+  }
+};
+
+// Runs the packets through a zlib compressing packetizer and returns the
+// packets it outputs in order.
+std::vector<memory_cptr>
+compress(std::vector<memory_cptr> const &packets,
+         bool in_background) {
+  auto file         = std::make_shared<filelist_t>();
+  file->name        = "synthetic";
+  file->ti          = std::make_unique<track_info_c>();
+  file->ti->m_fname = file->name;
+  file->reader.reset(new mtxbm::synthetic_reader_c{*file->ti, std::make_shared<mm_null_io_c>(file->name), mtxbm::synthetic_parameters_t{}});
+
+  // The packetizer looks its reader up when creating its track number.
+  g_files.push_back(file);
+
+  auto track = mtxbm::synthetic_track_t{ track_audio, 0, 32000000, 0, -1, 0, nullptr };
+  compressing_packetizer_c ptzr{file->reader.get(), *file->ti, track, in_background};
+
+  std::vector<memory_cptr> result;
+  auto timestamp = int64_t{};
+
+  for (auto const &data : packets) {
+    ptzr.process(new packet_t(data->clone(), timestamp, 32000000));
+    timestamp += 32000000;
+
+    while (ptzr.packet_available())
+      result.push_back(ptzr.get_packet()->data);
+  }
+
+  ptzr.flush();
+
+  packet_cptr packet;
+  while ((packet = ptzr.get_packet()))
+    result.push_back(packet->data);
+
+  g_files.clear();
+
+  return result;
+}
+
+TEST(PacketCompression, SameResultWithAndWithoutThePool) {
+  std::vector<memory_cptr> packets;
+  for (auto idx = 0u; idx < 200; ++idx)
+    packets.push_back(memory_c::clone(mtxut::create_content(100 + (idx * 997) % 20000)));
+
+  auto serial     = compress(packets, false);
+  auto background = compress(packets, true);
+
+  ASSERT_EQ(packets.size(), serial.size());
+  ASSERT_EQ(packets.size(), background.size());
+
+  auto decompressor = compressor_c::create(COMPRESSION_ZLIB);
+
+  for (auto idx = 0u; idx < packets.size(); ++idx) {
+    EXPECT_TRUE(*serial[idx] == *background[idx]) << "packet " << idx;
+    EXPECT_TRUE(*packets[idx] == *decompressor->decompress(background[idx])) << "packet " << idx;
+  }
+}
+
+}
@@ -0,0 +1,144 @@
+#include "common/common_pch.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "merge/packet_interleaver.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Simulates the muxer: each track delivers timecodes in steps of its
+// own size. Emits num_packets packets and returns the order in which
+// the slots won.
+template<typename Tselector>
+std::vector<size_t>
+interleave(size_t num_tracks,
+           size_t num_packets,
+           Tselector &&selector) {
+  std::vector<int64_t> next_timecode(num_tracks, 0);
+  std::vector<size_t> order;
+
+  for (size_t slot = 0; slot < num_tracks; ++slot)
+    selector.fill(slot, next_timecode[slot]);
+
+  order.reserve(num_packets);
+
+  while (order.size() < num_packets) {
+    auto winner = selector.pop();
+    order.push_back(winner);
+
+    next_timecode[winner] += 20000000ll + (winner % 7) * 1000000ll;
+    selector.fill(winner, next_timecode[winner]);
+  }
+
+  return order;
+}
+
+struct linear_selector_t {
+  std::vector<int64_t> m_slots;
+  std::vector<bool> m_filled;
+
+  void fill(size_t slot, int64_t timecode) {
+    if (m_slots.size() <= slot) {
+      m_slots.resize(slot + 1);
+      m_filled.resize(slot + 1);
+    }
+    m_slots[slot]  = timecode;
+    m_filled[slot] = true;
+  }
+
+  size_t pop() {
+    auto winner = m_slots.size();
+    for (size_t slot = 0; slot < m_slots.size(); ++slot)
+      if (m_filled[slot] && ((m_slots.size() == winner) || (m_slots[slot] < m_slots[winner])))
+        winner = slot;
+
+    m_filled[winner] = false;
+    return winner;
+  }
+};
+
+struct heap_selector_t {
+  packet_interleaver_c m_interleaver;
+
+  void fill(size_t slot, int64_t timecode) {
+    m_interleaver.add(slot, timecode);
+  }
+
+  size_t pop() {
+    auto winner = m_interleaver.get_winner();
+    m_interleaver.remove_winner();
+    return winner;
+  }
+};
+
+TEST(PacketInterleaver, Empty) {
+  packet_interleaver_c interleaver;
+
+  EXPECT_TRUE(interleaver.empty());
+  EXPECT_EQ(0u, interleaver.size());
+}
+
+TEST(PacketInterleaver, SmallestTimecodeWins) {
+  packet_interleaver_c interleaver;
+
+  interleaver.add(0, 300);
+  interleaver.add(1, 100);
+  interleaver.add(2, 200);
+
+  EXPECT_EQ(3u, interleaver.size());
+  EXPECT_EQ(1u, interleaver.get_winner());
+  interleaver.remove_winner();
+  EXPECT_EQ(2u, interleaver.get_winner());
+  interleaver.remove_winner();
+  EXPECT_EQ(0u, interleaver.get_winner());
+  interleaver.remove_winner();
+  EXPECT_TRUE(interleaver.empty());
+}
+
+TEST(PacketInterleaver, TiesGoToLowestSlot) {
+  packet_interleaver_c interleaver;
+
+  interleaver.add(3, 100);
+  interleaver.add(1, 100);
+  interleaver.add(2, 100);
+  interleaver.add(0, 200);
+
+  EXPECT_EQ(1u, interleaver.get_winner());
+  interleaver.remove_winner();
+  EXPECT_EQ(2u, interleaver.get_winner());
+  interleaver.remove_winner();
+  EXPECT_EQ(3u, interleaver.get_winner());
+  interleaver.remove_winner();
+  EXPECT_EQ(0u, interleaver.get_winner());
+}
+
+TEST(PacketInterleaver, SameOrderAsLinearScan) {
+  for (auto num_tracks : std::vector<size_t>{ 1, 2, 3, 8, 41, 256 })
+    EXPECT_EQ(interleave(num_tracks, 10000, linear_selector_t{}), interleave(num_tracks, 10000, heap_selector_t{})) << "num_tracks " << num_tracks;
+}
+
+// Run with --gtest_also_run_disabled_tests for numbers.
+TEST(PacketInterleaver, DISABLED_Benchmark) {
+  auto const num_packets = 2000000u;
+
+  auto packets_per_second = [num_packets](std::function<void()> const &worker) -> double {
+    auto start = std::chrono::steady_clock::now();
+    worker();
+    auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return num_packets / std::max(duration, 1e-9);
+  };
+
+  std::cout << boost::format("%|1$6s| %|2$16s| %|3$16s|\n") % "tracks" % "linear pkts/s" % "heap pkts/s";
+
+  for (size_t num_tracks = 2; num_tracks <= 256; num_tracks *= 2) {
+    auto linear = packets_per_second([num_tracks, num_packets]() { interleave(num_tracks, num_packets, linear_selector_t{}); });
+    auto heap   = packets_per_second([num_tracks, num_packets]() { interleave(num_tracks, num_packets, heap_selector_t{}); });
+
+    std::cout << boost::format("%|1$6d| %|2$16.0f| %|3$16.0f|\n") % num_tracks % linear % heap;
+  }
+}
+
+}
@@ -0,0 +1,279 @@
+#include "common/common_pch.h"
+
+#include "common/endian.h"
+#include "input/qtmp4_atoms.h"
+#include "input/r_qtmp4.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// The index as it was built before the entries were computed on
+// demand: all timecodes and durations are expanded up front, the key
+// frame flags are assigned by walking the stss table and the 'rap '
+// sample group afterwards.
+std::vector<qt_index_t>
+expand_index(qtmp4_demuxer_c const &dmx) {
+  std::vector<qt_index_t> index;
+  std::vector<int64_t> timecodes, durations;
+  std::vector<size_t> frame_indices;
+
+  if (0 != dmx.sample_size) {
+    auto frame = 0u;
+    for (auto const &chunk : dmx.chunk_table) {
+      timecodes.push_back(dmx.to_nsecs(static_cast<uint64_t>(chunk.samples) * dmx.duration) + dmx.constant_editlist_offset_ns);
+      durations.push_back(dmx.to_nsecs(static_cast<uint64_t>(chunk.size)    * dmx.duration));
+      frame_indices.push_back(frame++);
+    }
+
+  } else {
+    auto const num_edits         = dmx.editlist_table.size();
+    auto const num_frame_offsets = dmx.frame_offset_table.size();
+    auto use_frame_offsets       = dmx.codec.is(codec_c::type_e::V_MPEG4_P10) || dmx.codec.is(codec_c::type_e::V_MPEGH_P2);
+    auto v_dts_offset            = use_frame_offsets && num_frame_offsets ? dmx.to_nsecs(dmx.frame_offset_table[0]) : 0;
+
+    std::vector<int64_t> timecodes_before_offsets;
+
+    for (size_t frame = 0; dmx.sample_table.size() > frame; ++frame) {
+      int64_t pts_offset = 0;
+      auto real_frame    = frame;
+
+      if (0 < num_edits) {
+        auto editlist_pos = 0u;
+
+        while (((num_edits - 1) > editlist_pos) && (static_cast<int64_t>(frame) >= dmx.editlist_table[editlist_pos + 1].start_frame))
+          ++editlist_pos;
+
+        auto &edit = dmx.editlist_table[editlist_pos];
+        if ((edit.start_frame + edit.frames) > static_cast<int64_t>(frame)) {
+          real_frame = real_frame - edit.start_frame + edit.start_sample;
+          pts_offset = edit.pts_offset;
+        }
+      }
+
+      auto timecode = dmx.to_nsecs(dmx.sample_table[real_frame].pts + pts_offset);
+
+      frame_indices.push_back(real_frame);
+      timecodes_before_offsets.push_back(timecode);
+
+      if (use_frame_offsets && (num_frame_offsets > real_frame))
+        timecode += dmx.to_nsecs(dmx.frame_offset_table[real_frame]) - v_dts_offset;
+
+      timecodes.push_back(timecode + dmx.constant_editlist_offset_ns);
+    }
+
+    int64_t avg_duration = 0, num_good_frames = 0;
+
+    for (size_t frame = 0; timecodes_before_offsets.size() > (frame + 1); ++frame) {
+      auto diff = timecodes_before_offsets[frame + 1] - timecodes_before_offsets[frame];
+
+      if (0 >= diff)
+        durations.push_back(0);
+      else {
+        ++num_good_frames;
+        avg_duration += diff;
+        durations.push_back(diff);
+      }
+    }
+
+    durations.push_back(0);
+
+    if (num_good_frames) {
+      avg_duration /= num_good_frames;
+      for (auto &duration : durations)
+        if (!duration)
+          duration = avg_duration;
+    }
+  }
+
+  auto keyframe_table_idx = 0u;
+
+  for (size_t frame_idx = 0; frame_idx < frame_indices.size(); ++frame_idx) {
+    auto is_keyframe = false;
+    if (dmx.keyframe_table.empty())
+      is_keyframe = true;
+    else if ((keyframe_table_idx < dmx.keyframe_table.size()) && ((frame_idx + 1) == dmx.keyframe_table[keyframe_table_idx])) {
+      is_keyframe = true;
+      ++keyframe_table_idx;
+    }
+
+    if (0 == dmx.sample_size) {
+      auto const &sample = dmx.sample_table[frame_indices[frame_idx]];
+      index.emplace_back(sample.pos, sample.size, timecodes[frame_idx], durations[frame_idx], is_keyframe);
+      continue;
+    }
+
+    auto const &chunk    = dmx.chunk_table[frame_idx];
+    auto sound_stsd_atom = reinterpret_cast<sound_v1_stsd_atom_t const *>(dmx.stsd->get_buffer());
+    uint64_t frame_size  = 1 != dmx.sample_size ? chunk.size * dmx.sample_size : chunk.size * dmx.a_channels * get_uint16_be(&sound_stsd_atom->v0.sample_size) / 8;
+
+    index.emplace_back(chunk.pos, frame_size, timecodes[frame_idx], durations[frame_idx], is_keyframe);
+  }
+
+  auto table_itr = dmx.sample_to_group_tables.find(fourcc_c{"rap "}.value());
+  if (table_itr == dmx.sample_to_group_tables.end())
+    return index;
+
+  auto current_sample = 0u;
+
+  for (auto const &s2g : table_itr->second) {
+    if (s2g.group_description_index && ((s2g.group_description_index - 1) < dmx.random_access_point_table.size())) {
+      for (auto end = std::min<size_t>(current_sample + s2g.sample_count, index.size()); current_sample < end; ++current_sample)
+        index[current_sample].is_keyframe = true;
+
+    } else
+      current_sample += s2g.sample_count;
+
+    if (current_sample >= index.size())
+      break;
+  }
+
+  return index;
+}
+
+class QtMp4Index: public ::testing::Test {
+protected:
+  track_info_c m_ti;
+  qtmp4_reader_c m_reader;
+  qtmp4_demuxer_c m_dmx;
+
+  QtMp4Index()
+    : m_reader{m_ti, std::make_shared<mm_mem_io_c>(nullptr, 0, 1024)}
+    , m_dmx{m_reader}
+  {
+    m_dmx.time_scale = 1000;
+  }
+
+  void
+  add_edit(int64_t segment_duration,
+           int64_t media_time) {
+    qt_editlist_t edit;
+    edit.segment_duration   = segment_duration;
+    edit.media_time         = media_time;
+    edit.media_rate_integer = 1;
+    m_dmx.editlist_table.push_back(edit);
+  }
+
+  void
+  compare() {
+    ASSERT_TRUE(m_dmx.update_tables());
+    m_dmx.calculate_timecodes();
+
+    for (auto delta : std::vector<int64_t>{ 0, -40000000 }) {
+      m_dmx.adjust_timecodes(delta);
+
+      auto expected = expand_index(m_dmx);
+      ASSERT_EQ(expected.size(), m_dmx.get_num_index_entries());
+
+      for (auto &entry : expected)
+        entry.timecode += delta;
+
+      for (size_t idx = 0; idx < expected.size(); ++idx) {
+        auto actual = m_dmx.get_index_entry(idx);
+
+        EXPECT_EQ(expected[idx].file_pos,    actual.file_pos)    << "entry " << idx;
+        EXPECT_EQ(expected[idx].size,        actual.size)        << "entry " << idx;
+        EXPECT_EQ(expected[idx].timecode,    actual.timecode)    << "entry " << idx;
+        EXPECT_EQ(expected[idx].duration,    actual.duration)    << "entry " << idx;
+        EXPECT_EQ(expected[idx].is_keyframe, actual.is_keyframe) << "entry " << idx;
+      }
+    }
+  }
+};
+
+TEST_F(QtMp4Index, EditListsFrameOffsetsAndRandomAccessPoints) {
+  m_dmx.type  = 'v';
+  m_dmx.codec = codec_c::look_up(codec_c::type_e::V_MPEG4_P10);
+
+  // 100 samples in ten chunks of ten samples each; the first half
+  // lasts 40 units per sample, the second half 20.
+  for (auto idx = 0u; idx < 10; ++idx)
+    m_dmx.chunk_table.emplace_back(0, 100000 * idx);
+
+  m_dmx.chunkmap_table.emplace_back();
+  m_dmx.chunkmap_table.back().samples_per_chunk = 10;
+
+  for (auto idx = 0u; idx < 100; ++idx)
+    m_dmx.sample_table.emplace_back(100 + 3 * idx);
+
+  m_dmx.durmap_table.emplace_back(50, 40);
+  m_dmx.durmap_table.emplace_back(50, 20);
+
+  // B frames: presentation order I P B
+  for (auto idx = 0u; idx < 100; ++idx)
+    m_dmx.raw_frame_offset_table.emplace_back(1, std::vector<uint32_t>{ 80, 0, 40 }[idx % 3]);
+
+  for (auto idx = 1u; idx <= 100; idx += 10)
+    m_dmx.keyframe_table.push_back(idx);
+
+  // Open GOPs marked via the 'rap ' sample group.
+  auto &s2g = m_dmx.sample_to_group_tables[fourcc_c{"rap "}.value()];
+  s2g.emplace_back(5,  0);
+  s2g.emplace_back(3,  1);
+  s2g.emplace_back(10, 0);
+  s2g.emplace_back(2,  1);
+  s2g.emplace_back(4,  2);
+  m_dmx.random_access_point_table.emplace_back(true, 0);
+
+  // Three edits (in the file's time scale of one unit per second)
+  // that play the samples out of order.
+  add_edit(1,   80);
+  add_edit(1, 2000);
+  add_edit(1,  400);
+
+  compare();
+}
+
+TEST_F(QtMp4Index, Fragments) {
+  m_dmx.type  = 'v';
+  m_dmx.codec = codec_c::look_up(codec_c::type_e::V_MPEGH_P2);
+
+  // Fill the tables the same way the trun atoms of two fragments do.
+  for (auto fragment = 0u; fragment < 2; ++fragment) {
+    auto offset = 100000u * (fragment + 1);
+
+    for (auto idx = 0u; idx < 30; ++idx) {
+      auto sample_size = 500 + idx;
+
+      m_dmx.durmap_table.emplace_back(1, idx % 2 ? 33 : 34);
+      m_dmx.sample_table.emplace_back(sample_size);
+      m_dmx.chunk_table.emplace_back(1, offset);
+      m_dmx.raw_frame_offset_table.emplace_back(1, (idx % 3) * 33);
+
+      if (!(idx % 15))
+        m_dmx.keyframe_table.emplace_back(m_dmx.num_frames_from_trun + 1);
+
+      offset += sample_size;
+      ++m_dmx.num_frames_from_trun;
+    }
+  }
+
+  // A single edit with a positive start time shifts all timecodes.
+  add_edit(2, 66);
+
+  compare();
+}
+
+TEST_F(QtMp4Index, ConstantSampleSize) {
+  m_dmx.type        = 'a';
+  m_dmx.a_channels  = 2;
+  m_dmx.sample_size = 1;
+  m_dmx.stsd        = memory_c::alloc(sizeof(sound_v1_stsd_atom_t));
+
+  std::memset(m_dmx.stsd->get_buffer(), 0, m_dmx.stsd->get_size());
+  put_uint16_be(&reinterpret_cast<sound_v1_stsd_atom_t *>(m_dmx.stsd->get_buffer())->v0.sample_size, 16);
+
+  for (auto idx = 0u; idx < 20; ++idx)
+    m_dmx.chunk_table.emplace_back(0, 50000 * idx);
+
+  m_dmx.chunkmap_table.resize(2);
+  m_dmx.chunkmap_table[0].samples_per_chunk = 1024;
+  m_dmx.chunkmap_table[1].first_chunk       = 10;
+  m_dmx.chunkmap_table[1].samples_per_chunk = 512;
+
+  m_dmx.durmap_table.emplace_back(15360, 1);
+
+  compare();
+}
+
+}
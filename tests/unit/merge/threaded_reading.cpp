@@ -0,0 +1,120 @@
+#include "common/common_pch.h"
+
+#if !defined(SYS_WINDOWS)
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "merge/cluster_helper.h"
+#include "merge/filelist.h"
+#include "merge/output_control.h"
+#include "tests/benchmark/mux/synthetic_reader.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+void
+mux(std::vector<mtxbm::synthetic_parameters_t> const &inputs,
+    std::string const &file_name,
+    bool threaded) {
+  g_outfile          = file_name;
+  g_threaded_reading = threaded;
+  g_kax_tracks       = std::make_unique<KaxTracks>();
+  g_cluster_helper   = std::make_unique<cluster_helper_c>();
+
+  for (auto const &parameters : inputs) {
+    auto file         = std::make_shared<filelist_t>();
+    file->name        = (boost::format("synthetic%1%") % g_files.size()).str();
+    file->all_names   = { file->name };
+    file->id          = g_files.size();
+    file->ti          = std::make_unique<track_info_c>();
+    file->ti->m_fname = file->name;
+    file->reader.reset(new mtxbm::synthetic_reader_c{*file->ti, std::make_shared<mm_null_io_c>(file->name), parameters});
+    file->reader->read_headers();
+    g_files.push_back(file);
+  }
+
+  create_packetizers();
+  check_track_id_validity();
+  calc_attachment_sizes();
+  calc_max_chapter_size();
+
+  create_next_output_file();
+  main_loop();
+  finish_file(true);
+
+  cleanup();
+}
+
+// mkvmerge's global state cannot be reset completely after muxing
+// (e.g. the track numbers handed out), therefore each run happens in a
+// process of its own.
+bool
+mux_in_child(std::vector<mtxbm::synthetic_parameters_t> const &inputs,
+             std::string const &file_name,
+             bool threaded) {
+  auto pid = fork();
+  if (-1 == pid)
+    return false;
+
+  if (!pid) {
+    try {
+      mux(inputs, file_name, threaded);
+    } catch (...) {
+      _exit(1);
+    }
+    _exit(0);
+  }
+
+  auto status = 0;
+  waitpid(pid, &status, 0);
+
+  return WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+std::string
+read_file(std::string const &file_name) {
+  mm_file_io_c in{file_name};
+  std::string content;
+  in.read(content, in.get_size());
+  return content;
+}
+
+TEST(ThreadedReading, ProducesTheSameOutputAsSerialReading) {
+  auto video = mtxbm::synthetic_parameters_t{};
+  auto audio = mtxbm::synthetic_parameters_t{};
+
+  video.m_num_audio_tracks   = 0;
+  video.m_video_packet_size  = 4096;
+  video.m_duration           = 20ll * 1000000000ll;
+  video.m_key_frame_interval = 25;
+  video.m_fill_packets       = true;
+
+  audio.m_num_video_tracks   = 0;
+  audio.m_num_audio_tracks   = 1;
+  audio.m_duration           = 25ll * 1000000000ll;
+  audio.m_fill_packets       = true;
+
+  auto inputs    = std::vector<mtxbm::synthetic_parameters_t>{ video, audio, audio };
+  auto directory = bfs::temp_directory_path() / bfs::unique_path("mtx-threaded-reading-test-%%%%-%%%%");
+  bfs::create_directories(directory);
+
+  auto serial    = (directory / "serial.mkv").string();
+  auto threaded  = (directory / "threaded.mkv").string();
+
+  EXPECT_TRUE(mux_in_child(inputs, serial,   false));
+  EXPECT_TRUE(mux_in_child(inputs, threaded, true));
+
+  auto serial_content = read_file(serial);
+  EXPECT_FALSE(serial_content.empty());
+  EXPECT_TRUE(serial_content == read_file(threaded));
+
+  boost::system::error_code ec;
+  bfs::remove_all(directory, ec);
+}
+
+}
+
+#endif  // !SYS_WINDOWS
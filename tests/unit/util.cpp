@@ -204,4 +204,30 @@ ebml_equals_c::compare_impl(EbmlElement &a,
     return set_error(boost::format("unsupported types: %1% and %2%") % EBML_NAME(&a) % EBML_NAME(&b));
 }
 
+counting_mem_io_c::counting_mem_io_c(std::string const &content)
+  : mm_mem_io_c{reinterpret_cast<unsigned char const *>(content.c_str()), content.size()}
+{
+}
+
+void
+counting_mem_io_c::advise(access_e access) {
+  m_advice.push_back(access);
+}
+
+uint32
+counting_mem_io_c::_read(void *buffer,
+                         size_t size) {
+  ++m_num_reads;
+  return mm_mem_io_c::_read(buffer, size);
+}
+
+std::string
+create_content(size_t size) {
+  std::string content;
+  for (auto idx = 0u; idx < size; ++idx)
+    content += static_cast<char>('a' + (idx * 7) % 26);
+
+  return content;
+}
+
 }
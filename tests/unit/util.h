@@ -49,6 +49,24 @@ public:
   static bool check(EbmlElement &a, EbmlElement &b, std::string &error);
 };
 
+// An in-memory file counting the reads that reach it and recording the
+// access patterns it is advised of.
+class counting_mem_io_c: public mm_mem_io_c {
+public:
+  unsigned int m_num_reads{};
+  std::vector<access_e> m_advice;
+
+  counting_mem_io_c(std::string const &content);
+
+  virtual void advise(access_e access);
+
+protected:
+  virtual uint32 _read(void *buffer, size_t size);
+};
+
+// Returns 'size' lowercase letters repeating every 26 bytes.
+std::string create_content(size_t size);
+
 }
 
 inline bool